@@ -0,0 +1,84 @@
+""" Measure the effect of the node order of the internal graph on the speed of
+the optimisation, see :func:`MutableVertexPartition.Reordered`.
+
+The nodes of a graph with communities are first shuffled, as for a crawled
+graph whose node order is effectively random. The graph is then optimised
+with the original (shuffled) node order and with each of the node orders of
+``Reordered``, and the time, the throughput in nodes per second and the
+quality are reported for each. The time of the reordering itself is reported
+separately.
+
+Usage::
+
+  python benchmarks/reorder.py [--nodes N] [--degree K] [--repeats R]
+"""
+import argparse
+import random
+import time
+
+import igraph as ig
+import leidenalg
+
+def shuffled_graph(n, degree, seed):
+  """ Graph with communities of about 100 nodes and the given mean degree, of
+  which most edges fall within the communities, with its nodes shuffled. """
+  rng = random.Random(seed)
+  n_comms = max(1, n // 100)
+  comm = [rng.randrange(n_comms) for v in range(n)]
+  members = [[] for c in range(n_comms)]
+  for v in range(n):
+    members[comm[v]].append(v)
+  edges = []
+  for i in range(n*degree // 2):
+    v = rng.randrange(n)
+    if rng.random() < 0.9:
+      u = rng.choice(members[comm[v]])
+    else:
+      u = rng.randrange(n)
+    if u != v:
+      edges.append((v, u))
+  G = ig.Graph(n=n, edges=edges)
+  G.simplify()
+  position = list(range(n))
+  rng.shuffle(position)
+  return G.permute_vertices(position)
+
+def run(G, node_order, repeats, seed):
+  """ Best time of creating and of optimising the partition over the repeats,
+  and the quality of the last partition. """
+  best_create, best_optimise = float('inf'), float('inf')
+  for r in range(repeats):
+    start = time.perf_counter()
+    if node_order is None:
+      partition = leidenalg.ModularityVertexPartition(G)
+    else:
+      partition = leidenalg.ModularityVertexPartition.Reordered(G, node_order)
+    created = time.perf_counter()
+    optimiser = leidenalg.Optimiser()
+    optimiser.set_rng_seed(seed + r)
+    optimiser.optimise_partition(partition, n_iterations=2)
+    done = time.perf_counter()
+    best_create = min(best_create, created - start)
+    best_optimise = min(best_optimise, done - created)
+  return best_create, best_optimise, partition.quality()
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+  parser.add_argument('--nodes', type=int, default=200000)
+  parser.add_argument('--degree', type=int, default=10)
+  parser.add_argument('--repeats', type=int, default=3)
+  parser.add_argument('--seed', type=int, default=42)
+  args = parser.parse_args()
+
+  G = shuffled_graph(args.nodes, args.degree, args.seed)
+  print('Graph with {0} nodes and {1} edges, best of {2} runs'.format(
+    G.vcount(), G.ecount(), args.repeats))
+  print('{0:>10} {1:>10} {2:>12} {3:>14} {4:>9}'.format(
+    'order', 'reorder s', 'optimise s', 'nodes per s', 'quality'))
+  for node_order in [None, 'rcm', 'bfs', 'degree']:
+    create, optimise, quality = run(G, node_order, args.repeats, args.seed)
+    print('{0:>10} {1:>10.3f} {2:>12.3f} {3:>14.0f} {4:>9.4f}'.format(
+      node_order or 'original', create, optimise, G.vcount()/optimise, quality))
+
+if __name__ == '__main__':
+  main()
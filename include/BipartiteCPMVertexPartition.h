@@ -0,0 +1,80 @@
+#ifndef BIPARTITECPMVERTEXPARTITION_H
+#define BIPARTITECPMVERTEXPARTITION_H
+
+#include <libleidenalg/CPMVertexPartition.h>
+
+#include "diff_move_kernels.h"
+
+#ifdef DEBUG
+#include <iostream>
+  using std::cerr;
+  using std::endl;
+#endif
+
+/****************************************************************************
+  CPM for bipartite graphs in a single partition, equivalent to the three
+  layers created by CPMVertexPartition.Bipartite with layer weights [1, -1, -1].
+
+  The class of a node is encoded in its node size, which equals s for a node of
+  class 0 and s*type_base for a node of class 1. With integer sizes and
+  type_base larger than the total size of class 0, the size of each class in a
+  community can be recovered from csize, also after collapsing the graph.
+*****************************************************************************/
+class BipartiteCPMVertexPartition : public CPMVertexPartition
+{
+  public:
+    BipartiteCPMVertexPartition(Graph* graph,
+          vector<size_t> const& membership,
+          double resolution_parameter_01, double resolution_parameter_0, double resolution_parameter_1,
+          double type_base);
+    BipartiteCPMVertexPartition(Graph* graph,
+          double resolution_parameter_01, double resolution_parameter_0, double resolution_parameter_1,
+          double type_base);
+    virtual ~BipartiteCPMVertexPartition();
+    virtual BipartiteCPMVertexPartition* create(Graph* graph);
+    virtual BipartiteCPMVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+
+    virtual double diff_move(size_t v, size_t new_comm);
+    virtual double quality(double resolution_parameter);
+
+    double resolution_parameter_0;
+    double resolution_parameter_1;
+    double type_base;
+
+  protected:
+    inline double penalty(double size, double resolution_parameter_01);
+    inline double possible_edges_without_loops(double n);
+};
+
+/****************************************************************************
+  The penalty is evaluated four times for every candidate move, and is
+  therefore defined inline.
+
+  The layers of class 0 and 1 have no edges, and hence never correct for self
+  loops.
+*****************************************************************************/
+inline double BipartiteCPMVertexPartition::possible_edges_without_loops(double n)
+{
+  double possible_edges = n*(n - 1);
+  if (!this->graph->is_directed())
+    possible_edges /= 2;
+  return possible_edges;
+}
+
+/****************************************************************************
+  The penalty of a community of the given (encoded) size, i.e.
+
+    gamma_01 P(n) - (gamma_01 - gamma_0) P(n_0) - (gamma_01 - gamma_1) P(n_1)
+
+  where n_0 and n_1 are the sizes of both classes and n = n_0 + n_1.
+*****************************************************************************/
+inline double BipartiteCPMVertexPartition::penalty(double size, double resolution_parameter_01)
+{
+  double n_1 = floor(size / this->type_base);
+  double n_0 = size - n_1*this->type_base;
+  return resolution_parameter_01*this->graph->possible_edges(n_0 + n_1)
+       - (resolution_parameter_01 - this->resolution_parameter_0)*this->possible_edges_without_loops(n_0)
+       - (resolution_parameter_01 - this->resolution_parameter_1)*this->possible_edges_without_loops(n_1);
+}
+
+#endif // BIPARTITECPMVERTEXPARTITION_H
@@ -0,0 +1,58 @@
+#ifndef CACHEDSIGNIFICANCEVERTEXPARTITION_H
+#define CACHEDSIGNIFICANCEVERTEXPARTITION_H
+
+#include <libleidenalg/SignificanceVertexPartition.h>
+
+#include <algorithm>
+
+#ifdef DEBUG
+#include <iostream>
+  using std::cerr;
+  using std::endl;
+#endif
+
+/****************************************************************************
+  Significance with the terms N_c KL(q_c, p) of the communities kept between
+  calls to diff_move. Each term is stored together with the size and internal
+  weight of the community it was computed for, and only recomputed once either
+  changed. The term of the old community without the node is also kept, since
+  diff_move is evaluated for the same node and many new communities in a row.
+  Hence, most calls to diff_move only evaluate a single KL divergence rather
+  than four, while the results equal those of SignificanceVertexPartition.
+*****************************************************************************/
+class CachedSignificanceVertexPartition : public SignificanceVertexPartition
+{
+  public:
+    CachedSignificanceVertexPartition(Graph* graph,
+          vector<size_t> const& membership);
+    CachedSignificanceVertexPartition(Graph* graph);
+    virtual ~CachedSignificanceVertexPartition();
+    virtual CachedSignificanceVertexPartition* create(Graph* graph);
+    virtual CachedSignificanceVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+
+    virtual double diff_move(size_t v, size_t new_comm);
+
+    // Same as diff_move, with the weights of v to and from its old and the new
+    // community given, as accumulated by the move loop of the binding.
+    double diff_move(size_t v, size_t new_comm,
+                     double w_to_old, double w_from_old,
+                     double w_to_new, double w_from_new);
+
+  protected:
+    double significance_term(size_t n_c, double m_c, double p);
+    double community_term(size_t comm, double p);
+
+  private:
+    // Terms of the communities and the size and weight they were computed for
+    vector<double> _comm_term;
+    vector<size_t> _comm_term_size;
+    vector<double> _comm_term_weight;
+
+    // Term of the old community of the last node without that node
+    size_t _removed_node;
+    size_t _removed_size;
+    double _removed_weight;
+    double _removed_term;
+};
+
+#endif // CACHEDSIGNIFICANCEVERTEXPARTITION_H
@@ -0,0 +1,45 @@
+#ifndef CACHEDSURPRISEVERTEXPARTITION_H
+#define CACHEDSURPRISEVERTEXPARTITION_H
+
+#include <libleidenalg/SurpriseVertexPartition.h>
+
+#ifdef DEBUG
+#include <iostream>
+  using std::cerr;
+  using std::endl;
+#endif
+
+/****************************************************************************
+  Surprise with the term m KLL(q, s) of the current partition kept between
+  calls to diff_move. It only depends on the total internal weight and the
+  total number of possible internal edges, and is only recomputed once either
+  changed, so that most calls to diff_move only evaluate the term after the
+  move. The results equal those of SurpriseVertexPartition up to rounding.
+*****************************************************************************/
+class CachedSurpriseVertexPartition : public SurpriseVertexPartition
+{
+  public:
+    CachedSurpriseVertexPartition(Graph* graph,
+          vector<size_t> const& membership);
+    CachedSurpriseVertexPartition(Graph* graph);
+    virtual ~CachedSurpriseVertexPartition();
+    virtual CachedSurpriseVertexPartition* create(Graph* graph);
+    virtual CachedSurpriseVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+
+    virtual double diff_move(size_t v, size_t new_comm);
+
+    // Same as diff_move, with the weights of v to and from its old and the new
+    // community given, as accumulated by the move loop of the binding.
+    double diff_move(size_t v, size_t new_comm,
+                     double w_to_old, double w_from_old,
+                     double w_to_new, double w_from_new);
+
+  private:
+    // Term of the current partition and the totals it was computed for
+    bool _has_term;
+    double _term_weight;
+    size_t _term_possible_edges;
+    double _term;
+};
+
+#endif // CACHEDSURPRISEVERTEXPARTITION_H
@@ -0,0 +1,28 @@
+#ifndef SIGNEDMODULARITYVERTEXPARTITION_H
+#define SIGNEDMODULARITYVERTEXPARTITION_H
+
+#include "SignedRBConfigurationVertexPartition.h"
+
+/****************************************************************************
+  Modularity for undirected graphs with both positive and negative weights,
+  i.e. SignedRBConfigurationVertexPartition with a resolution of 1, normalised
+  by the total positive and negative strength.
+*****************************************************************************/
+class SignedModularityVertexPartition : public SignedRBConfigurationVertexPartition
+{
+  public:
+    SignedModularityVertexPartition(Graph* graph,
+          vector<size_t> const& membership);
+    SignedModularityVertexPartition(Graph* graph);
+    virtual ~SignedModularityVertexPartition();
+    virtual SignedModularityVertexPartition* create(Graph* graph);
+    virtual SignedModularityVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+
+    virtual double diff_move(size_t v, size_t new_comm);
+    virtual double quality(double resolution_parameter);
+
+  protected:
+    double normalisation();
+};
+
+#endif // SIGNEDMODULARITYVERTEXPARTITION_H
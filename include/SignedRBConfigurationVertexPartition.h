@@ -0,0 +1,63 @@
+#ifndef SIGNEDRBCONFIGURATIONVERTEXPARTITION_H
+#define SIGNEDRBCONFIGURATIONVERTEXPARTITION_H
+
+#include <libleidenalg/CPMVertexPartition.h>
+
+#include "diff_move_kernels.h"
+
+#ifdef DEBUG
+#include <iostream>
+  using std::cerr;
+  using std::endl;
+#endif
+
+/****************************************************************************
+  RBConfiguration for undirected graphs with both positive and negative
+  weights in a single partition, equivalent to a positive and a negative layer
+  with layer weights [1, -1].
+
+  The (signed) edge weights are kept in the graph, so that the strength of a
+  community is the difference of its positive and negative strength. The
+  negative strength of a node is stored as its node size, so that the
+  negative strength of a community is its size. Both are preserved when
+  collapsing the graph.
+*****************************************************************************/
+class SignedRBConfigurationVertexPartition : public CPMVertexPartition
+{
+  public:
+    SignedRBConfigurationVertexPartition(Graph* graph,
+          vector<size_t> const& membership, double resolution_parameter);
+    SignedRBConfigurationVertexPartition(Graph* graph,
+          vector<size_t> const& membership);
+    SignedRBConfigurationVertexPartition(Graph* graph,
+      double resolution_parameter);
+    SignedRBConfigurationVertexPartition(Graph* graph);
+    virtual ~SignedRBConfigurationVertexPartition();
+    virtual SignedRBConfigurationVertexPartition* create(Graph* graph);
+    virtual SignedRBConfigurationVertexPartition* create(Graph* graph, vector<size_t> const& membership);
+
+    virtual double diff_move(size_t v, size_t new_comm);
+    virtual double quality(double resolution_parameter);
+
+  protected:
+    double diff_move_signed(size_t v, size_t new_comm, double resolution_parameter);
+    double quality_signed(double resolution_parameter);
+    inline double total_positive_strength();
+    inline double total_negative_strength();
+};
+
+/****************************************************************************
+  The total negative strength equals the total node size, and the total
+  positive strength the total (signed) strength plus the negative strength.
+*****************************************************************************/
+inline double SignedRBConfigurationVertexPartition::total_negative_strength()
+{
+  return this->graph->total_size();
+}
+
+inline double SignedRBConfigurationVertexPartition::total_positive_strength()
+{
+  return 2.0*this->graph->total_weight() + this->graph->total_size();
+}
+
+#endif // SIGNEDRBCONFIGURATIONVERTEXPARTITION_H
@@ -0,0 +1,208 @@
+#ifndef DIFF_MOVE_KERNELS_H
+#define DIFF_MOVE_KERNELS_H
+
+#include <libleidenalg/GraphHelper.h>
+#include <libleidenalg/MutableVertexPartition.h>
+#include <libleidenalg/ModularityVertexPartition.h>
+#include <libleidenalg/RBConfigurationVertexPartition.h>
+#include <libleidenalg/CPMVertexPartition.h>
+#include <libleidenalg/RBERVertexPartition.h>
+
+#include "CachedSignificanceVertexPartition.h"
+#include "CachedSurpriseVertexPartition.h"
+
+#include <typeinfo>
+
+/****************************************************************************
+  Difference in the (directed) weight within communities when moving node v
+  from old_comm to new_comm, i.e. the edge term of CPMVertexPartition::diff_move.
+
+  Calling CPMVertexPartition::diff_move for this evaluates the CPM penalty and
+  the cache of incoming neighbour communities for every candidate. The
+  partitions of this package add their own penalty, and for undirected graphs
+  the weight from a community equals the weight to it, so both are skipped.
+*****************************************************************************/
+inline double diff_move_weight(MutableVertexPartition* partition, Graph* graph,
+                               size_t v, size_t old_comm, size_t new_comm)
+{
+  double self_weight = graph->node_self_weight(v);
+  double w_to_old = partition->weight_to_comm(v, old_comm);
+  double w_to_new = partition->weight_to_comm(v, new_comm);
+  if (!graph->is_directed())
+    return 2.0*(w_to_new - w_to_old + self_weight);
+
+  double w_from_old = partition->weight_from_comm(v, old_comm);
+  double w_from_new = partition->weight_from_comm(v, new_comm);
+  return (w_to_new + w_from_new) - (w_to_old + w_from_old) + 2.0*self_weight;
+}
+
+/****************************************************************************
+  Kernels of diff_move for the move loop of the binding, see move_nodes_fused.
+
+  The loop accumulates the weights of a node to and from the communities of
+  its neighbours once per node, and passes them to the kernel of each
+  candidate community. The kernels compute the same difference as diff_move
+  of their partition, without the virtual call and without looking up the
+  weights in the neighbour caches of the partition. Partitions of any other
+  type, including subclasses of these types, use KERNEL_VIRTUAL.
+*****************************************************************************/
+enum diff_move_kernel_t
+{
+  KERNEL_VIRTUAL = 0,
+  KERNEL_MODULARITY = 1,
+  KERNEL_RB_CONFIGURATION = 2,
+  KERNEL_CPM = 3,
+  KERNEL_RBER = 4,
+  KERNEL_SIGNIFICANCE = 5,
+  KERNEL_SURPRISE = 6,
+  KERNEL_MIXED = 7    // Layers with different kernels
+};
+
+// Move of node v from old_comm to new_comm, with the weights of v to and
+// from both communities. For undirected graphs the weights from a community
+// equal the weights to it.
+struct node_move_t
+{
+  size_t v;
+  size_t old_comm;
+  size_t new_comm;
+  double w_to_old;
+  double w_from_old;
+  double w_to_new;
+  double w_from_new;
+};
+
+inline int diff_move_kernel(MutableVertexPartition* partition)
+{
+  std::type_info const& type = typeid(*partition);
+  if (type == typeid(ModularityVertexPartition))
+    return KERNEL_MODULARITY;
+  else if (type == typeid(RBConfigurationVertexPartition))
+    return KERNEL_RB_CONFIGURATION;
+  else if (type == typeid(CPMVertexPartition))
+    return KERNEL_CPM;
+  else if (type == typeid(RBERVertexPartition))
+    return KERNEL_RBER;
+  else if (type == typeid(CachedSignificanceVertexPartition))
+    return KERNEL_SIGNIFICANCE;
+  else if (type == typeid(CachedSurpriseVertexPartition))
+    return KERNEL_SURPRISE;
+  return KERNEL_VIRTUAL;
+}
+
+// Edge and null model terms of ModularityVertexPartition::diff_move and
+// RBConfigurationVertexPartition::diff_move, the null model scaled by gamma.
+inline double diff_move_configuration(MutableVertexPartition* partition, Graph* graph,
+                                      node_move_t const& move, double gamma)
+{
+  double total_weight = graph->total_weight()*(2.0 - graph->is_directed());
+  if (total_weight == 0.0 || move.new_comm == move.old_comm)
+    return 0.0;
+  size_t v = move.v;
+  double k_out = graph->strength(v, IGRAPH_OUT);
+  double k_in = graph->strength(v, IGRAPH_IN);
+  double self_weight = graph->node_self_weight(v);
+  double K_out_old = partition->total_weight_from_comm(move.old_comm);
+  double K_in_old = partition->total_weight_to_comm(move.old_comm);
+  double K_out_new = partition->total_weight_from_comm(move.new_comm) + k_out;
+  double K_in_new = partition->total_weight_to_comm(move.new_comm) + k_in;
+  double diff_old = (move.w_to_old - gamma*k_out*K_in_old/total_weight) +
+                    (move.w_from_old - gamma*k_in*K_out_old/total_weight);
+  double diff_new = (move.w_to_new + self_weight - gamma*k_out*K_in_new/total_weight) +
+                    (move.w_from_new + self_weight - gamma*k_in*K_out_new/total_weight);
+  return diff_new - diff_old;
+}
+
+// Edge and penalty terms of CPMVertexPartition::diff_move and
+// RBERVertexPartition::diff_move, the penalty scaled by gamma.
+inline double diff_move_penalty(MutableVertexPartition* partition, Graph* graph,
+                                node_move_t const& move, double gamma)
+{
+  if (move.new_comm == move.old_comm)
+    return 0.0;
+  double nsize = graph->node_size(move.v);
+  double csize_old = partition->csize(move.old_comm);
+  double csize_new = partition->csize(move.new_comm);
+  double self_weight = graph->node_self_weight(move.v);
+  double self_loops = graph->correct_self_loops() ? 0.0 : 1.0;
+  double possible_edge_difference_old = nsize*(2.0*csize_old - nsize - self_loops);
+  double possible_edge_difference_new = nsize*(2.0*csize_new + nsize - self_loops);
+  double diff_old = move.w_to_old + move.w_from_old - self_weight - gamma*possible_edge_difference_old;
+  double diff_new = move.w_to_new + move.w_from_new + self_weight - gamma*possible_edge_difference_new;
+  return diff_new - diff_old;
+}
+
+template <int kernel>
+inline double kernel_diff_move(MutableVertexPartition* partition, node_move_t const& move)
+{
+  return partition->diff_move(move.v, move.new_comm);
+}
+
+template <>
+inline double kernel_diff_move<KERNEL_MODULARITY>(MutableVertexPartition* partition, node_move_t const& move)
+{
+  Graph* graph = partition->get_graph();
+  double m = graph->total_weight()*(2.0 - graph->is_directed());
+  if (m == 0.0)
+    return 0.0;
+  return diff_move_configuration(partition, graph, move, 1.0)/m;
+}
+
+template <>
+inline double kernel_diff_move<KERNEL_RB_CONFIGURATION>(MutableVertexPartition* partition, node_move_t const& move)
+{
+  double gamma = static_cast<RBConfigurationVertexPartition*>(partition)->resolution_parameter;
+  return diff_move_configuration(partition, partition->get_graph(), move, gamma);
+}
+
+template <>
+inline double kernel_diff_move<KERNEL_CPM>(MutableVertexPartition* partition, node_move_t const& move)
+{
+  double gamma = static_cast<CPMVertexPartition*>(partition)->resolution_parameter;
+  return diff_move_penalty(partition, partition->get_graph(), move, gamma);
+}
+
+template <>
+inline double kernel_diff_move<KERNEL_RBER>(MutableVertexPartition* partition, node_move_t const& move)
+{
+  Graph* graph = partition->get_graph();
+  double gamma = static_cast<RBERVertexPartition*>(partition)->resolution_parameter*graph->density();
+  return diff_move_penalty(partition, graph, move, gamma);
+}
+
+template <>
+inline double kernel_diff_move<KERNEL_SIGNIFICANCE>(MutableVertexPartition* partition, node_move_t const& move)
+{
+  return static_cast<CachedSignificanceVertexPartition*>(partition)->diff_move(
+    move.v, move.new_comm, move.w_to_old, move.w_from_old, move.w_to_new, move.w_from_new);
+}
+
+template <>
+inline double kernel_diff_move<KERNEL_SURPRISE>(MutableVertexPartition* partition, node_move_t const& move)
+{
+  return static_cast<CachedSurpriseVertexPartition*>(partition)->diff_move(
+    move.v, move.new_comm, move.w_to_old, move.w_from_old, move.w_to_new, move.w_from_new);
+}
+
+// Kernel only known at run time, for layers with different kernels
+inline double kernel_diff_move(int kernel, MutableVertexPartition* partition, node_move_t const& move)
+{
+  switch (kernel)
+  {
+    case KERNEL_MODULARITY:
+      return kernel_diff_move<KERNEL_MODULARITY>(partition, move);
+    case KERNEL_RB_CONFIGURATION:
+      return kernel_diff_move<KERNEL_RB_CONFIGURATION>(partition, move);
+    case KERNEL_CPM:
+      return kernel_diff_move<KERNEL_CPM>(partition, move);
+    case KERNEL_RBER:
+      return kernel_diff_move<KERNEL_RBER>(partition, move);
+    case KERNEL_SIGNIFICANCE:
+      return kernel_diff_move<KERNEL_SIGNIFICANCE>(partition, move);
+    case KERNEL_SURPRISE:
+      return kernel_diff_move<KERNEL_SURPRISE>(partition, move);
+  }
+  return kernel_diff_move<KERNEL_VIRTUAL>(partition, move);
+}
+
+#endif // DIFF_MOVE_KERNELS_H
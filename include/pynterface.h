@@ -14,6 +14,7 @@
 
 #include "python_partition_interface.h"
 #include "python_optimiser_interface.h"
+#include "python_graph_interface.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -28,17 +29,22 @@ extern "C"
       {"_new_SignificanceVertexPartition",                          (PyCFunction)_new_SignificanceVertexPartition,                          METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_SurpriseVertexPartition",                              (PyCFunction)_new_SurpriseVertexPartition,                              METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_CPMVertexPartition",                                   (PyCFunction)_new_CPMVertexPartition,                                   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_BipartiteCPMVertexPartition",                          (PyCFunction)_new_BipartiteCPMVertexPartition,                          METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_RBERVertexPartition",                                  (PyCFunction)_new_RBERVertexPartition,                                  METH_VARARGS | METH_KEYWORDS, ""},
       {"_new_RBConfigurationVertexPartition",                       (PyCFunction)_new_RBConfigurationVertexPartition,                       METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_SignedRBConfigurationVertexPartition",                 (PyCFunction)_new_SignedRBConfigurationVertexPartition,                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_new_SignedModularityVertexPartition",                      (PyCFunction)_new_SignedModularityVertexPartition,                      METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_MutableVertexPartition_diff_move",                         (PyCFunction)_MutableVertexPartition_diff_move,                         METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_move_node",                         (PyCFunction)_MutableVertexPartition_move_node,                         METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_get_py_igraph",                     (PyCFunction)_MutableVertexPartition_get_py_igraph,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_aggregate_partition",               (PyCFunction)_MutableVertexPartition_aggregate_partition,               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_share_graph",                       (PyCFunction)_MutableVertexPartition_share_graph,                       METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_from_coarse_partition",             (PyCFunction)_MutableVertexPartition_from_coarse_partition,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_renumber_communities",              (PyCFunction)_MutableVertexPartition_renumber_communities,              METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_MutableVertexPartition_quality",                           (PyCFunction)_MutableVertexPartition_quality,                           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_quality_batch",                     (PyCFunction)_MutableVertexPartition_quality_batch,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_total_weight_in_comm",              (PyCFunction)_MutableVertexPartition_total_weight_in_comm,              METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_total_weight_from_comm",            (PyCFunction)_MutableVertexPartition_total_weight_from_comm,            METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_total_weight_to_comm",              (PyCFunction)_MutableVertexPartition_total_weight_to_comm,              METH_VARARGS | METH_KEYWORDS, ""},
@@ -48,18 +54,23 @@ extern "C"
       {"_MutableVertexPartition_weight_from_comm",                  (PyCFunction)_MutableVertexPartition_weight_from_comm,                  METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_get_membership",                    (PyCFunction)_MutableVertexPartition_get_membership,                    METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_set_membership",                    (PyCFunction)_MutableVertexPartition_set_membership,                    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_memory_usage",                      (PyCFunction)_MutableVertexPartition_memory_usage,                      METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_get_resolution",        (PyCFunction)_ResolutionParameterVertexPartition_get_resolution,        METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_set_resolution",        (PyCFunction)_ResolutionParameterVertexPartition_set_resolution,        METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_quality",               (PyCFunction)_ResolutionParameterVertexPartition_quality,               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_BipartiteCPMVertexPartition_get_parameters",               (PyCFunction)_BipartiteCPMVertexPartition_get_parameters,               METH_VARARGS | METH_KEYWORDS, ""},
 
 
       {"_new_Optimiser",                            (PyCFunction)_new_Optimiser,                            METH_NOARGS,                  ""},
       {"_Optimiser_optimise_partition",             (PyCFunction)_Optimiser_optimise_partition,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_optimise_partition_multiplex",   (PyCFunction)_Optimiser_optimise_partition_multiplex,   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_optimise_partition_lean_multiplex", (PyCFunction)_Optimiser_optimise_partition_lean_multiplex, METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_move_nodes",                     (PyCFunction)_Optimiser_move_nodes,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_move_nodes_constrained",         (PyCFunction)_Optimiser_move_nodes_constrained,         METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_merge_nodes",                    (PyCFunction)_Optimiser_merge_nodes,                    METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_merge_nodes_constrained",        (PyCFunction)_Optimiser_merge_nodes_constrained,        METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_consensus_partition",            (PyCFunction)_Optimiser_consensus_partition,            METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_find_partitions_batch",          (PyCFunction)_Optimiser_find_partitions_batch,          METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_set_consider_comms",             (PyCFunction)_Optimiser_set_consider_comms,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_refine_consider_comms",      (PyCFunction)_Optimiser_set_refine_consider_comms,      METH_VARARGS | METH_KEYWORDS, ""},
@@ -70,6 +81,8 @@ extern "C"
       {"_Optimiser_set_min_comm_size",              (PyCFunction)_Optimiser_set_min_comm_size,              METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_max_comm_size",              (PyCFunction)_Optimiser_set_max_comm_size,              METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_community_constraint_enforcement", (PyCFunction)_Optimiser_set_community_constraint_enforcement, METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_fused_moves",                (PyCFunction)_Optimiser_set_fused_moves,                METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_all_comms_candidates",       (PyCFunction)_Optimiser_set_all_comms_candidates,       METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_get_consider_comms",             (PyCFunction)_Optimiser_get_consider_comms,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_refine_consider_comms",      (PyCFunction)_Optimiser_get_refine_consider_comms,      METH_VARARGS | METH_KEYWORDS, ""},
@@ -80,8 +93,18 @@ extern "C"
       {"_Optimiser_get_min_comm_size",              (PyCFunction)_Optimiser_get_min_comm_size,              METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_max_comm_size",              (PyCFunction)_Optimiser_get_max_comm_size,              METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_community_constraint_enforcement", (PyCFunction)_Optimiser_get_community_constraint_enforcement, METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_fused_moves",                (PyCFunction)_Optimiser_get_fused_moves,                METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_all_comms_candidates",       (PyCFunction)_Optimiser_get_all_comms_candidates,       METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_set_rng_seed",                   (PyCFunction)_Optimiser_set_rng_seed,                   METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_start",                          (PyCFunction)_Optimiser_start,                          METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_cancel",                         (PyCFunction)_Optimiser_cancel,                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_status",                     (PyCFunction)_Optimiser_get_status,                     METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_peak_memory_usage",          (PyCFunction)_Optimiser_get_peak_memory_usage,          METH_VARARGS | METH_KEYWORDS, ""},
+
+      {"_temporal_layers",                          (PyCFunction)_temporal_layers,                          METH_VARARGS | METH_KEYWORDS, ""},
+      {"_node_order",                               (PyCFunction)_node_order,                               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_graph_memory_usage",                       (PyCFunction)_graph_memory_usage,                       METH_VARARGS | METH_KEYWORDS, ""},
 
       {NULL}
   };
@@ -102,44 +125,53 @@ extern "C"
       return 0;
   }
 
+  static int leiden_exec(PyObject *module) {
+      if (PyModule_AddIntConstant(module, "ALL_COMMS", Optimiser::ALL_COMMS) < 0 ||
+          PyModule_AddIntConstant(module, "ALL_NEIGH_COMMS", Optimiser::ALL_NEIGH_COMMS) < 0 ||
+          PyModule_AddIntConstant(module, "RAND_COMM", Optimiser::RAND_COMM) < 0 ||
+          PyModule_AddIntConstant(module, "RAND_NEIGH_COMM", Optimiser::RAND_NEIGH_COMM) < 0 ||
+          PyModule_AddIntConstant(module, "PRUNED_ALL_COMMS", PRUNED_ALL_COMMS) < 0)
+          return -1;
+
+      if (PyModule_AddIntConstant(module, "MOVE_NODES", Optimiser::MOVE_NODES) < 0 ||
+          PyModule_AddIntConstant(module, "MERGE_NODES", Optimiser::MERGE_NODES) < 0)
+          return -1;
+
+      struct module_state *st = GETSTATE(module);
+
+      st->error = PyErr_NewException("leidenalg.Error", NULL, NULL);
+      if (st->error == NULL)
+          return -1;
+
+      return 0;
+  }
+
+  // The module keeps no global state, and the optimisers and partitions lock
+  // themselves where needed, so the module can run without the GIL.
+  static PyModuleDef_Slot leiden_slots[] = {
+      {Py_mod_exec, (void*)leiden_exec},
+  #ifdef Py_GIL_DISABLED
+      {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+  #endif
+      {0, NULL}
+  };
+
   static struct PyModuleDef leidendef = {
           PyModuleDef_HEAD_INIT,
           "_c_leiden",
           NULL,
           sizeof(struct module_state),
           leiden_funcs,
-          NULL,
+          leiden_slots,
           leiden_traverse,
           leiden_clear,
           NULL
   };
 
-  #define INITERROR return NULL
-
   PyObject *
   PyInit__c_leiden(void)
   {
-      PyObject* module = PyModule_Create(&leidendef);
-
-      PyModule_AddIntConstant(module, "ALL_COMMS", Optimiser::ALL_COMMS);
-      PyModule_AddIntConstant(module, "ALL_NEIGH_COMMS", Optimiser::ALL_NEIGH_COMMS);
-      PyModule_AddIntConstant(module, "RAND_COMM", Optimiser::RAND_COMM);
-      PyModule_AddIntConstant(module, "RAND_NEIGH_COMM", Optimiser::RAND_NEIGH_COMM);
-
-      PyModule_AddIntConstant(module, "MOVE_NODES", Optimiser::MOVE_NODES);
-      PyModule_AddIntConstant(module, "MERGE_NODES", Optimiser::MERGE_NODES);
-
-      if (module == NULL)
-          INITERROR;
-      struct module_state *st = GETSTATE(module);
-
-      st->error = PyErr_NewException("leidenalg.Error", NULL, NULL);
-      if (st->error == NULL) {
-          Py_DECREF(module);
-          INITERROR;
-      }
-
-      return module;
+      return PyModuleDef_Init(&leidendef);
   }
 
 #ifdef __cplusplus
@@ -0,0 +1,92 @@
+#ifndef PYNTERFACE_GRAPH_H_INCLUDED
+#define PYNTERFACE_GRAPH_H_INCLUDED
+
+#include <Python.h>
+#include <igraph/igraph.h>
+#include <libleidenalg/GraphHelper.h>
+
+#include <unordered_map>
+#include <sstream>
+
+#ifdef DEBUG
+#include <iostream>
+  using std::cerr;
+  using std::endl;
+#endif
+
+using std::unordered_map;
+
+struct memory_usage_t
+{
+  size_t adjacency = 0;
+  size_t weights = 0;
+  size_t nodes = 0;
+  size_t membership = 0;
+  size_t communities = 0;
+  size_t community_caches = 0;
+  size_t aggregation = 0;
+
+  size_t total() const
+  {
+    return adjacency + weights + nodes + membership + communities + community_caches;
+  }
+
+  // Excluding the graph, for partitions that share a graph
+  size_t partition() const
+  {
+    return membership + communities + community_caches;
+  }
+};
+
+// Snapshot of the items of a Python sequence, taken as a tuple. The items are
+// owned by the tuple, so that they stay valid when the sequence is modified by
+// another thread, also on free-threaded builds or while the GIL is released.
+// Without a sequence, the snapshot is empty and py_tuple is NULL, with the
+// Python error set.
+struct py_snapshot_t
+{
+  py_snapshot_t(PyObject* py_sequence);
+  ~py_snapshot_t();
+  py_snapshot_t(py_snapshot_t const&) = delete;
+  py_snapshot_t& operator=(py_snapshot_t const&) = delete;
+
+  size_t size() const { return n; }
+  PyObject* operator[](size_t i) const { return PyTuple_GetItem(py_tuple, i); }
+
+  PyObject* py_tuple;
+  size_t n;
+};
+
+memory_usage_t estimate_graph_memory_usage(size_t n, size_t m);
+PyObject* memory_usage_to_py(memory_usage_t const& usage, bool with_partition);
+
+bool index_slice_ids(const int64_t* ids, size_t n, size_t offset, unordered_map<int64_t, size_t>& index);
+void join_slice_ids(unordered_map<int64_t, size_t> const& index_v, const int64_t* ids_u, size_t n_u, size_t offset_u, vector<int64_t>& edges);
+bool join_coupled_slices(vector<const int64_t*> const& ids, vector<size_t> const& n, vector<size_t> const& offset,
+                         vector< std::pair<size_t, size_t> > const& coupling,
+                         vector< vector<int64_t> >& edges, size_t* failed_slice);
+void slice_edges(igraph_t* graph, size_t offset, vector<int64_t>& edges);
+PyObject* packed_int64_list(vector< vector<int64_t> > const& values);
+// Scratch space of node_order, which may be kept by the caller across calls
+struct node_order_scratch_t
+{
+  vector<size_t> degree;
+  vector<size_t> start;
+  vector<size_t> neighbours;
+  vector<bool> visited;
+};
+
+void node_order(Graph* graph, string const& method, vector<size_t>& order, node_order_scratch_t& scratch);
+vector<size_t> node_order(Graph* graph, string const& method);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+  PyObject* _temporal_layers(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _node_order(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _graph_memory_usage(PyObject *self, PyObject *args, PyObject *keywds);
+#ifdef __cplusplus
+}
+#endif
+#endif // PYNTERFACE_GRAPH_H_INCLUDED
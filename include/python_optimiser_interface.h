@@ -13,6 +13,18 @@
 #include <libleidenalg/Optimiser.h>
 
 #include "python_partition_interface.h"
+#include "diff_move_kernels.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <deque>
+#include <set>
+#include <limits>
+#include <tuple>
+#include <functional>
+#include <algorithm>
 
 #ifdef DEBUG
 #include <iostream>
@@ -20,9 +32,202 @@
   using std::endl;
 #endif
 
+// Consider the neighbouring communities first, and then verify with all
+// communities. This is not a setting of libleidenalg, but of the binding.
+const int PRUNED_ALL_COMMS = 5;
+
+// Outcome of the last optimisation of an optimiser
+enum optimise_status_t
+{
+  OPTIMISE_COMPLETE = 0,
+  OPTIMISE_TIME_BUDGET = 1,
+  OPTIMISE_CANCELLED = 2,
+  OPTIMISE_INTERRUPTED = 3
+};
+
+// Progress of a running optimisation, over all its iterations
+struct optimise_progress_t
+{
+  size_t iteration;        // Iteration of the Leiden algorithm, from 0
+  size_t level;            // Aggregation level in the iteration, 0 is the original graph
+  size_t level_nodes;      // Number of nodes at this level
+  size_t nodes_processed;  // Number of nodes of all levels so far
+  size_t moves;            // Number of nodes of all levels so far that changed community,
+                           // matching the communities before and after each level
+  double improvement;      // Improvement in quality so far
+};
+
+// Key by which the candidate index of ALL_COMMS orders the communities, see
+// comm_index_key
+enum comm_index_key_t
+{
+  COMM_INDEX_NONE = 0,          // No index, all communities are considered
+  COMM_INDEX_SIZE = 1,          // Size of the community
+  COMM_INDEX_TOTAL_WEIGHT = 2   // Total weight from and to the community
+};
+
+// Native progress callback, passed as a capsule named
+// "leidenalg.progress_callback" whose context is passed as data. A non-zero
+// return value cancels the optimisation.
+typedef int (*progress_callback_t)(optimise_progress_t const* progress, void* data);
+
+// Settings of the binding and scratch space of optimise_partition_levels.
+// Every optimiser keeps one, so that the vectors of the aggregation levels
+// keep their memory across levels and across calls.
+struct optimiser_workspace_t
+{
+  bool pruned_all_comms = false;
+
+  // Deadline of the time budget, if any, a request to cancel, which may come
+  // from another thread, and the outcome of the last optimisation.
+  bool has_deadline = false;
+  std::chrono::steady_clock::time_point deadline;
+  std::atomic<bool> cancel_requested{false};
+  int status = OPTIMISE_COMPLETE;
+
+  // Whether polling the status also checks for signals, which takes the GIL.
+  // Workspaces of worker threads, which cannot receive signals, skip this.
+  bool check_signals = true;
+
+  // Progress of the running optimisation, reported to the progress callback
+  // at most once every progress interval. The callback is borrowed for the
+  // duration of a call, and is NULL otherwise.
+  optimise_progress_t progress = optimise_progress_t();
+  PyObject* progress_callback = NULL;
+  progress_callback_t native_progress = NULL;
+  void* native_progress_data = NULL;
+  std::chrono::steady_clock::duration progress_interval;
+  std::chrono::steady_clock::time_point last_progress;
+  bool has_reported = false;
+  vector<size_t> level_membership;
+
+  // Largest estimated memory held by the graphs and partitions of all levels
+  // at the same time, over all calls.
+  size_t peak_memory_usage = 0;
+
+  // Local moving of the binding, see move_nodes_fused, with its own random
+  // number generator and scratch space.
+  bool fused_moves = false;
+  std::mt19937_64 rng{std::random_device()()};
+  std::deque<size_t> node_queue;
+  vector<size_t> nodes;
+  vector<bool> is_node_stable;
+  vector<size_t> candidate_comms;
+  vector<bool> is_candidate_comm;
+  vector<size_t> constrained_neighbours;
+  vector<int> layer_kernels;
+  vector<community_accumulator_t> weight_to_comms;
+  vector<community_accumulator_t> weight_from_comms;
+
+  // Candidate index of ALL_COMMS for the local moving of the binding: whether
+  // it is used, and how many communities besides the neighbouring ones it
+  // yields, where 0 yields only those that keep the result exact.
+  bool candidate_index = false;
+  size_t candidate_limit = 0;
+  std::set< std::pair<double, size_t> > comm_index;
+  vector<double> comm_index_values;
+  vector<bool> is_indexed_comm;
+
+  vector<size_t> fixed_nodes;
+  vector<size_t> fixed_membership;
+  vector<size_t> aggregate_node_per_individual_node;
+  vector<size_t> new_collapsed_membership;
+  vector<bool> is_collapsed_membership_fixed;
+  vector<Graph*> collapsed_graphs;
+  vector<Graph*> new_collapsed_graphs;
+  vector<MutableVertexPartition*> collapsed_partitions;
+  vector<MutableVertexPartition*> new_collapsed_partitions;
+  vector<MutableVertexPartition*> sub_collapsed_partitions;
+  aggregation_workspace_t aggregation;
+};
+
+// Nodes of the layers of a multiplex partition in which each layer only
+// contains the nodes that are active in it, see optimise_partition_lean. A
+// level of the optimisation and its refinement share these.
+struct lean_layers_t
+{
+  vector<double> node_sizes;                          // Number of individual nodes of each node of the multiplex
+  vector< vector<size_t> > layer_nodes;               // Node of the multiplex of each node of each layer
+  vector<size_t> appearance_offsets;                  // First appearance of each node of the multiplex
+  vector< std::pair<size_t, size_t> > appearances;    // Layer and node of the layer of each appearance
+};
+
+// Partition of the nodes of lean_layers_t. The membership of the multiplex is
+// kept here, and each layer maps the communities of the multiplex with nodes
+// in the layer to its own communities.
+struct lean_partition_t
+{
+  lean_layers_t const* layers = NULL;
+  vector<MutableVertexPartition*> partitions;
+  vector< unordered_map<size_t, size_t> > layer_comms;
+  vector<size_t> membership;
+  vector<double> comm_sizes;                          // Number of individual nodes of each community
+  vector<size_t> comm_nodes;                          // Number of nodes of each community
+  vector<size_t> empty_comms;
+};
+
 PyObject* capsule_Optimiser(Optimiser* optimiser);
 Optimiser* decapsule_Optimiser(PyObject* py_optimiser);
+optimiser_workspace_t* decapsule_Optimiser_workspace(PyObject* py_optimiser);
 void del_Optimiser(PyObject* py_optimiser);
+vector<bool> create_is_membership_fixed(PyObject* py_is_membership_fixed, PyObject* py_fixed_nodes, size_t n);
+void copy_optimiser_settings(Optimiser* source, Optimiser* target);
+void copy_optimiser_settings(Optimiser* source, Optimiser* target,
+                             optimiser_workspace_t const* source_workspace, optimiser_workspace_t* target_workspace);
+double optimise_partition_iterations(Optimiser* optimiser, MutableVertexPartition* partition, int n_iterations,
+                                     optimiser_workspace_t* workspace = NULL,
+                                     int aggregate_order = AGGREGATE_ORDER_NONE);
+bool uses_optimise_driver(optimiser_workspace_t const* workspace, int aggregate_order, bool return_levels);
+double optimise_partition_run(Optimiser* optimiser,
+                              vector<MutableVertexPartition*> const& partitions,
+                              vector<double> const& layer_weights,
+                              vector<bool> const& is_membership_fixed,
+                              int aggregate_order,
+                              vector< vector<size_t> >* levels,
+                              optimiser_workspace_t* workspace);
+double optimise_partition_levels(Optimiser* optimiser,
+                                 vector<MutableVertexPartition*> partitions,
+                                 vector<double> const& layer_weights,
+                                 vector<bool> const& is_membership_fixed,
+                                 int aggregate_order,
+                                 vector< vector<size_t> >* levels,
+                                 optimiser_workspace_t* workspace = NULL);
+double move_nodes_pruned(Optimiser* optimiser, vector<MutableVertexPartition*> partitions,
+                         vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                         bool renumber);
+double merge_nodes_pruned(Optimiser* optimiser, vector<MutableVertexPartition*> partitions,
+                          vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                          bool renumber);
+bool supports_fused_moves(Optimiser* optimiser);
+int comm_index_key(vector<MutableVertexPartition*> const& partitions, int kernel, bool* is_exact);
+double comm_index_value(MutableVertexPartition* partition, int key, size_t comm);
+double comm_index_coefficient(MutableVertexPartition* partition, int kernel, size_t v);
+double move_nodes_fused(Optimiser* optimiser, vector<MutableVertexPartition*> const& partitions,
+                        vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                        int consider_comms, bool merge, MutableVertexPartition* constrained_partition,
+                        optimiser_workspace_t* workspace);
+int poll_optimise_status(optimiser_workspace_t* workspace);
+size_t count_moved_nodes(vector<size_t> const& before, vector<size_t> const& after);
+int report_progress(optimiser_workspace_t* workspace);
+bool set_progress_callback(optimiser_workspace_t* workspace, PyObject* py_progress, double progress_interval);
+void release_level(vector<MutableVertexPartition*> const& partitions,
+                   vector<Graph*>& level_graphs, vector<MutableVertexPartition*>& level_partitions);
+void release_sub_partitions(optimiser_workspace_t* workspace);
+void release_levels(vector<MutableVertexPartition*> const& partitions, optimiser_workspace_t* workspace);
+void track_memory_usage(vector<MutableVertexPartition*> const& partitions, optimiser_workspace_t* workspace);
+void index_lean_layers(lean_layers_t& layers);
+void set_lean_membership(lean_partition_t& partition, vector<size_t> const& membership);
+double lean_diff_move(lean_partition_t& partition, vector<double> const& layer_weights, size_t v, size_t comm);
+void lean_move_node(lean_partition_t& partition, size_t v, size_t comm);
+double move_nodes_lean(Optimiser* optimiser, lean_partition_t& partition, vector<double> const& layer_weights,
+                       bool merge, vector<size_t> const* constrained_membership, optimiser_workspace_t* workspace);
+void release_lean_partition(lean_partition_t& partition, bool release_graphs);
+double optimise_partition_lean(Optimiser* optimiser,
+                               vector<MutableVertexPartition*> const& partitions,
+                               vector< vector<size_t> > const& layer_nodes,
+                               vector<double> const& layer_weights,
+                               vector<size_t>& membership,
+                               optimiser_workspace_t* workspace);
 
 #ifdef __cplusplus
 extern "C"
@@ -31,10 +236,13 @@ extern "C"
   PyObject* _new_Optimiser(PyObject *self, PyObject *args);
   PyObject* _Optimiser_optimise_partition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_optimise_partition_multiplex(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_optimise_partition_lean_multiplex(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_move_nodes(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_move_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_merge_nodes(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_merge_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_consensus_partition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_find_partitions_batch(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _Optimiser_set_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_refine_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
@@ -45,7 +253,13 @@ extern "C"
   PyObject* _Optimiser_set_min_comm_size(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_max_comm_size(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_community_constraint_enforcement(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_fused_moves(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_all_comms_candidates(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_rng_seed(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_start(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_cancel(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_status(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_peak_memory_usage(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _Optimiser_get_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_refine_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
@@ -56,6 +270,8 @@ extern "C"
   PyObject* _Optimiser_get_min_comm_size(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_max_comm_size(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_community_constraint_enforcement(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_fused_moves(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_all_comms_candidates(PyObject *self, PyObject *args, PyObject *keywds);
 
 #ifdef __cplusplus
 }
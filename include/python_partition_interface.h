@@ -12,7 +12,17 @@
 #include <libleidenalg/CPMVertexPartition.h>
 #include <libleidenalg/Optimiser.h>
 
+#include "BipartiteCPMVertexPartition.h"
+#include "SignedRBConfigurationVertexPartition.h"
+#include "SignedModularityVertexPartition.h"
+#include "CachedSignificanceVertexPartition.h"
+#include "CachedSurpriseVertexPartition.h"
+#include "python_graph_interface.h"
+
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <memory>
 
 #ifdef DEBUG
 #include <iostream>
@@ -29,11 +39,97 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_node_sizes, PyO
 
 vector<size_t> create_size_t_vector(PyObject* py_list);
 
-PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition);
+// Mutex of the graph of a partition. Partitions that share a graph (see
+// _MutableVertexPartition_share_graph) share its mutex, since the neighbour
+// caches of a Graph are written when their nodes move.
+typedef std::shared_ptr<std::recursive_mutex> graph_mutex_t;
+
+PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition,
+                                         graph_mutex_t const& graph_mutex = graph_mutex_t());
 MutableVertexPartition* decapsule_MutableVertexPartition(PyObject* py_partition);
+graph_mutex_t decapsule_graph_mutex(PyObject* py_partition);
 
 void del_MutableVertexPartition(PyObject *self);
 
+// Locks the partitions used by an optimiser or by a direct call for as long as
+// it exists, as an optimiser runs without the GIL. Each partition capsule
+// carries the mutex of its graph, so that partitions sharing a graph are also
+// locked against each other. Waiting for a lock releases the GIL, so that the
+// thread that holds it can finish. The mutex is recursive, so that a progress
+// callback may still query the partition that is being optimised.
+struct partition_lock_t
+{
+  partition_lock_t(vector<PyObject*> const& py_partitions);
+  ~partition_lock_t();
+
+  vector<std::recursive_mutex*> mutexes;
+};
+
+memory_usage_t estimate_memory_usage(MutableVertexPartition* partition);
+
+// Sparse accumulator of weights per community. The dense arrays are indexed by
+// community and only grow, while the touched communities are listed so that
+// clearing costs time proportional to their number rather than to the number
+// of communities. This allows to keep one accumulator across nodes and levels.
+struct community_accumulator_t
+{
+  vector<double> weight;
+  vector<bool> is_touched;
+  vector<size_t> touched;
+
+  void reserve(size_t nb_comms)
+  {
+    if (weight.size() < nb_comms)
+    {
+      weight.resize(nb_comms, 0.0);
+      is_touched.resize(nb_comms, false);
+    }
+  }
+
+  void add(size_t comm, double w)
+  {
+    if (!is_touched[comm])
+    {
+      is_touched[comm] = true;
+      touched.push_back(comm);
+    }
+    weight[comm] += w;
+  }
+
+  void clear()
+  {
+    for (size_t comm : touched)
+    {
+      weight[comm] = 0.0;
+      is_touched[comm] = false;
+    }
+    touched.clear();
+  }
+};
+
+// Layout of the nodes of an aggregate graph, i.e. the order of the communities
+enum aggregate_order_t
+{
+  AGGREGATE_ORDER_NONE = 0,
+  AGGREGATE_ORDER_SIZE = 1,
+  AGGREGATE_ORDER_TRAVERSAL = 2
+};
+
+// Scratch space of relabel_for_aggregation, which may be kept by the caller
+// across levels.
+struct aggregation_workspace_t
+{
+  vector<size_t> comms;
+  vector<bool> is_reached;
+  vector<size_t> new_comm_id;
+  vector<size_t> order;
+  node_order_scratch_t order_scratch;
+};
+
+int parse_aggregate_order(const char* aggregate_order);
+void relabel_for_aggregation(vector<MutableVertexPartition*> const& partitions, int aggregate_order,
+                             aggregation_workspace_t* workspace = NULL);
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -42,18 +138,23 @@ extern "C"
   PyObject* _new_SignificanceVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_SurpriseVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_CPMVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _new_BipartiteCPMVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_RBERVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _new_RBConfigurationVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _new_SignedRBConfigurationVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _new_SignedModularityVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_diff_move(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_move_node(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_aggregate_partition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_get_py_igraph(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_share_graph(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_from_coarse_partition(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_renumber_communities(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_quality(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_quality_batch(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_total_weight_in_comm(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_total_weight_from_comm(PyObject *self, PyObject *args, PyObject *keywds);
@@ -67,9 +168,12 @@ extern "C"
   PyObject* _MutableVertexPartition_get_membership(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_set_membership(PyObject *self, PyObject *args, PyObject *keywds);
 
+  PyObject* _MutableVertexPartition_memory_usage(PyObject *self, PyObject *args, PyObject *keywds);
+
   PyObject* _ResolutionParameterVertexPartition_get_resolution(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _ResolutionParameterVertexPartition_set_resolution(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _ResolutionParameterVertexPartition_quality(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _BipartiteCPMVertexPartition_get_parameters(PyObject *self, PyObject *args, PyObject *keywds);
 
 #ifdef __cplusplus
 }
@@ -43,6 +43,7 @@ cmake ${ROOT_DIR}/build-deps/src/igraph \
   -DIGRAPH_GLPK_SUPPORT=OFF \
   -DIGRAPH_GRAPHML_SUPPORT=OFF \
   -DIGRAPH_OPENMP_SUPPORT=OFF \
+  -DIGRAPH_ENABLE_TLS=ON \
   -DIGRAPH_USE_INTERNAL_BLAS=ON \
   -DIGRAPH_USE_INTERNAL_LAPACK=ON \
   -DIGRAPH_USE_INTERNAL_ARPACK=ON \
@@ -4,6 +4,7 @@ import os
 import platform
 import sys
 import glob
+import sysconfig
 
 ###########################################################################
 
@@ -33,10 +34,12 @@ if bdist_wheel is not None:
 else:
     bdist_wheel_abi3 = None
 
+# Free-threaded builds of CPython do not support the limited API
 should_build_abi3_wheel = (
     bdist_wheel_abi3 and
     platform.python_implementation() == "CPython" and
-    sys.version_info >= (3, 8)
+    sys.version_info >= (3, 8) and
+    not sysconfig.get_config_var("Py_GIL_DISABLED")
 )
 
 # Define the extension
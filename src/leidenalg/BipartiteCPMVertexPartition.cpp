@@ -0,0 +1,92 @@
+#include "BipartiteCPMVertexPartition.h"
+
+BipartiteCPMVertexPartition::BipartiteCPMVertexPartition(Graph* graph,
+      vector<size_t> const& membership,
+      double resolution_parameter_01, double resolution_parameter_0, double resolution_parameter_1,
+      double type_base) :
+        CPMVertexPartition(graph, membership, resolution_parameter_01),
+        resolution_parameter_0(resolution_parameter_0),
+        resolution_parameter_1(resolution_parameter_1),
+        type_base(type_base)
+{ }
+
+BipartiteCPMVertexPartition::BipartiteCPMVertexPartition(Graph* graph,
+      double resolution_parameter_01, double resolution_parameter_0, double resolution_parameter_1,
+      double type_base) :
+        CPMVertexPartition(graph, resolution_parameter_01),
+        resolution_parameter_0(resolution_parameter_0),
+        resolution_parameter_1(resolution_parameter_1),
+        type_base(type_base)
+{ }
+
+BipartiteCPMVertexPartition::~BipartiteCPMVertexPartition()
+{ }
+
+BipartiteCPMVertexPartition* BipartiteCPMVertexPartition::create(Graph* graph)
+{
+  return new BipartiteCPMVertexPartition(graph,
+    this->resolution_parameter, this->resolution_parameter_0, this->resolution_parameter_1,
+    this->type_base);
+}
+
+BipartiteCPMVertexPartition* BipartiteCPMVertexPartition::create(Graph* graph, vector<size_t> const& membership)
+{
+  return new BipartiteCPMVertexPartition(graph, membership,
+    this->resolution_parameter, this->resolution_parameter_0, this->resolution_parameter_1,
+    this->type_base);
+}
+
+/*****************************************************************************
+  Returns the difference in quality if we move a node to a new community.
+
+  The contribution of the edges is that of CPM without any resolution, to
+  which the difference in penalty of both communities is added.
+******************************************************************************/
+double BipartiteCPMVertexPartition::diff_move(size_t v, size_t new_comm)
+{
+  #ifdef DEBUG
+    cerr << "double BipartiteCPMVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+  #endif
+  size_t old_comm = this->membership(v);
+  if (new_comm == old_comm)
+    return 0.0;
+
+  double diff = diff_move_weight(this, this->graph, v, old_comm, new_comm);
+
+  double nsize = this->graph->node_size(v);
+  double csize_old = this->csize(old_comm);
+  double csize_new = this->csize(new_comm);
+
+  double diff_penalty = this->penalty(csize_new + nsize, this->resolution_parameter)
+                      - this->penalty(csize_new, this->resolution_parameter)
+                      + this->penalty(csize_old - nsize, this->resolution_parameter)
+                      - this->penalty(csize_old, this->resolution_parameter);
+
+  diff -= (2.0 - this->graph->is_directed())*diff_penalty;
+  #ifdef DEBUG
+    cerr << "exit BipartiteCPMVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+    cerr << "return " << diff << endl << endl;
+  #endif
+  return diff;
+}
+
+/*****************************************************************************
+  Give the quality of the partition, identical to the combined quality of the
+  three layers of CPMVertexPartition.Bipartite.
+******************************************************************************/
+double BipartiteCPMVertexPartition::quality(double resolution_parameter)
+{
+  #ifdef DEBUG
+    cerr << "double BipartiteCPMVertexPartition::quality()" << endl;
+  #endif
+  double q = CPMVertexPartition::quality(0.0);
+  double penalty = 0.0;
+  for (size_t c = 0; c < this->n_communities(); c++)
+    penalty += this->penalty(this->csize(c), resolution_parameter);
+  q -= (2.0 - this->graph->is_directed())*penalty;
+  #ifdef DEBUG
+    cerr << "exit double BipartiteCPMVertexPartition::quality()" << endl;
+    cerr << "return " << q << endl << endl;
+  #endif
+  return q;
+}
@@ -0,0 +1,114 @@
+#include "CachedSignificanceVertexPartition.h"
+
+CachedSignificanceVertexPartition::CachedSignificanceVertexPartition(Graph* graph,
+      vector<size_t> const& membership) :
+        SignificanceVertexPartition(graph, membership),
+        _removed_node(graph->vcount()), _removed_size(0), _removed_weight(0.0), _removed_term(0.0)
+{ }
+
+CachedSignificanceVertexPartition::CachedSignificanceVertexPartition(Graph* graph) :
+        SignificanceVertexPartition(graph),
+        _removed_node(graph->vcount()), _removed_size(0), _removed_weight(0.0), _removed_term(0.0)
+{ }
+
+CachedSignificanceVertexPartition::~CachedSignificanceVertexPartition()
+{ }
+
+CachedSignificanceVertexPartition* CachedSignificanceVertexPartition::create(Graph* graph)
+{
+  return new CachedSignificanceVertexPartition(graph);
+}
+
+CachedSignificanceVertexPartition* CachedSignificanceVertexPartition::create(Graph* graph, vector<size_t> const& membership)
+{
+  return new CachedSignificanceVertexPartition(graph, membership);
+}
+
+/****************************************************************************
+  The contribution N_c KL(q_c, p) of a community of size n_c with an internal
+  weight of m_c, where N_c is the number of possible edges in the community.
+*****************************************************************************/
+double CachedSignificanceVertexPartition::significance_term(size_t n_c, double m_c, double p)
+{
+  size_t N_c = this->graph->possible_edges(n_c);
+  if (N_c == 0)
+    return 0.0;
+  return N_c*KL(m_c/N_c, p);
+}
+
+double CachedSignificanceVertexPartition::community_term(size_t comm, double p)
+{
+  if (comm >= this->_comm_term.size())
+  {
+    // A negative weight never matches, so new terms are computed when first
+    // requested.
+    size_t nb_comms = std::max(comm + 1, this->n_communities());
+    this->_comm_term.resize(nb_comms, 0.0);
+    this->_comm_term_size.resize(nb_comms, 0);
+    this->_comm_term_weight.resize(nb_comms, -1.0);
+  }
+
+  size_t n_c = this->csize(comm);
+  double m_c = this->total_weight_in_comm(comm);
+  if (this->_comm_term_size[comm] != n_c || this->_comm_term_weight[comm] != m_c)
+  {
+    this->_comm_term[comm] = this->significance_term(n_c, m_c, p);
+    this->_comm_term_size[comm] = n_c;
+    this->_comm_term_weight[comm] = m_c;
+  }
+  return this->_comm_term[comm];
+}
+
+double CachedSignificanceVertexPartition::diff_move(size_t v, size_t new_comm)
+{
+  size_t old_comm = this->membership(v);
+  if (new_comm == old_comm)
+    return 0.0;
+  return this->diff_move(v, new_comm,
+                         this->weight_to_comm(v, old_comm), this->weight_from_comm(v, old_comm),
+                         this->weight_to_comm(v, new_comm), this->weight_from_comm(v, new_comm));
+}
+
+double CachedSignificanceVertexPartition::diff_move(size_t v, size_t new_comm,
+                                                    double w_to_old, double w_from_old,
+                                                    double w_to_new, double w_from_new)
+{
+  #ifdef DEBUG
+    cerr << "double CachedSignificanceVertexPartition::diff_move(" << v << ", " << new_comm << ", ...)" << endl;
+  #endif
+  size_t old_comm = this->membership(v);
+  if (new_comm == old_comm)
+    return 0.0;
+
+  double normalise = (2.0 - this->graph->is_directed());
+  double p = this->graph->density();
+  size_t nsize = this->graph->node_size(v);
+  double sw = this->graph->node_self_weight(v);
+
+  // Old community after the move, which is the same for all new communities
+  size_t n_oldx = this->csize(old_comm) - nsize;
+  double wtc = w_to_old - sw;
+  double wfc = w_from_old - sw;
+  double m_oldx = this->total_weight_in_comm(old_comm) - wtc/normalise - wfc/normalise - sw;
+  if (this->_removed_node != v || this->_removed_size != n_oldx || this->_removed_weight != m_oldx)
+  {
+    this->_removed_node = v;
+    this->_removed_size = n_oldx;
+    this->_removed_weight = m_oldx;
+    this->_removed_term = this->significance_term(n_oldx, m_oldx, p);
+  }
+
+  // New community after the move
+  size_t n_newx = this->csize(new_comm) + nsize;
+  wtc = w_to_new;
+  wfc = w_from_new;
+  double m_newx = this->total_weight_in_comm(new_comm) + wtc/normalise + wfc/normalise + sw;
+
+  double diff = this->_removed_term + this->significance_term(n_newx, m_newx, p)
+                - this->community_term(old_comm, p) - this->community_term(new_comm, p);
+  #ifdef DEBUG
+    cerr << "exit CachedSignificanceVertexPartition::diff_move(" << v << ", " << new_comm << ", ...)" << endl;
+    cerr << "return " << diff << endl << endl;
+  #endif
+  return diff;
+}
@@ -0,0 +1,88 @@
+#include "CachedSurpriseVertexPartition.h"
+
+CachedSurpriseVertexPartition::CachedSurpriseVertexPartition(Graph* graph,
+      vector<size_t> const& membership) :
+        SurpriseVertexPartition(graph, membership),
+        _has_term(false), _term_weight(0.0), _term_possible_edges(0), _term(0.0)
+{ }
+
+CachedSurpriseVertexPartition::CachedSurpriseVertexPartition(Graph* graph) :
+        SurpriseVertexPartition(graph),
+        _has_term(false), _term_weight(0.0), _term_possible_edges(0), _term(0.0)
+{ }
+
+CachedSurpriseVertexPartition::~CachedSurpriseVertexPartition()
+{ }
+
+CachedSurpriseVertexPartition* CachedSurpriseVertexPartition::create(Graph* graph)
+{
+  return new CachedSurpriseVertexPartition(graph);
+}
+
+CachedSurpriseVertexPartition* CachedSurpriseVertexPartition::create(Graph* graph, vector<size_t> const& membership)
+{
+  return new CachedSurpriseVertexPartition(graph, membership);
+}
+
+double CachedSurpriseVertexPartition::diff_move(size_t v, size_t new_comm)
+{
+  size_t old_comm = this->membership(v);
+  if (new_comm == old_comm)
+    return 0.0;
+  return this->diff_move(v, new_comm,
+                         this->weight_to_comm(v, old_comm), this->weight_from_comm(v, old_comm),
+                         this->weight_to_comm(v, new_comm), this->weight_from_comm(v, new_comm));
+}
+
+double CachedSurpriseVertexPartition::diff_move(size_t v, size_t new_comm,
+                                                double w_to_old, double w_from_old,
+                                                double w_to_new, double w_from_new)
+{
+  #ifdef DEBUG
+    cerr << "double CachedSurpriseVertexPartition::diff_move(" << v << ", " << new_comm << ", ...)" << endl;
+  #endif
+  size_t old_comm = this->membership(v);
+  double m = this->graph->total_weight();
+  if (new_comm == old_comm || m == 0)
+    return 0.0;
+
+  double normalise = (2.0 - this->graph->is_directed());
+  size_t nsize = this->graph->node_size(v);
+  size_t n = this->graph->total_size();
+  size_t n2 = this->graph->possible_edges(n);
+
+  // Before the move
+  double mc = this->total_weight_in_all_comms();
+  size_t nc2 = this->total_possible_edges_in_all_comms();
+  if (!this->_has_term || this->_term_weight != mc || this->_term_possible_edges != nc2)
+  {
+    this->_has_term = true;
+    this->_term_weight = mc;
+    this->_term_possible_edges = nc2;
+    this->_term = m*KLL(mc/m, (double)nc2/(double)n2);
+  }
+
+  // Weight to the old and new community
+  size_t n_old = this->csize(old_comm);
+  double sw = this->graph->node_self_weight(v);
+  double wtc = w_to_old - sw;
+  double wfc = w_from_old - sw;
+  double m_old = wtc/normalise + wfc/normalise + sw;
+
+  size_t n_new = this->csize(new_comm);
+  wtc = w_to_new;
+  wfc = w_from_new;
+  double m_new = wtc/normalise + wfc/normalise + sw;
+
+  // After the move
+  double q_new = (mc - m_old + m_new)/m;
+  double delta_nc2 = 2.0*nsize*(ptrdiff_t)(n_new - n_old + nsize)/normalise;
+  double s_new = (double)(nc2 + delta_nc2)/(double)n2;
+
+  double diff = m*KLL(q_new, s_new) - this->_term;
+  #ifdef DEBUG
+    cerr << "exit CachedSurpriseVertexPartition::diff_move(" << v << ", " << new_comm << ", ...)" << endl;
+    cerr << "return " << diff << endl << endl;
+  #endif
+  return diff;
+}
@@ -2,6 +2,76 @@ from . import _c_leiden
 from .VertexPartition import LinearResolutionParameterVertexPartition
 from collections import namedtuple
 from math import log, sqrt
+from array import array as _array
+import random
+import threading
+from contextlib import contextmanager
+from concurrent.futures import ThreadPoolExecutor
+
+_STATUS = ('complete', 'time_budget', 'cancelled', 'interrupted')
+
+_executor = None
+_executor_lock = threading.Lock()
+
+# Token of the call that a worker thread runs, see optimise_partition_async
+_call = threading.local()
+
+def _get_executor():
+  """ Get the pool of threads that run optimisations in the background.
+
+  The optimisations do not hold the GIL, so that they run in parallel. """
+  global _executor
+  with _executor_lock:
+    if _executor is None:
+      _executor = ThreadPoolExecutor(thread_name_prefix='leidenalg')
+  return _executor
+
+def _as_is_membership_fixed(is_membership_fixed):
+  """ Convert ``is_membership_fixed`` to a list of bools or a packed bitset. """
+  if is_membership_fixed is None or isinstance(is_membership_fixed, (bytes, bytearray)):
+    return is_membership_fixed
+  if isinstance(is_membership_fixed, memoryview):
+    return is_membership_fixed.tobytes()
+  return list(is_membership_fixed)
+
+def _as_fixed_nodes(fixed_nodes):
+  """ Convert ``fixed_nodes`` to a list of node indices. """
+  if fixed_nodes is None:
+    return None
+  return [int(v) for v in fixed_nodes]
+
+def _internal_fixed_nodes(partition, is_membership_fixed, fixed_nodes):
+  """ Map ``is_membership_fixed`` and ``fixed_nodes`` (as converted above) to
+  the internal order of the nodes of a reordered partition, see
+  :func:`~VertexPartition.MutableVertexPartition.Reordered`. """
+  position = partition._node_position
+  if position is None:
+    return is_membership_fixed, fixed_nodes
+  n = len(position)
+  fixed = []
+  if is_membership_fixed is not None:
+    if isinstance(is_membership_fixed, (bytes, bytearray)):
+      if len(is_membership_fixed) != (n + 7)//8:
+        raise ValueError('Membership fixed bitset not the same size as the number of nodes.')
+      fixed = [v for v in range(n) if (is_membership_fixed[v >> 3] >> (v & 7)) & 1]
+    else:
+      if len(is_membership_fixed) != n:
+        raise ValueError('Membership fixed vector not the same size as the number of nodes.')
+      fixed = [v for v, is_fixed in enumerate(is_membership_fixed) if is_fixed]
+  if fixed_nodes is not None:
+    fixed.extend(fixed_nodes)
+  if any(v < 0 or v >= n for v in fixed):
+    raise ValueError('Fixed node cannot exceed number of nodes.')
+  if not fixed:
+    return None, None
+  return None, [position[v] for v in fixed]
+
+def _check_node_order(partitions):
+  """ Partitions that are optimised together need the same node order. """
+  node_order = partitions[0]._node_order
+  for partition in partitions[1:]:
+    if partition._node_order != node_order:
+      raise ValueError('Partitions should have the same node order.')
 
 class Optimiser(object):
   r""" Class for doing community detection using the Leiden algorithm.
@@ -56,6 +126,23 @@ class Optimiser(object):
   Finally, the Optimiser class provides a routine to construct a
   :func:`resolution_profile` on a resolution parameter.
 
+  An optimiser, including its random number generator, runs one optimisation
+  at a time, and a partition is optimised by one optimiser at a time. Other
+  threads wait until the optimisation is done, so that different threads can
+  safely use the same optimiser or partition, also on free-threaded builds of
+  Python. Independent clusterings with different optimisers and partitions
+  run in parallel. Using a partition directly, for example using
+  :func:`~VertexPartition.MutableVertexPartition.move_node` or
+  :func:`~VertexPartition.MutableVertexPartition.quality`, also waits until an
+  optimisation of the partition is done.
+  Partitions that share a graph, see
+  :func:`~VertexPartition.MutableVertexPartition.share_graph`, are optimised
+  one at a time as well, also by different optimisers. Setting a property of
+  the optimiser waits until a running optimisation is done, so that the
+  settings do not change during an optimisation, and raises a
+  :class:`RuntimeError` when done from the :attr:`progress` callback of that
+  optimisation.
+
   References
   ----------
 
@@ -71,6 +158,40 @@ class Optimiser(object):
   def __init__(self):
     """ Create a new Optimiser object """
     self._optimiser = _c_leiden._new_Optimiser()
+    self._aggregate_order = None
+    self._time_budget = None
+    self._progress = None
+    self._progress_interval = 0.1
+    self._lock = threading.Lock()
+    # Thread that holds the lock, so that a call from the progress callback
+    # raises an error rather than waiting for itself
+    self._lock_thread = None
+    # Token of the running call, so that a call is only cancelled while it runs
+    self._running_token = None
+    self._token_lock = threading.Lock()
+
+  def _acquire(self):
+    """ Acquire the lock of the optimiser, waiting for a running optimisation.
+
+    Raises a :class:`RuntimeError` if the calling thread already holds the
+    lock, for example when the settings are changed from the progress
+    callback, which would otherwise wait for itself. """
+    if self._lock_thread == threading.get_ident():
+      raise RuntimeError("The optimiser cannot be used while it runs on this thread, e.g. from its progress callback.")
+    self._lock.acquire()
+    self._lock_thread = threading.get_ident()
+
+  def _release(self):
+    self._lock_thread = None
+    self._lock.release()
+
+  @contextmanager
+  def _locked(self):
+    self._acquire()
+    try:
+      yield
+    finally:
+      self._release()
 
   #########################################################3
   # consider_comms
@@ -94,7 +215,8 @@ class Optimiser(object):
     * :attr:`leidenalg.ALL_COMMS`
       Consider all communities for moving. This is especially useful in the
       case of negative links, in which case it may be better to move a node to
-      a non-neighbouring community.
+      a non-neighbouring community. With :attr:`fused_moves`, see
+      :attr:`all_comms_candidates` to avoid evaluating every community.
 
     * :attr:`leidenalg.RAND_NEIGH_COMM`
       Consider a random neighbour community for moving. The probability to
@@ -104,12 +226,21 @@ class Optimiser(object):
     * :attr:`leidenalg.RAND_COMM`
       Consider a random community for moving. The probability to choose a
       community is proportional to the number of nodes in that community.
+
+    * :attr:`leidenalg.PRUNED_ALL_COMMS`
+      Consider all neighbouring communities for moving until no more nodes
+      move, and only then all communities. This finds the same kind of stable
+      partition as :attr:`leidenalg.ALL_COMMS`, but most iterations then only
+      consider the neighbouring communities, which is much faster when there
+      are many communities. The final pass still considers all communities for
+      every node, typically only once.
     """
     return _c_leiden._Optimiser_get_consider_comms(self._optimiser)
 
   @consider_comms.setter
   def consider_comms(self, value):
-    _c_leiden._Optimiser_set_consider_comms(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_consider_comms(self._optimiser, value)
 
   #########################################################3
   # refine consider_comms
@@ -148,7 +279,8 @@ class Optimiser(object):
 
   @refine_consider_comms.setter
   def refine_consider_comms(self, value):
-    _c_leiden._Optimiser_set_refine_consider_comms(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_refine_consider_comms(self._optimiser, value)
 
   #########################################################3
   # optimise routine
@@ -171,7 +303,8 @@ class Optimiser(object):
 
   @optimise_routine.setter
   def optimise_routine(self, value):
-    _c_leiden._Optimiser_set_optimise_routine(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_optimise_routine(self._optimiser, value)
 
   #########################################################3
   # optimise routine
@@ -194,7 +327,8 @@ class Optimiser(object):
 
   @refine_routine.setter
   def refine_routine(self, value):
-    _c_leiden._Optimiser_set_refine_routine(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_refine_routine(self._optimiser, value)
 
   #########################################################3
   # refine_partition
@@ -205,7 +339,8 @@ class Optimiser(object):
 
   @refine_partition.setter
   def refine_partition(self, value):
-    _c_leiden._Optimiser_set_refine_partition(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_refine_partition(self._optimiser, value)
 
   #########################################################3
   # consider_empty_community
@@ -217,7 +352,8 @@ class Optimiser(object):
 
   @consider_empty_community.setter
   def consider_empty_community(self, value):
-    _c_leiden._Optimiser_set_consider_empty_community(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_consider_empty_community(self._optimiser, value)
 
   #########################################################3
   # max_comm_size
@@ -234,11 +370,12 @@ class Optimiser(object):
 
   @min_comm_size.setter
   def min_comm_size(self, value):
-    if value < 0:
-        raise ValueError("Negative minimum community size: %s" % value)
-    elif value > self.max_comm_size and self.max_comm_size > 0:
-        raise ValueError("Minimum community size should be less than or equal to the maximum community size")
-    _c_leiden._Optimiser_set_min_comm_size(self._optimiser, value)
+    with self._locked():
+      if value < 0:
+          raise ValueError("Negative minimum community size: %s" % value)
+      elif value > self.max_comm_size and self.max_comm_size > 0:
+          raise ValueError("Minimum community size should be less than or equal to the maximum community size")
+      _c_leiden._Optimiser_set_min_comm_size(self._optimiser, value)
 
   #########################################################3
   # max_comm_size
@@ -255,11 +392,12 @@ class Optimiser(object):
 
   @max_comm_size.setter
   def max_comm_size(self, value):
-    if value < 0:
-        raise ValueError("negative max_comm_size: %s" % value)
-    elif value < self.min_comm_size and self.min_comm_size > 0:
-        raise ValueError("Maximum community size should be larger than or equal to the minimum community size")        
-    _c_leiden._Optimiser_set_max_comm_size(self._optimiser, value)
+    with self._locked():
+      if value < 0:
+          raise ValueError("negative max_comm_size: %s" % value)
+      elif value < self.min_comm_size and self.min_comm_size > 0:
+          raise ValueError("Maximum community size should be larger than or equal to the minimum community size")
+      _c_leiden._Optimiser_set_max_comm_size(self._optimiser, value)
 
   #########################################################3
   # community_constraint_enforcement
@@ -275,9 +413,262 @@ class Optimiser(object):
 
   @community_constraint_enforcement.setter
   def community_constraint_enforcement(self, value):
-    if value < 0:
-        raise ValueError("negative community_constraint_enforcement: %s" % value)
-    _c_leiden._Optimiser_set_community_constraint_enforcement(self._optimiser, value)
+    with self._locked():
+      if value < 0:
+          raise ValueError("negative community_constraint_enforcement: %s" % value)
+      _c_leiden._Optimiser_set_community_constraint_enforcement(self._optimiser, value)
+
+  #########################################################3
+  # fused_moves
+  @property
+  def fused_moves(self):
+    """ boolean: if ``True`` move nodes using the local moving routine of
+    this package rather than that of the underlying C++ library, in
+    :func:`optimise_partition` and :func:`optimise_partition_multiplex`.
+
+    This routine fuses the layers of a multiplex optimisation: the weights of
+    a node to the communities of its neighbours are collected in a single
+    pass over its neighbours in all layers, after which a move is evaluated
+    for all layers together. For the quality functions of
+    :class:`ModularityVertexPartition`, :class:`RBConfigurationVertexPartition`,
+    :class:`CPMVertexPartition`, :class:`RBERVertexPartition`,
+    :class:`SignificanceVertexPartition` and :class:`SurpriseVertexPartition`
+    the difference in quality is computed from these weights directly, while
+    other partitions use their own ``diff_move``.
+    It also checks every few thousand nodes whether the optimisation should
+    stop, see :attr:`time_budget` and :func:`cancel`, so that a long first
+    level can be stopped as well. It follows the same procedure as the C++
+    library, but its random choices differ, so that the resulting partitions
+    differ for the same seed. It is not used if :attr:`min_comm_size` or
+    :attr:`community_constraint_enforcement` is set.
+
+    The default is ``False``.
+    """
+    return _c_leiden._Optimiser_get_fused_moves(self._optimiser)
+
+  @fused_moves.setter
+  def fused_moves(self, value):
+    with self._locked():
+      _c_leiden._Optimiser_set_fused_moves(self._optimiser, value)
+
+  #########################################################3
+  # all_comms_candidates
+  @property
+  def all_comms_candidates(self):
+    """ Candidate communities of :attr:`leidenalg.ALL_COMMS` with
+    :attr:`fused_moves`.
+
+    By default (``None``), every community is considered for every node, at a
+    cost proportional to the number of communities. With ``'exact'``, only
+    the communities of the neighbours of a node are considered, together with
+    the best of the other communities, which is looked up in an index of the
+    communities ordered by size for :class:`CPMVertexPartition` and
+    :class:`RBERVertexPartition`, and by total weight for
+    :class:`ModularityVertexPartition` and
+    :class:`RBConfigurationVertexPartition` on undirected graphs. For these
+    quality functions the difference in quality of moving a node to a
+    community without any of its neighbours only depends on that size or
+    weight, so that this finds the same improvement, while the index costs
+    :math:`O(\\log k)` per move for :math:`k` communities rather than
+    :math:`O(k)` per node. For other quality functions, directed graphs with
+    a configuration model, or several layers, every community is then still
+    considered.
+
+    With a positive integer ``k``, the first ``k`` communities of the index
+    without any neighbours of the node are considered. This remains exact for
+    the quality functions above, and is an approximation for the others, for
+    which the communities are ordered by size, smallest first, which bounds
+    the cost of a node.
+
+    This also applies to the final pass of
+    :attr:`leidenalg.PRUNED_ALL_COMMS`, but not to the refinement, nor to the
+    routines of the C++ library, such as :func:`move_nodes`.
+    """
+    candidate_index, candidate_limit = _c_leiden._Optimiser_get_all_comms_candidates(self._optimiser)
+    if not candidate_index:
+      return None
+    return candidate_limit if candidate_limit > 0 else 'exact'
+
+  @all_comms_candidates.setter
+  def all_comms_candidates(self, value):
+    with self._locked():
+      if value is None:
+        _c_leiden._Optimiser_set_all_comms_candidates(self._optimiser, False, 0)
+      elif value == 'exact':
+        _c_leiden._Optimiser_set_all_comms_candidates(self._optimiser, True, 0)
+      elif isinstance(value, int) and not isinstance(value, bool) and value > 0:
+        _c_leiden._Optimiser_set_all_comms_candidates(self._optimiser, True, value)
+      else:
+        raise ValueError("All communities candidates should be None, 'exact' or a positive integer.")
+
+  #########################################################3
+  # aggregate_order
+  @property
+  def aggregate_order(self):
+    """ Layout of the nodes of the aggregate graphs in
+    :func:`optimise_partition` and :func:`optimise_partition_multiplex`.
+
+    The nodes of an aggregate graph are the communities of the previous level,
+    which by default keep their labels. Deeper levels then inherit the memory
+    layout of the original graph. Alternatively, the communities can be laid
+    out by decreasing size (``'size'``), or in the order in which a
+    breadth-first search reaches them (``'traversal'``), so that adjacent
+    aggregate nodes tend to be close in memory. This does not change the
+    quality of the resulting partition, although the random choices during
+    the optimisation may differ.
+
+    The default is ``None``, keeping the labels.
+    """
+    return self._aggregate_order
+
+  @aggregate_order.setter
+  def aggregate_order(self, value):
+    with self._locked():
+      if value not in (None, 'size', 'traversal'):
+        raise ValueError("Aggregate order should be None, 'size' or 'traversal'.")
+      self._aggregate_order = value
+
+  #########################################################3
+  # time_budget
+  @property
+  def time_budget(self):
+    """ Time in seconds that :func:`optimise_partition` and
+    :func:`optimise_partition_multiplex` may take.
+
+    The time budget is only checked between levels of aggregation and after
+    moving the nodes of a level: the optimisation is stopped at the first
+    such point after the time budget is spent. The partition then holds the
+    best partition found so far, and :attr:`status` is ``'time_budget'``.
+    Moving the nodes of a level is not interrupted, so the time budget may be
+    exceeded by the time taken by one level, which for the first level of a
+    large graph may be most of the optimisation. With :attr:`fused_moves`, the
+    time budget is also checked every few thousand nodes within a level.
+
+    The default is ``None``, without any time budget.
+    """
+    return self._time_budget
+
+  @time_budget.setter
+  def time_budget(self, value):
+    with self._locked():
+      if value is not None and value < 0:
+        raise ValueError("Time budget should be None or non-negative.")
+      self._time_budget = value
+
+  def cancel(self):
+    """ Request to stop the running optimisation.
+
+    The request is only checked at the same points as :attr:`time_budget`,
+    and :attr:`status` is then ``'cancelled'``. If the optimisation does not
+    use any of :attr:`time_budget`, :attr:`progress`, :attr:`aggregate_order`,
+    :attr:`fused_moves`, :attr:`leidenalg.PRUNED_ALL_COMMS` or
+    ``return_levels``, it runs the optimisation of the C++ library unchanged,
+    and the request only stops it after the current iteration. This may be called from another thread, or
+    from a signal handler. A request made while no optimisation is running is
+    discarded when the next one starts.
+    """
+    _c_leiden._Optimiser_cancel(self._optimiser)
+
+  #########################################################3
+  # progress
+  @property
+  def progress(self):
+    """ Callback that reports the progress of :func:`optimise_partition` and
+    :func:`optimise_partition_multiplex`.
+
+    The callback is called at the end of a level of aggregation, at most once
+    every :attr:`progress_interval` seconds, with a dict with the following
+    items, counted over all iterations of the call:
+
+    * ``iteration``: the iteration of the Leiden algorithm, starting from 0.
+    * ``level``: the level of aggregation in the iteration, where 0 is the
+      original graph.
+    * ``level_nodes``: the number of nodes at this level.
+    * ``nodes_processed``: the number of nodes of all levels so far.
+    * ``moves``: the number of nodes of all levels so far that changed
+      community. The communities before and after each level are matched by
+      the nodes they share, so that renumbering the communities does not count
+      as moving, while merging two communities counts the nodes of the smaller
+      one.
+    * ``improvement``: the improvement in quality so far.
+
+    The optimisation can be stopped from the callback by calling
+    :func:`cancel`, or by raising an exception, which is then raised by the
+    optimisation. Alternatively, a capsule named
+    ``"leidenalg.progress_callback"`` may be passed, holding a C function
+    ``int callback(const optimise_progress_t* progress, void* data)`` that is
+    called with the context of the capsule as ``data``, and which cancels the
+    optimisation by returning a non-zero value. This avoids any Python
+    overhead. The callback is called while the optimiser runs, so changing the
+    settings of the optimiser or starting another optimisation with it from
+    the callback raises a :class:`RuntimeError`. The callback may query the
+    partition, but should not modify it.
+
+    The default is ``None``, without reporting progress.
+    """
+    return self._progress
+
+  @progress.setter
+  def progress(self, value):
+    with self._locked():
+      if value is not None and not callable(value) and type(value).__name__ != 'PyCapsule':
+        raise TypeError("Progress should be None, callable or a capsule.")
+      self._progress = value
+
+  @property
+  def progress_interval(self):
+    """ Minimum time in seconds between two calls to :attr:`progress`.
+
+    The default is 0.1 seconds.
+    """
+    return self._progress_interval
+
+  @progress_interval.setter
+  def progress_interval(self, value):
+    with self._locked():
+      if value < 0:
+        raise ValueError("Progress interval should be non-negative.")
+      self._progress_interval = value
+
+  @property
+  def status(self):
+    """ Outcome of the last call to :func:`optimise_partition` or
+    :func:`optimise_partition_multiplex`.
+
+    This is ``'complete'`` if all iterations were run, ``'time_budget'`` if
+    the :attr:`time_budget` was spent, ``'cancelled'`` if :func:`cancel` was
+    called, and ``'interrupted'`` if a signal such as a keyboard interrupt
+    stopped the optimisation. In the latter case, the exception of the signal
+    is raised once the partition has been left in a consistent state.
+
+    Signals are checked at the same points as a request to :func:`cancel`:
+    every few thousand nodes with :attr:`fused_moves`, and otherwise only once
+    a call of the C++ library returns, i.e. after moving the nodes of a level
+    or, when the optimisation of the C++ library is run unchanged, after an
+    iteration. A keyboard interrupt may therefore take as long as one level,
+    or one iteration, to stop the optimisation.
+    """
+    return _STATUS[_c_leiden._Optimiser_get_status(self._optimiser)]
+
+  #########################################################3
+  # peak_memory_usage
+  @property
+  def peak_memory_usage(self):
+    """ Estimated peak number of bytes used when optimising partitions.
+
+    This is measured during :func:`optimise_partition` and
+    :func:`optimise_partition_multiplex`, at each level of aggregation, as
+    the memory held at the same time by the partitions and their graphs, and
+    by the aggregate graphs and partitions of the current and the next level.
+    If the optimisation is left to the C++ library (see :func:`cancel`), the
+    levels are not visible, and it is estimated from the partitions and their
+    first aggregate graph.
+    It is the largest such value over all calls on this optimiser. Like
+    :func:`~VertexPartition.MutableVertexPartition.memory_usage`, this is an
+    estimate based on the sizes of the main arrays, and ignores any overhead
+    of the memory allocator and of the Python objects.
+    """
+    return _c_leiden._Optimiser_get_peak_memory_usage(self._optimiser)
 
   ##########################################################
   # Set rng seed
@@ -289,9 +680,10 @@ class Optimiser(object):
     value
       The integer seed used in the random number generator
     """
-    _c_leiden._Optimiser_set_rng_seed(self._optimiser, value)
+    with self._locked():
+      _c_leiden._Optimiser_set_rng_seed(self._optimiser, value)
 
-  def optimise_partition(self, partition, n_iterations=2, is_membership_fixed=None):
+  def optimise_partition(self, partition, n_iterations=2, is_membership_fixed=None, fixed_nodes=None, return_levels=False):
     """ Optimise the given partition.
 
     Parameters
@@ -304,16 +696,33 @@ class Optimiser(object):
       are run. If the number of iterations is negative, the Leiden algorithm is
       run until an iteration in which there was no improvement.
 
-    is_membership_fixed: list of bools or None
+    is_membership_fixed: list of bools, bytes or None
       Boolean list of nodes that are not allowed to change community. The
-      length of this list must be equal to the number of nodes. By default
+      length of this list must be equal to the number of nodes. Alternatively,
+      a packed bitset of ``ceil(n/8)`` bytes can be passed, where node ``v``
+      corresponds to bit ``v % 8`` of byte ``v // 8``, as produced by
+      ``numpy.packbits(mask, bitorder='little').tobytes()``. By default
       (None) all nodes can change community during the optimization.
+    fixed_nodes: list of ints or None
+      Indices of nodes that are not allowed to change community, in addition
+      to those indicated by ``is_membership_fixed``. This is more efficient
+      than ``is_membership_fixed`` if only few nodes are fixed.
+    return_levels: bool
+      If ``True``, also return the aggregation levels of the last iteration.
 
     Returns
     -------
     float
       Improvement in quality function.
 
+    list of :class:`array.array`
+      Only if ``return_levels`` is ``True``. Level ``l`` is an integer array
+      (typecode ``'q'``) that maps each node of the graph at level ``l`` to
+      its aggregate node at level ``l + 1``, where level 0 is the original
+      graph. The last level maps the top aggregate nodes to their community in
+      ``partition``, so that composing all levels gives the membership. This
+      is the full dendrogram found by the algorithm.
+
     Examples
     --------
 
@@ -328,33 +737,160 @@ class Optimiser(object):
     >>> is_membership_fixed[4] = True
     >>> is_membership_fixed[6] = True
     >>> diff = optimiser.optimise_partition(partition, is_membership_fixed=is_membership_fixed)
+
+    or equivalently, by only listing the fixed nodes:
+
+    >>> diff = optimiser.optimise_partition(partition, fixed_nodes=[4, 6])
+
+    The membership of the original nodes at each level of the dendrogram is
+    obtained by composing the levels:
+
+    >>> diff, levels = optimiser.optimise_partition(partition, return_levels=True)
+    >>> node = list(range(G.vcount()))
+    >>> for level in levels:
+    ...   node = [level[v] for v in node]
+    >>> node == partition.membership
+    True
     """
 
     itr = 0
     diff = 0
+    levels = None
     continue_iteration = itr < n_iterations or n_iterations < 0
 
-    if is_membership_fixed is not None:
-      # Make sure it is a list
-      is_membership_fixed = list(is_membership_fixed)
-
-    while continue_iteration:
-      diff_inc = _c_leiden._Optimiser_optimise_partition(
-              self._optimiser,
-              partition._partition,
-              is_membership_fixed=is_membership_fixed,
-              )
-      diff += diff_inc
-      itr += 1
-      if n_iterations < 0:
-        continue_iteration = (diff_inc > 0)
-      else:
-        continue_iteration = itr < n_iterations
+    is_membership_fixed, fixed_nodes = _internal_fixed_nodes(partition,
+        _as_is_membership_fixed(is_membership_fixed),
+        _as_fixed_nodes(fixed_nodes))
 
-    partition._update_internal_membership()
+    # The optimiser keeps its state of a run, so it runs one at a time.
+    self._acquire()
+    try:
+      _c_leiden._Optimiser_start(self._optimiser, self._time_budget)
+      with self._token_lock:
+        self._running_token = getattr(_call, 'token', None)
+      while continue_iteration:
+        diff_inc = _c_leiden._Optimiser_optimise_partition(
+                self._optimiser,
+                partition._partition,
+                is_membership_fixed=is_membership_fixed,
+                fixed_nodes=fixed_nodes,
+                return_levels=return_levels,
+                aggregate_order=self._aggregate_order,
+                progress=self._progress,
+                progress_interval=self._progress_interval,
+                )
+        if return_levels:
+          diff_inc, levels = diff_inc
+        diff += diff_inc
+        itr += 1
+        if n_iterations < 0:
+          continue_iteration = (diff_inc > 0)
+        else:
+          continue_iteration = itr < n_iterations
+        continue_iteration = continue_iteration and self.status == 'complete'
+    finally:
+      with self._token_lock:
+        self._running_token = None
+      partition._update_internal_membership()
+      self._release()
+    if return_levels:
+      if levels is None:
+        # No iterations were run, so each node is its own aggregate. As the
+        # levels of the C++ side, these are in the internal node order.
+        levels = [range(partition.graph.vcount()),
+                  _c_leiden._MutableVertexPartition_get_membership(partition._partition)]
+      levels = [_array('q', level) for level in levels]
+      if partition._node_position is not None:
+        levels[0] = _array('q', [levels[0][i] for i in partition._node_position])
+      return diff, levels
     return diff
 
-  def optimise_partition_multiplex(self, partitions, layer_weights=None, n_iterations=2, is_membership_fixed=None):
+  def optimise_partition_future(self, partition, **kwargs):
+    """ Optimise the given partition in the background.
+
+    This runs :func:`optimise_partition` with the given arguments on a pool of
+    threads. The optimisation does not hold the GIL, so that other threads,
+    including other optimisations, can run in the meantime. The partition
+    should not be used until the optimisation is done.
+
+    Parameters
+    ----------
+    partition
+      The :class:`~VertexPartition.MutableVertexPartition` to optimise.
+
+    **kwargs
+      Remaining keyword arguments, passed on to :func:`optimise_partition`.
+
+    Returns
+    -------
+    concurrent.futures.Future
+      Future of the result of :func:`optimise_partition`. Cancelling the
+      future only prevents an optimisation that did not start yet, use
+      :func:`cancel` to stop a running optimisation.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> future = optimiser.optimise_partition_future(partition)
+    >>> diff = future.result()
+    """
+    return _get_executor().submit(self.optimise_partition, partition, **kwargs)
+
+  def optimise_partition_async(self, partition, **kwargs):
+    """ Optimise the given partition without blocking the event loop.
+
+    This is :func:`optimise_partition_future` as an :mod:`asyncio` future,
+    which should be awaited from a coroutine. Cancelling the future also
+    stops the optimisation of this call if it is running, as :func:`cancel`
+    does, but not another optimisation by the same optimiser.
+
+    Parameters
+    ----------
+    partition
+      The :class:`~VertexPartition.MutableVertexPartition` to optimise.
+
+    **kwargs
+      Remaining keyword arguments, passed on to :func:`optimise_partition`.
+
+    Returns
+    -------
+    asyncio.Future
+      Future of the result of :func:`optimise_partition`.
+
+    Examples
+    --------
+    >>> async def detect(G):
+    ...   partition = la.ModularityVertexPartition(G)
+    ...   await la.Optimiser().optimise_partition_async(partition)
+    ...   return partition
+    >>> partition = asyncio.run(detect(ig.Graph.Famous('Zachary'))) # doctest: +SKIP
+    """
+    import asyncio
+    token = object()
+
+    def run():
+      _call.token = token
+      try:
+        return self.optimise_partition(partition, **kwargs)
+      finally:
+        _call.token = None
+
+    future = _get_executor().submit(run)
+    async_future = asyncio.wrap_future(future)
+
+    def cancel_running(async_future):
+      # The future itself is only cancelled if it did not start yet. Otherwise
+      # only cancel the optimiser while it runs this call.
+      if async_future.cancelled() and not future.cancelled():
+        with self._token_lock:
+          if self._running_token is token:
+            self.cancel()
+    async_future.add_done_callback(cancel_running)
+    return async_future
+
+  def optimise_partition_multiplex(self, partitions, layer_weights=None, n_iterations=2, is_membership_fixed=None, fixed_nodes=None, layer_nodes=None):
     r""" Optimise the given partitions simultaneously.
 
     Parameters
@@ -365,16 +901,29 @@ class Optimiser(object):
     layer_weights
       List of weights of layers.
 
-    is_membership_fixed: list of bools or None
+    is_membership_fixed: list of bools, bytes or None
       Boolean list of nodes that are not allowed to change community. The
-      length of this list must be equal to the number of nodes. By default
+      length of this list must be equal to the number of nodes. Alternatively,
+      a packed bitset of ``ceil(n/8)`` bytes can be passed, where node ``v``
+      corresponds to bit ``v % 8`` of byte ``v // 8``, as produced by
+      ``numpy.packbits(mask, bitorder='little').tobytes()``. By default
       (None) all nodes can change community during the optimization.
+    fixed_nodes: list of ints or None
+      Indices of nodes that are not allowed to change community, in addition
+      to those indicated by ``is_membership_fixed``. This is more efficient
+      than ``is_membership_fixed`` if only few nodes are fixed.
 
     n_iterations : int
       Number of iterations to run the Leiden algorithm. By default, 2 iterations
       are run. If the number of iterations is negative, the Leiden algorithm is
       run until an iteration in which there was no improvement.
 
+    layer_nodes: list of lists of ints or None
+      For each layer, the node of the multiplex of each node of its graph, or
+      None for a layer whose graph contains all nodes. The graph of a layer
+      then only needs to contain the nodes that are active in it, see `Notes
+      <#notes-multiplex>`_. By default (None), all graphs contain all nodes.
+
     Returns
     -------
     float
@@ -415,6 +964,27 @@ class Optimiser(object):
     conversion required from (time) slices to layers suitable for use in this
     function.
 
+    By default, the layers are handled by the C++ library, which visits the
+    neighbours of a node in each layer again for every candidate community.
+    Setting :attr:`fused_moves` instead collects the candidates of all layers
+    in a single pass.
+
+    If the layers contain different nodes, as the time slices of
+    :func:`find_partition_temporal` do, the graph of each layer only needs to
+    contain its active nodes, and ``layer_nodes`` maps these to the nodes of
+    the multiplex. The improvement of moving a node then only sums over the
+    layers that contain it, and the memory of each layer, also when
+    aggregated, is proportional to its own nodes and edges, rather than to
+    all nodes. The number of nodes of the multiplex is that of the layers that
+    contain all nodes, or one more than the largest node of any layer. The
+    communities start out as those of the first layer that contains all
+    nodes, or as singletons if there is none, and the partitions of all layers
+    are set to the communities found. These layers are handled by the binding,
+    which only considers neighbouring communities
+    (:attr:`leidenalg.ALL_NEIGH_COMMS`), and which supports neither fixed
+    nodes, nor :attr:`min_comm_size`, nor a reordered partition. The sizes of
+    communities for :attr:`max_comm_size` then count nodes of the multiplex.
+
     See Also
     --------
     :func:`slices_to_layers`
@@ -440,27 +1010,103 @@ class Optimiser(object):
     if not layer_weights:
       layer_weights = [1]*len(partitions)
 
+    if layer_nodes is not None:
+      if is_membership_fixed is not None or fixed_nodes is not None:
+        raise ValueError('Layers with different nodes do not support fixed nodes.')
+      return self._optimise_partition_lean_multiplex(partitions, layer_weights, n_iterations, layer_nodes)
+
+    _check_node_order(partitions)
+    is_membership_fixed, fixed_nodes = _internal_fixed_nodes(partitions[0],
+        _as_is_membership_fixed(is_membership_fixed),
+        _as_fixed_nodes(fixed_nodes))
+
     itr = 0
     diff = 0
     continue_iteration = itr < n_iterations or n_iterations < 0
-    while continue_iteration:
-      diff_inc = _c_leiden._Optimiser_optimise_partition_multiplex(
-        self._optimiser,
-        [partition._partition for partition in partitions],
-        layer_weights,
-        is_membership_fixed)
-      diff += diff_inc
-      itr += 1
-      if n_iterations < 0:
-        continue_iteration = (diff_inc > 0)
-      else:
-        continue_iteration = itr < n_iterations
+    # The optimiser keeps its state of a run, so it runs one at a time.
+    self._acquire()
+    try:
+      _c_leiden._Optimiser_start(self._optimiser, self._time_budget)
+      while continue_iteration:
+        diff_inc = _c_leiden._Optimiser_optimise_partition_multiplex(
+          self._optimiser,
+          [partition._partition for partition in partitions],
+          layer_weights,
+          is_membership_fixed,
+          fixed_nodes,
+          self._aggregate_order,
+          progress=self._progress,
+          progress_interval=self._progress_interval)
+        diff += diff_inc
+        itr += 1
+        if n_iterations < 0:
+          continue_iteration = (diff_inc > 0)
+        else:
+          continue_iteration = itr < n_iterations
+        continue_iteration = continue_iteration and self.status == 'complete'
+    finally:
+      # All layers share the same membership after optimisation, so it only
+      # needs to be retrieved from the first layer.
+      partitions[0]._update_internal_membership()
+      for partition in partitions[1:]:
+        partition._copy_internal_membership(partitions[0])
+      self._release()
+    return diff
 
-    for partition in partitions:
-      partition._update_internal_membership()
+  def _optimise_partition_lean_multiplex(self, partitions, layer_weights, n_iterations, layer_nodes):
+    """ Optimise partitions of layers with different nodes, see ``layer_nodes``
+    in :func:`optimise_partition_multiplex`. """
+    layer_nodes = list(layer_nodes)
+    if len(layer_nodes) != len(partitions):
+      raise ValueError('Number of layer nodes does not equal the number of partitions.')
+    if any(partition._node_order is not None for partition in partitions):
+      raise ValueError('Layers with different nodes cannot be reordered.')
+    layer_nodes = [None if nodes is None else _array('q', nodes) for nodes in layer_nodes]
+
+    n = 0
+    membership = None
+    for partition, nodes in zip(partitions, layer_nodes):
+      if nodes is None:
+        n = max(n, partition.graph.vcount())
+        if membership is None:
+          membership = partition.membership
+      elif len(nodes) > 0:
+        n = max(n, max(nodes) + 1)
+    if membership is None or len(membership) != n:
+      membership = range(n)
+    membership = _array('q', membership).tobytes()
+    layer_nodes = [None if nodes is None else nodes.tobytes() for nodes in layer_nodes]
+
+    itr = 0
+    diff = 0
+    continue_iteration = itr < n_iterations or n_iterations < 0
+    self._acquire()
+    try:
+      _c_leiden._Optimiser_start(self._optimiser, self._time_budget)
+      while continue_iteration:
+        diff_inc, membership = _c_leiden._Optimiser_optimise_partition_lean_multiplex(
+          self._optimiser,
+          [partition._partition for partition in partitions],
+          layer_nodes,
+          layer_weights,
+          membership,
+          progress=self._progress,
+          progress_interval=self._progress_interval)
+        diff += diff_inc
+        itr += 1
+        if n_iterations < 0:
+          continue_iteration = (diff_inc > 0)
+        else:
+          continue_iteration = itr < n_iterations
+        continue_iteration = continue_iteration and self.status == 'complete'
+    finally:
+      # Each layer has its own membership, of its own nodes.
+      for partition in partitions:
+        partition._update_internal_membership()
+      self._release()
     return diff
 
-  def move_nodes(self, partition, is_membership_fixed=None, consider_comms=None):
+  def move_nodes(self, partition, is_membership_fixed=None, consider_comms=None, fixed_nodes=None):
     """ Move nodes to alternative communities for *optimising* the partition.
 
     Parameters
@@ -468,10 +1114,17 @@ class Optimiser(object):
     partition
       The partition for which to move nodes.
 
-    is_membership_fixed: list of bools or None
+    is_membership_fixed: list of bools, bytes or None
       Boolean list of nodes that are not allowed to change community. The
-      length of this list must be equal to the number of nodes. By default
+      length of this list must be equal to the number of nodes. Alternatively,
+      a packed bitset of ``ceil(n/8)`` bytes can be passed, where node ``v``
+      corresponds to bit ``v % 8`` of byte ``v // 8``, as produced by
+      ``numpy.packbits(mask, bitorder='little').tobytes()``. By default
       (None) all nodes can change community during the optimization.
+    fixed_nodes: list of ints or None
+      Indices of nodes that are not allowed to change community, in addition
+      to those indicated by ``is_membership_fixed``. This is more efficient
+      than ``is_membership_fixed`` if only few nodes are fixed.
 
     consider_comms
       If ``None`` uses :attr:`consider_comms`, but can be set to
@@ -505,8 +1158,13 @@ class Optimiser(object):
     """
     if (consider_comms is None):
       consider_comms = self.consider_comms
-    diff = _c_leiden._Optimiser_move_nodes(
-            self._optimiser, partition._partition, is_membership_fixed, consider_comms)
+    is_membership_fixed, fixed_nodes = _internal_fixed_nodes(partition,
+        _as_is_membership_fixed(is_membership_fixed),
+        _as_fixed_nodes(fixed_nodes))
+    with self._locked():
+      diff = _c_leiden._Optimiser_move_nodes(
+              self._optimiser, partition._partition,
+              is_membership_fixed, consider_comms, fixed_nodes)
     partition._update_internal_membership()
     return diff
 
@@ -555,11 +1213,13 @@ class Optimiser(object):
     """
     if (consider_comms is None):
       consider_comms = self.refine_consider_comms
-    diff =  _c_leiden._Optimiser_move_nodes_constrained(self._optimiser, partition._partition, constrained_partition._partition, consider_comms)
+    _check_node_order([partition, constrained_partition])
+    with self._locked():
+      diff =  _c_leiden._Optimiser_move_nodes_constrained(self._optimiser, partition._partition, constrained_partition._partition, consider_comms)
     partition._update_internal_membership()
     return diff
 
-  def merge_nodes(self, partition, is_membership_fixed=None, consider_comms=None):
+  def merge_nodes(self, partition, is_membership_fixed=None, consider_comms=None, fixed_nodes=None):
     """ Merge nodes for *optimising* the partition.
 
     Parameters
@@ -567,10 +1227,17 @@ class Optimiser(object):
     partition
       The partition for which to merge nodes.
 
-    is_membership_fixed: list of bools or None
+    is_membership_fixed: list of bools, bytes or None
       Boolean list of nodes that are not allowed to change community. The
-      length of this list must be equal to the number of nodes. By default
+      length of this list must be equal to the number of nodes. Alternatively,
+      a packed bitset of ``ceil(n/8)`` bytes can be passed, where node ``v``
+      corresponds to bit ``v % 8`` of byte ``v // 8``, as produced by
+      ``numpy.packbits(mask, bitorder='little').tobytes()``. By default
       (None) all nodes can change community during the optimization.
+    fixed_nodes: list of ints or None
+      Indices of nodes that are not allowed to change community, in addition
+      to those indicated by ``is_membership_fixed``. This is more efficient
+      than ``is_membership_fixed`` if only few nodes are fixed.
 
     consider_comms
       If ``None`` uses :attr:`consider_comms`, but can be set to
@@ -604,8 +1271,13 @@ class Optimiser(object):
     if (consider_comms is None):
       consider_comms = self.consider_comms
 
-    diff = _c_leiden._Optimiser_merge_nodes(
-            self._optimiser, partition._partition, is_membership_fixed, consider_comms)
+    is_membership_fixed, fixed_nodes = _internal_fixed_nodes(partition,
+        _as_is_membership_fixed(is_membership_fixed),
+        _as_fixed_nodes(fixed_nodes))
+    with self._locked():
+      diff = _c_leiden._Optimiser_merge_nodes(
+              self._optimiser, partition._partition,
+              is_membership_fixed, consider_comms, fixed_nodes)
     partition._update_internal_membership()
     return diff
 
@@ -654,10 +1326,80 @@ class Optimiser(object):
     """
     if (consider_comms is None):
       consider_comms = self.refine_consider_comms
-    diff =  _c_leiden._Optimiser_merge_nodes_constrained(self._optimiser, partition._partition, constrained_partition._partition, consider_comms)
+    _check_node_order([partition, constrained_partition])
+    with self._locked():
+      diff =  _c_leiden._Optimiser_merge_nodes_constrained(self._optimiser, partition._partition, constrained_partition._partition, consider_comms)
     partition._update_internal_membership()
     return diff
 
+  def consensus_partition(self, partition, n_runs=10, n_iterations=2, seed=None, threshold=0, n_threads=1):
+    """ Optimise a consensus partition of multiple optimisation runs.
+
+    Parameters
+    ----------
+    partition
+      The :class:`~VertexPartition.MutableVertexPartition` to optimise. Its
+      membership is replaced by the consensus partition.
+
+    n_runs : int
+      Number of optimisation runs used to build the consensus.
+
+    n_iterations : int
+      Number of iterations to run the Leiden algorithm in each run and for the
+      consensus partition, see :func:`optimise_partition`.
+
+    seed : int or None
+      Seed of the first run. Run ``k`` uses seed ``seed + k``, and the
+      consensus partition is optimised using seed ``seed + n_runs``, so that
+      results are reproducible regardless of ``n_threads``. The random number
+      generator of this optimiser is not used. If ``None``, a random seed is
+      used.
+
+    threshold : float
+      Agreement below this threshold is set to zero before optimising the
+      consensus partition.
+
+    n_threads : int
+      Number of threads to use for the runs. If ``0``, the number of
+      available processors is used.
+
+    Returns
+    -------
+    :class:`array.array` of float
+      Agreement per edge, i.e. the fraction of runs in which both endpoints of
+      the edge were assigned to the same community.
+
+    Notes
+    -----
+    Each run starts from a singleton partition of the same type and with the
+    same parameters as ``partition``, and uses the settings of this optimiser,
+    including :attr:`leidenalg.PRUNED_ALL_COMMS` and :attr:`fused_moves`. The
+    runs do not use :attr:`time_budget`, a progress callback or
+    :attr:`aggregate_order`.
+    Instead of a dense co-assignment matrix, the agreement is only recorded
+    for the existing edges of the graph. The consensus partition is then
+    obtained by optimising a partition of the same type on the graph with the
+    agreement as edge weights. Quality functions that ignore edge weights, such
+    as :class:`~VertexPartition.SignificanceVertexPartition`, are therefore not
+    suitable for building a consensus.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> agreement = optimiser.consensus_partition(partition, n_runs=10, seed=42)
+    """
+    if seed is None:
+      seed = random.getrandbits(31)
+    with self._locked():
+      agreement = _c_leiden._Optimiser_consensus_partition(
+              self._optimiser, partition._partition,
+              n_runs=n_runs, n_iterations=n_iterations, seed=seed,
+              threshold=threshold, n_threads=n_threads)
+    partition._update_internal_membership()
+    return _array('d', agreement)
+
   def resolution_profile(self,
         graph,
         partition_type,
@@ -0,0 +1,64 @@
+#include "SignedModularityVertexPartition.h"
+
+SignedModularityVertexPartition::SignedModularityVertexPartition(Graph* graph,
+      vector<size_t> const& membership) :
+        SignedRBConfigurationVertexPartition(graph, membership, 1.0)
+{ }
+
+SignedModularityVertexPartition::SignedModularityVertexPartition(Graph* graph) :
+        SignedRBConfigurationVertexPartition(graph, 1.0)
+{ }
+
+SignedModularityVertexPartition::~SignedModularityVertexPartition()
+{ }
+
+SignedModularityVertexPartition* SignedModularityVertexPartition::create(Graph* graph)
+{
+  return new SignedModularityVertexPartition(graph);
+}
+
+SignedModularityVertexPartition* SignedModularityVertexPartition::create(Graph* graph, vector<size_t> const& membership)
+{
+  return new SignedModularityVertexPartition(graph, membership);
+}
+
+/****************************************************************************
+  Modularity is normalised by the total positive and negative strength, i.e.
+  2m^+ + 2m^-.
+*****************************************************************************/
+double SignedModularityVertexPartition::normalisation()
+{
+  return this->total_positive_strength() + this->total_negative_strength();
+}
+
+double SignedModularityVertexPartition::diff_move(size_t v, size_t new_comm)
+{
+  #ifdef DEBUG
+    cerr << "double SignedModularityVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+  #endif
+  double norm = this->normalisation();
+  if (norm == 0.0)
+    return 0.0;
+  double diff = this->diff_move_signed(v, new_comm, 1.0)/norm;
+  #ifdef DEBUG
+    cerr << "exit SignedModularityVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+    cerr << "return " << diff << endl << endl;
+  #endif
+  return diff;
+}
+
+double SignedModularityVertexPartition::quality(double resolution_parameter)
+{
+  #ifdef DEBUG
+    cerr << "double SignedModularityVertexPartition::quality()" << endl;
+  #endif
+  double norm = this->normalisation();
+  if (norm == 0.0)
+    return 0.0;
+  double q = this->quality_signed(1.0)/norm;
+  #ifdef DEBUG
+    cerr << "exit double SignedModularityVertexPartition::quality()" << endl;
+    cerr << "return " << q << endl << endl;
+  #endif
+  return q;
+}
@@ -0,0 +1,113 @@
+#include "SignedRBConfigurationVertexPartition.h"
+
+SignedRBConfigurationVertexPartition::SignedRBConfigurationVertexPartition(Graph* graph,
+      vector<size_t> const& membership, double resolution_parameter) :
+        CPMVertexPartition(graph, membership, resolution_parameter)
+{ }
+
+SignedRBConfigurationVertexPartition::SignedRBConfigurationVertexPartition(Graph* graph,
+      vector<size_t> const& membership) :
+        CPMVertexPartition(graph, membership)
+{ }
+
+SignedRBConfigurationVertexPartition::SignedRBConfigurationVertexPartition(Graph* graph,
+  double resolution_parameter) :
+        CPMVertexPartition(graph, resolution_parameter)
+{ }
+
+SignedRBConfigurationVertexPartition::SignedRBConfigurationVertexPartition(Graph* graph) :
+        CPMVertexPartition(graph)
+{ }
+
+SignedRBConfigurationVertexPartition::~SignedRBConfigurationVertexPartition()
+{ }
+
+SignedRBConfigurationVertexPartition* SignedRBConfigurationVertexPartition::create(Graph* graph)
+{
+  return new SignedRBConfigurationVertexPartition(graph, this->resolution_parameter);
+}
+
+SignedRBConfigurationVertexPartition* SignedRBConfigurationVertexPartition::create(Graph* graph, vector<size_t> const& membership)
+{
+  return new SignedRBConfigurationVertexPartition(graph, membership, this->resolution_parameter);
+}
+
+/*****************************************************************************
+  Returns the difference in quality if we move a node to a new community, i.e.
+  the difference in
+
+    Q = sum_ij (A_ij - gamma k^+_i k^+_j / 2m^+ + gamma k^-_i k^-_j / 2m^-) d(s_i, s_j)
+
+  The contribution of the edges is that of CPM without any resolution.
+******************************************************************************/
+double SignedRBConfigurationVertexPartition::diff_move_signed(size_t v, size_t new_comm, double resolution_parameter)
+{
+  size_t old_comm = this->membership(v);
+  if (new_comm == old_comm)
+    return 0.0;
+
+  double diff = diff_move_weight(this, this->graph, v, old_comm, new_comm);
+
+  double k_neg = this->graph->node_size(v);
+  double k_pos = this->graph->strength(v, IGRAPH_OUT) + k_neg;
+
+  double K_neg_old = this->csize(old_comm);
+  double K_pos_old = this->total_weight_from_comm(old_comm) + K_neg_old;
+  double K_neg_new = this->csize(new_comm);
+  double K_pos_new = this->total_weight_from_comm(new_comm) + K_neg_new;
+
+  // (K + k)^2 - K^2 + (K' - k)^2 - K'^2 = 2k (K - K' + k)
+  double total_pos = this->total_positive_strength();
+  if (total_pos > 0)
+    diff -= resolution_parameter*2.0*k_pos*(K_pos_new - K_pos_old + k_pos)/total_pos;
+
+  double total_neg = this->total_negative_strength();
+  if (total_neg > 0)
+    diff += resolution_parameter*2.0*k_neg*(K_neg_new - K_neg_old + k_neg)/total_neg;
+
+  return diff;
+}
+
+double SignedRBConfigurationVertexPartition::quality_signed(double resolution_parameter)
+{
+  double q = CPMVertexPartition::quality(0.0);
+
+  double total_pos = this->total_positive_strength();
+  double total_neg = this->total_negative_strength();
+  for (size_t c = 0; c < this->n_communities(); c++)
+  {
+    double K_neg = this->csize(c);
+    double K_pos = this->total_weight_from_comm(c) + K_neg;
+    if (total_pos > 0)
+      q -= resolution_parameter*K_pos*K_pos/total_pos;
+    if (total_neg > 0)
+      q += resolution_parameter*K_neg*K_neg/total_neg;
+  }
+  return q;
+}
+
+double SignedRBConfigurationVertexPartition::diff_move(size_t v, size_t new_comm)
+{
+  #ifdef DEBUG
+    cerr << "double SignedRBConfigurationVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+  #endif
+  double diff = this->diff_move_signed(v, new_comm, this->resolution_parameter);
+  #ifdef DEBUG
+    cerr << "exit SignedRBConfigurationVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
+    cerr << "return " << diff << endl << endl;
+  #endif
+  return diff;
+}
+
+double SignedRBConfigurationVertexPartition::quality(double resolution_parameter)
+{
+  #ifdef DEBUG
+    cerr << "double SignedRBConfigurationVertexPartition::quality()" << endl;
+  #endif
+  double q = this->quality_signed(resolution_parameter);
+  #ifdef DEBUG
+    cerr << "exit double SignedRBConfigurationVertexPartition::quality()" << endl;
+    cerr << "return " << q << endl << endl;
+  #endif
+  return q;
+}
@@ -1,7 +1,71 @@
 import igraph as _ig
+from array import array as _array
 from . import _c_leiden
 from .functions import _get_py_capsule
 
+def _get_py_igraph_arrays(partition):
+  """ Get the internal graph of a C++ partition as arrays.
+
+  Returns the number of nodes, whether the graph is directed, an array of the
+  edge endpoints (source and target of each edge consecutively), an array of
+  edge weights and an array of node sizes.
+  """
+  n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(partition)
+  return n, directed, _array('q', edges), _array('d', weights), _array('d', node_sizes)
+
+def _negative_strength(graph, weights):
+  """ Get the total magnitude of the negative weights incident to each node,
+  counting self-loops twice (as for the strength). """
+  if weights is None:
+    return [0]*graph.vcount()
+  return graph.strength(weights=[-w if w < 0 else 0 for w in weights], loops=True)
+
+def _as_packed_memberships(memberships, n, node_order=None):
+  """ Convert a sequence of memberships (or a two-dimensional integer array)
+  to a packed int64 array with one row of ``n`` values per membership. If a
+  ``node_order`` is given, the values in each row are put in that order. """
+  packed = None
+  if isinstance(memberships, (bytes, bytearray)):
+    packed = bytes(memberships)
+  else:
+    try:
+      view = memoryview(memberships)
+    except TypeError:
+      view = None
+    if view is not None and view.ndim == 2 and view.itemsize == 8 and view.format in ('q', 'l'):
+      packed = view.tobytes()
+  if packed is not None:
+    if node_order is None or n == 0:
+      return packed
+    values = _array('q', packed)
+    memberships = [values[k:k+n] for k in range(0, len(values), n)]
+
+  packed = _array('q')
+  for membership in memberships:
+    if len(membership) != n:
+      raise ValueError('Membership not the same size as the number of nodes.')
+    if node_order is None:
+      packed.extend(membership)
+    else:
+      packed.extend(membership[v] for v in node_order)
+  return packed.tobytes()
+
+def _get_node_order(graph, node_order, initial_membership=None):
+  """ Order of the nodes of ``graph`` for the internal graph of a partition,
+  listing the original node at each internal position. """
+  if not isinstance(node_order, str):
+    order = [int(v) for v in node_order]
+    if sorted(order) != list(range(graph.vcount())):
+      raise ValueError('Node order should be a permutation of the nodes.')
+    return order
+  if node_order == 'community':
+    if initial_membership is None:
+      raise ValueError('Node order \'community\' requires an initial membership.')
+    # Group the nodes by community, keeping the breadth-first order within.
+    order = _array('q', _c_leiden._node_order(_get_py_capsule(graph), 'bfs'))
+    return sorted(order, key=lambda v: initial_membership[v])
+  return _array('q', _c_leiden._node_order(_get_py_capsule(graph), node_order)).tolist()
+
 class MutableVertexPartition(_ig.VertexClustering):
   """ Contains a partition of a graph, derives from
   :class:`ig.VertexClustering`. Please see the `documentation
@@ -35,6 +99,10 @@ class MutableVertexPartition(_ig.VertexClustering):
 
   """
 
+  # Order of the nodes in the internal graph, see Reordered
+  _node_order = None
+  _node_position = None
+
   # Init
   def __init__(self, graph, initial_membership=None):
     """
@@ -55,17 +123,32 @@ class MutableVertexPartition(_ig.VertexClustering):
 
   @classmethod
   def _FromCPartition(cls, partition):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(partition)
-    graph = _ig.Graph(n=n,
-                      directed=directed,
-                      edges=edges,
-                      edge_attrs={'weight': weights},
-                      vertex_attrs={'node_size': node_sizes})
-    new_partition = cls(graph)
+    new_partition = cls.__new__(cls)
+    # The igraph graph is only built from the C++ graph when it is used
+    new_partition._graph = None
+    new_partition._modularity = None
+    new_partition._modularity_dirty = True
+    new_partition._modularity_params = {}
     new_partition._partition = partition
     new_partition._update_internal_membership()
     return new_partition
 
+  @property
+  def _graph(self):
+    if self._py_graph is None:
+      n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
+      edges = iter(edges)
+      self._py_graph = _ig.Graph(n=n,
+                                 directed=directed,
+                                 edges=zip(edges, edges),
+                                 edge_attrs={'weight': weights.tolist()},
+                                 vertex_attrs={'node_size': node_sizes.tolist()})
+    return self._py_graph
+
+  @_graph.setter
+  def _graph(self, graph):
+    self._py_graph = graph
+
   @classmethod
   def FromPartition(cls, partition, **kwargs):
     """ Create a new partition from an existing partition.
@@ -93,17 +176,140 @@ class MutableVertexPartition(_ig.VertexClustering):
     new_partition = cls(partition.graph, partition.membership, **kwargs)
     return new_partition
 
+  @classmethod
+  def Reordered(cls, graph, node_order='rcm', initial_membership=None, **kwargs):
+    """ Create a partition whose internal graph lists the nodes in a different
+    order, for better memory locality during optimisation.
+
+    The internal graph is a copy of ``graph`` with its nodes permuted, so that
+    adjacent nodes, and therefore their neighbours and communities, tend to be
+    close in memory. This is meant for large graphs whose node order is
+    effectively random, for example when the nodes are numbered in the order
+    in which they were crawled. Whether it pays off depends on the graph and
+    the machine, and the reordering itself takes time, so it is best measured,
+    for example with ``benchmarks/reorder.py`` in the source repository. The
+    reordering is transparent: all nodes are referred to by their index in
+    ``graph``, and :attr:`membership` lists the community of each node of
+    ``graph``.
+
+    Parameters
+    ----------
+    graph : :class:`ig.Graph`
+      Graph to define the partition on.
+
+    node_order : str or list of int
+      Order of the nodes in the internal graph. This is either ``'rcm'``
+      (reverse Cuthill-McKee, the default), ``'bfs'`` (breadth-first search),
+      ``'degree'`` (by decreasing degree), ``'community'`` (grouped by the
+      community in ``initial_membership``), or an explicit list of the nodes
+      of ``graph`` in their new order.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    **kwargs
+      Remaining keyword arguments, passed on to the constructor of the
+      partition. Weights and node attributes may be given as attribute names
+      or as lists of values for the nodes of ``graph``.
+
+    Returns
+    -------
+    :class:`~VertexPartition.MutableVertexPartition`
+      The partition on the reordered graph.
+
+    Notes
+    -----
+    The reordering only takes effect within the partition. Partitions that are
+    optimised together, as in
+    :func:`Optimiser.optimise_partition_multiplex`, need to use the same node
+    order.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.ModularityVertexPartition.Reordered(G, 'rcm')
+    >>> optimiser = la.Optimiser()
+    >>> diff = optimiser.optimise_partition(partition)
+    """
+    order = _get_node_order(graph, node_order, initial_membership)
+    position = [0]*len(order)
+    for i, v in enumerate(order):
+      position[v] = i
+
+    # Node i of the reordered graph is node order[i] of graph, while the
+    # edges keep their order.
+    reordered_graph = graph.permute_vertices(position)
+    if initial_membership is not None:
+      initial_membership = list(initial_membership)
+      initial_membership = [initial_membership[v] for v in order]
+    for key in ('node_sizes', 'negative_strength', 'types'):
+      value = kwargs.get(key)
+      if value is not None and not isinstance(value, str):
+        value = list(value)
+        kwargs[key] = [value[v] for v in order]
+
+    partition = cls(reordered_graph, initial_membership=initial_membership, **kwargs)
+    partition._set_node_order(graph, reordered_graph, order, position)
+    return partition
+
+  def _set_node_order(self, graph, reordered_graph, order, position):
+    # The internal graph refers to the reordered graph, which is kept alive
+    # here, while the partition itself presents the original graph.
+    self._reordered_graph = reordered_graph
+    self._graph = graph
+    self._node_order = order
+    self._node_position = position
+    self._modularity_dirty = True
+    self._update_internal_membership()
+
+  def _internal_node(self, v):
+    if self._node_position is None:
+      return v
+    return self._node_position[v]
+
+  def _internal_membership(self, membership):
+    # Membership in the order of the nodes in the internal graph
+    membership = list(membership)
+    if self._node_order is None:
+      return membership
+    if len(membership) != len(self._node_order):
+      raise ValueError('Membership not the same size as the number of nodes.')
+    return [membership[v] for v in self._node_order]
+
+  def __deepcopy__(self, memo):
+    if self._node_order is None:
+      return self._deepcopy(memo)
+    # Copy the partition of the reordered graph, and present the copy in the
+    # original order likewise.
+    view = self.__class__.__new__(self.__class__)
+    view._graph = self._reordered_graph
+    view._membership = _c_leiden._MutableVertexPartition_get_membership(self._partition)
+    view._len = self._len
+    view._partition = self._partition
+    new_partition = view._deepcopy(memo)
+    new_partition._set_node_order(self._graph, self._reordered_graph, self._node_order, self._node_position)
+    return new_partition
+
   def _update_internal_membership(self):
     self._membership = _c_leiden._MutableVertexPartition_get_membership(self._partition)
+    if self._node_position is not None:
+      self._membership = [self._membership[i] for i in self._node_position]
     # Reset the length of the object, i.e. the number of communities
     if len(self._membership)>0:
         self._len = max(m for m in self._membership if m is not None)+1
     else:
         self._len = 0
 
+  def _copy_internal_membership(self, partition):
+    # Take over the membership of another partition that is known to have an
+    # identical membership, e.g. another layer of a multiplex optimisation.
+    self._membership = list(partition._membership)
+    self._len = partition._len
+
   def set_membership(self, membership):
     """ Set membership. """
-    _c_leiden._MutableVertexPartition_set_membership(self._partition, list(membership))
+    _c_leiden._MutableVertexPartition_set_membership(self._partition, self._internal_membership(membership))
     self._update_internal_membership()
 
   # Calculate improvement *if* we move this node
@@ -144,14 +350,32 @@ class MutableVertexPartition(_ig.VertexClustering):
                  class provides no implementation for this function.
 
     """
-    return _c_leiden._MutableVertexPartition_diff_move(self._partition, v, new_comm)
+    return _c_leiden._MutableVertexPartition_diff_move(self._partition, self._internal_node(v), new_comm)
 
-  def aggregate_partition(self, membership_partition=None):
+  def aggregate_partition(self, membership_partition=None, order=None):
     """ Aggregate the graph according to the current partition and provide a
     default partition for it.
 
     The aggregated graph can then be found as a parameter of the partition
-    ``partition.graph``.
+    ``partition.graph``. This :class:`ig.Graph` is only constructed from the
+    internal aggregate graph when it is first accessed, so that continuing
+    to optimise the aggregate partition does not require it.
+
+    Parameters
+    ----------
+    membership_partition : :class:`~VertexPartition.MutableVertexPartition`
+      If not :obj:`None`, the membership of the aggregate partition is taken
+      from this partition, instead of a singleton partition.
+
+    order : str or None
+      Layout of the nodes of the aggregate graph. By default (:obj:`None`),
+      node ``c`` of the aggregate graph is community ``c``. Otherwise, the
+      communities of this partition are first relabelled by decreasing size
+      (``'size'``), or in the order in which a breadth-first search reaches
+      them (``'traversal'``), so that adjacent aggregate nodes are close in
+      memory. The relabelling is reflected in :attr:`membership`, so that
+      :func:`from_coarse_partition` continues to map the aggregate partition
+      back to this partition.
 
     Notes
     -----
@@ -171,16 +395,94 @@ class MutableVertexPartition(_ig.VertexClustering):
     >>> aggregate_partition.quality() == partition.quality()
     True
     """
-    partition_agg = self._FromCPartition(_c_leiden._MutableVertexPartition_aggregate_partition(self._partition))
+    partition_agg = self._FromCPartition(_c_leiden._MutableVertexPartition_aggregate_partition(self._partition, order))
+    if order is not None:
+      self._update_internal_membership()
 
     if (not membership_partition is None):
       membership = partition_agg.membership
-      for v in self.graph.vs:
-        membership[self.membership[v.index]] = membership_partition.membership[v.index]
+      for v, c in enumerate(self.membership):
+        membership[c] = membership_partition.membership[v]
       partition_agg.set_membership(membership)
 
     return partition_agg
 
+  def share_graph(self, initial_membership=None):
+    """ Create a new partition of the same type and with the same parameters
+    that shares the underlying graph with this partition.
+
+    Parameters
+    ----------
+    initial_membership
+      The membership vector of the new partition. If ``None``, it is
+      initialised with a singleton partition.
+
+    Notes
+    -----
+    Constructing a partition normally copies the graph into its own internal
+    representation. A partition created by this function instead refers to the
+    internal graph of this partition. This partition is kept alive for as long
+    as the new partition exists. The edges, weights and node sizes of the
+    graph are never modified, but the graph caches the neighbours and
+    incident edges of the node it last looked up, and these caches are
+    written whenever nodes are moved. Partitions that share a graph therefore
+    also share a lock, so that an optimisation of one of them, for example by
+    :func:`~Optimiser.Optimiser.optimise_partition_future`, waits for a
+    running optimisation of another one to finish.
+
+    This is useful for running many optimisations in parallel using
+    :mod:`multiprocessing` with the ``fork`` start method. If the partition is
+    constructed in the parent process, worker processes can create their own
+    partition using this function. The memory of the graph is then shared
+    between the processes (copy-on-write), but only in part. What stays
+    shared are the arrays of the graph that are only read: the edges and
+    their index, the edge weights, the node sizes and the degrees and
+    strengths of the nodes, which take up most of the memory of a large
+    graph. A worker writes to, and hence copies, the pages that hold the
+    graph object itself and its neighbour caches, which grow to the largest
+    degree of the nodes it looked up. In addition, every worker holds memory
+    of its own that is not shared at all: its partition, whose arrays are
+    proportional to the number of nodes, and the aggregate graphs and
+    partitions of all levels of an optimisation, which for the first
+    aggregation may be nearly as large as the graph itself. The memory of a
+    worker can be estimated using :func:`memory_usage` and
+    :attr:`~Optimiser.Optimiser.peak_memory_usage`::
+
+      partition = la.CPMVertexPartition(G, resolution_parameter=0.05)
+
+      def run(seed):
+        p = partition.share_graph()
+        optimiser = la.Optimiser()
+        optimiser.set_rng_seed(seed)
+        optimiser.optimise_partition(p)
+        return p.membership
+
+      with multiprocessing.get_context('fork').Pool(4) as pool:
+        memberships = pool.map(run, range(10))
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.CPMVertexPartition(G, resolution_parameter=0.1)
+    >>> new_partition = partition.share_graph()
+    >>> optimiser = la.Optimiser()
+    >>> diff = optimiser.optimise_partition(new_partition)
+    """
+    if initial_membership is not None:
+      initial_membership = self._internal_membership(initial_membership)
+
+    partition = _c_leiden._MutableVertexPartition_share_graph(self._partition, initial_membership)
+
+    new_partition = self.__class__.__new__(self.__class__)
+    MutableVertexPartition.__init__(new_partition, self.graph)
+    new_partition._partition = partition
+    # The underlying graph is owned by this partition
+    new_partition._graph_owner = self
+    if self._node_order is not None:
+      new_partition._set_node_order(self._graph, self._reordered_graph, self._node_order, self._node_position)
+    new_partition._update_internal_membership()
+    return new_partition
+
   def move_node(self,v,new_comm):
     """ Move node ``v`` to community ``new_comm``.
 
@@ -198,7 +500,7 @@ class MutableVertexPartition(_ig.VertexClustering):
     >>> partition = la.ModularityVertexPartition(G)
     >>> partition.move_node(0, 1)
     """
-    _c_leiden._MutableVertexPartition_move_node(self._partition, v, new_comm)
+    _c_leiden._MutableVertexPartition_move_node(self._partition, self._internal_node(v), new_comm)
     # Make sure this move is also reflected in the membership vector of the python object
     self._membership[v] = new_comm
     self._modularity_dirty = True
@@ -252,6 +554,8 @@ class MutableVertexPartition(_ig.VertexClustering):
     refined partition.
     """
     # Read the coarser partition
+    if coarse_node is not None:
+      coarse_node = self._internal_membership(coarse_node)
     _c_leiden._MutableVertexPartition_from_coarse_partition(self._partition,
                                                              partition.membership, coarse_node)
     self._update_internal_membership()
@@ -270,6 +574,40 @@ class MutableVertexPartition(_ig.VertexClustering):
     """ The current quality of the partition. """
     return _c_leiden._MutableVertexPartition_quality(self._partition)
 
+  def quality_batch(self, memberships, n_threads=1):
+    """ The quality of many candidate memberships.
+
+    Each membership is scored as if it were set on this partition, but the
+    partition itself is left untouched. The memberships are evaluated in
+    parallel on the same graph, which waits for any optimisation of a
+    partition sharing the graph, see :func:`share_graph`.
+
+    Parameters
+    ----------
+    memberships
+      Sequence of memberships, each listing the community of every node.
+      Alternatively, a two-dimensional int64 array with one row per membership
+      (such as a numpy array), or the bytes of such an array.
+
+    n_threads : int
+      Number of threads to use. If 0 or negative, use all available cores.
+
+    Returns
+    -------
+    list of float
+      The quality of each membership.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> q = partition.quality_batch([[0]*G.vcount(), list(range(G.vcount()))])
+    """
+    return _c_leiden._MutableVertexPartition_quality_batch(
+            self._partition,
+            _as_packed_memberships(memberships, self.n, self._node_order),
+            n_threads=n_threads)
+
   def total_weight_in_comm(self, comm):
     """ The total weight (i.e. number of edges) within a community.
 
@@ -372,7 +710,7 @@ class MutableVertexPartition(_ig.VertexClustering):
     --------
     :func:`~VertexPartition.MutableVertexPartition.weight_from_comm`
     """
-    return _c_leiden._MutableVertexPartition_weight_to_comm(self._partition, v, comm)
+    return _c_leiden._MutableVertexPartition_weight_to_comm(self._partition, self._internal_node(v), comm)
 
   def weight_from_comm(self, v, comm):
     """ The total number of edges (or sum of weights) to node ``v`` from
@@ -382,7 +720,42 @@ class MutableVertexPartition(_ig.VertexClustering):
     --------
     :func:`~VertexPartition.MutableVertexPartition.weight_to_comm`
     """
-    return _c_leiden._MutableVertexPartition_weight_from_comm(self._partition, v, comm)
+    return _c_leiden._MutableVertexPartition_weight_from_comm(self._partition, self._internal_node(v), comm)
+
+  def memory_usage(self):
+    """ Estimated number of bytes held by the underlying C++ graph and
+    partition.
+
+    Returns
+    -------
+    dict
+      The estimated number of bytes for the following parts:
+
+      * ``adjacency``: the edge lists and indices of the graph.
+      * ``weights``: the edge weights.
+      * ``nodes``: node sizes, strengths and degrees.
+      * ``membership``: the membership of all nodes.
+      * ``communities``: sizes and total weights of the communities.
+      * ``community_caches``: the caches for weights to neighbouring
+        communities, used when moving nodes.
+      * ``total``: the sum of all of the above.
+      * ``aggregation``: an upper bound on the additional memory used for the
+        aggregate graphs and partitions when optimising this partition.
+
+    Notes
+    -----
+    The estimate is based on the sizes of the main arrays, and ignores any
+    overhead of the memory allocator and of the Python objects.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> usage = partition.memory_usage()
+    >>> usage['total'] > 0
+    True
+    """
+    return _c_leiden._MutableVertexPartition_memory_usage(self._partition)
 
 class ModularityVertexPartition(MutableVertexPartition):
   r""" Implements modularity. This quality function is well-defined only for positive edge weights.
@@ -457,8 +830,8 @@ class ModularityVertexPartition(MutableVertexPartition):
         initial_membership, weights)
     self._update_internal_membership()
 
-  def __deepcopy__(self, memo):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
     new_partition = ModularityVertexPartition(self.graph, self.membership, weights)
     return new_partition
 
@@ -545,8 +918,8 @@ class SurpriseVertexPartition(MutableVertexPartition):
         initial_membership, weights, node_sizes)
     self._update_internal_membership()
 
-  def __deepcopy__(self, memo):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
     new_partition = SurpriseVertexPartition(self.graph, self.membership, weights, node_sizes)
     return new_partition
 
@@ -619,8 +992,8 @@ class SignificanceVertexPartition(MutableVertexPartition):
     self._partition = _c_leiden._new_SignificanceVertexPartition(pygraph_t, initial_membership, node_sizes)
     self._update_internal_membership()
 
-  def __deepcopy__(self, memo):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
     new_partition = SignificanceVertexPartition(self.graph, self.membership, node_sizes)
     return new_partition
 
@@ -670,6 +1043,19 @@ class LinearResolutionParameterVertexPartition(MutableVertexPartition):
   def quality(self, resolution_parameter=None):
     return _c_leiden._ResolutionParameterVertexPartition_quality(self._partition, resolution_parameter)
 
+  def quality_batch(self, memberships, resolution_parameter=None, n_threads=1):
+    """ The quality of many candidate memberships.
+
+    See :func:`MutableVertexPartition.quality_batch`. If
+    ``resolution_parameter`` is None, the resolution parameter of this
+    partition is used.
+    """
+    return _c_leiden._MutableVertexPartition_quality_batch(
+            self._partition,
+            _as_packed_memberships(memberships, self.n, self._node_order),
+            resolution_parameter=resolution_parameter,
+            n_threads=n_threads)
+
 class RBERVertexPartition(LinearResolutionParameterVertexPartition):
   """ Implements Reichardt and Bornholdt’s Potts model with an Erdős-Rényi null model.
   This quality function is well-defined only for positive edge weights.
@@ -752,8 +1138,8 @@ class RBERVertexPartition(LinearResolutionParameterVertexPartition):
         initial_membership, weights, node_sizes, resolution_parameter)
     self._update_internal_membership()
 
-  def __deepcopy__(self, memo):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
     new_partition = RBERVertexPartition(self.graph, self.membership, weights, node_sizes, self.resolution_parameter)
     return new_partition
 
@@ -841,8 +1227,8 @@ class RBConfigurationVertexPartition(LinearResolutionParameterVertexPartition):
         initial_membership, weights, resolution_parameter)
     self._update_internal_membership()
 
-  def __deepcopy__(self, memo):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
     new_partition = RBConfigurationVertexPartition(self.graph, self.membership, weights, self.resolution_parameter)
     return new_partition
 
@@ -942,8 +1328,8 @@ class CPMVertexPartition(LinearResolutionParameterVertexPartition):
         initial_membership, weights, node_sizes, resolution_parameter, correct_self_loops)
     self._update_internal_membership()
 
-  def __deepcopy__(self, memo):
-    n, directed, edges, weights, node_sizes = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
     new_partition = CPMVertexPartition(self.graph, self.membership, weights, node_sizes, self.resolution_parameter)
     return new_partition
 
@@ -1103,3 +1489,307 @@ class CPMVertexPartition(LinearResolutionParameterVertexPartition):
                                  for v, s, t in zip(graph.vs,node_sizes,types)],
                      resolution_parameter=resolution_parameter_01 - resolution_parameter_1)
     return partition_01, partition_0, partition_1
+
+class BipartiteCPMVertexPartition(LinearResolutionParameterVertexPartition):
+  """ Implements the Constant Potts Model (CPM) for bipartite graphs.
+
+  This is equivalent to optimising the three layers created by
+  :func:`CPMVertexPartition.Bipartite` with ``layer_weights=[1,-1,-1]``, but
+  only requires a single partition of a single graph, so that each move is
+  only evaluated once. See :func:`CPMVertexPartition.Bipartite` for more
+  details.
+
+  Notes
+  -----
+  The quality function is
+
+  .. math:: Q = \\sum_c (e_c
+                        - \\gamma_{01} 2 n_c(0) n_c(1)
+                        - \\gamma_0 n^2_c(0)
+                        - \\gamma_1 n^2_c(1))
+
+  where :math:`n_c(0)` is the number of nodes in community :math:`c` of class 0
+  (and similarly for 1) and :math:`e_c` is the number of edges within community
+  :math:`c`.
+
+  The sizes of both classes in a community are tracked by encoding the class
+  of a node in its internal node size. Node sizes should therefore be
+  integers. For the same reason, the ``min_comm_size`` and ``max_comm_size`` of
+  the :class:`Optimiser` are not supported for this partition.
+  """
+  def __init__(self, graph, resolution_parameter_01=1.0,
+               resolution_parameter_0=0, resolution_parameter_1=0,
+               types='type', initial_membership=None, weights=None,
+               node_sizes=None, degree_as_node_size=False, correct_self_loops=None):
+    """
+    Parameters
+    ----------
+    graph : :class:`ig.Graph`
+      Graph to define the partition on.
+
+    resolution_parameter_01 : double
+      Resolution parameter for in between two classes.
+
+    resolution_parameter_0 : double
+      Resolution parameter for class 0.
+
+    resolution_parameter_1 : double
+      Resolution parameter for class 1.
+
+    types : vertex attribute or list
+      Indicator of the class for each vertex. If not 0, 1, it is automatically
+      converted.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    weights : list of double, or edge attribute
+      Weights of edges. Can be either an iterable or an edge attribute.
+
+    node_sizes : list of int, or vertex attribute
+      Integer sizes of the nodes. By default, the node sizes are set to 1.
+
+    degree_as_node_size : boolean
+      If ``True`` use degree as node size instead of 1, to mimic modularity,
+      see :func:`CPMVertexPartition.Bipartite`.
+    """
+    if initial_membership is not None:
+      initial_membership = list(initial_membership)
+
+    super(BipartiteCPMVertexPartition, self).__init__(graph, initial_membership)
+
+    pygraph_t = _get_py_capsule(graph)
+
+    if isinstance(types, str):
+      types = graph.vs[types]
+    else:
+      # Make sure it is a list
+      types = list(types)
+
+    if set(types) != set([0, 1]):
+      new_type = _ig.UniqueIdGenerator()
+      types = [new_type[t] for t in types]
+
+    if set(types) != set([0, 1]):
+      raise ValueError("More than one type specified.")
+
+    if weights is not None:
+      if isinstance(weights, str):
+        weights = graph.es[weights]
+      else:
+        # Make sure it is a list
+        weights = list(weights)
+
+    if degree_as_node_size:
+      if (graph.is_directed()):
+        raise ValueError("This method is not suitable for directed graphs " +
+                         "when using degree as node sizes.")
+      node_sizes = graph.degree()
+    elif node_sizes is None:
+      node_sizes = [1]*graph.vcount()
+    elif isinstance(node_sizes, str):
+      node_sizes = graph.vs[node_sizes]
+    else:
+      # Make sure it is a list
+      node_sizes = list(node_sizes)
+
+    if any(s != int(s) or s < 0 for s in node_sizes):
+      raise ValueError("Node sizes should be non-negative integers.")
+
+    # Encode the class in the node size, such that the total size of class 0
+    # in a community is always smaller than the base of class 1.
+    type_base = sum(s for s, t in zip(node_sizes, types) if t == 0) + 1
+    node_sizes = [s if t == 0 else s*type_base for s, t in zip(node_sizes, types)]
+
+    if correct_self_loops is None:
+      correct_self_loops = any(graph.is_loop())
+
+    self._partition = _c_leiden._new_BipartiteCPMVertexPartition(pygraph_t,
+        initial_membership, weights, node_sizes,
+        resolution_parameter_01, resolution_parameter_0, resolution_parameter_1,
+        type_base, correct_self_loops)
+    self._update_internal_membership()
+
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
+    resolution_parameter_0, resolution_parameter_1, type_base = \
+        _c_leiden._BipartiteCPMVertexPartition_get_parameters(self._partition)
+    new_partition = BipartiteCPMVertexPartition.__new__(BipartiteCPMVertexPartition)
+    MutableVertexPartition.__init__(new_partition, self.graph, self.membership)
+    new_partition._partition = _c_leiden._new_BipartiteCPMVertexPartition(
+        _get_py_capsule(self.graph), self.membership, weights.tolist(), node_sizes.tolist(),
+        self.resolution_parameter, resolution_parameter_0, resolution_parameter_1,
+        type_base, any(self.graph.is_loop()))
+    new_partition._update_internal_membership()
+    return new_partition
+
+  @property
+  def resolution_parameter_0(self):
+    """ Resolution parameter for class 0. """
+    return _c_leiden._BipartiteCPMVertexPartition_get_parameters(self._partition)[0]
+
+  @property
+  def resolution_parameter_1(self):
+    """ Resolution parameter for class 1. """
+    return _c_leiden._BipartiteCPMVertexPartition_get_parameters(self._partition)[1]
+
+class SignedRBConfigurationVertexPartition(LinearResolutionParameterVertexPartition):
+  r""" Implements Reichardt and Bornholdt's Potts model with a configuration
+  null model for graphs with both positive and negative edge weights.
+  This quality function uses a linear resolution parameter.
+
+  Notes
+  -----
+  The quality function is
+
+  .. math:: Q = \\sum_{ij} \\left(A_{ij} - \\gamma \\frac{k^+_i k^+_j}{2m^+}
+                                   + \\gamma \\frac{k^-_i k^-_j}{2m^-} \\right)\\delta(\\sigma_i, \\sigma_j)
+
+  where :math:`A` is the (signed) adjacency matrix, :math:`k^+_i` and
+  :math:`k^-_i` are the total positive and negative weight of the links of
+  node :math:`i`, and :math:`m^+` and :math:`m^-` the total positive and
+  negative weight.
+
+  This is identical to splitting the graph in a positive and a negative layer
+  and optimising two :class:`RBConfigurationVertexPartition` with
+  ``layer_weights=[1,-1]``, as explained in the documentation on negative
+  links in multiplex graphs, but only requires a single graph and a single
+  partition. The negative weight of each node is kept as its node size, so
+  that aggregate graphs, which only contain the net weight between
+  communities, remain exact. This is only implemented for undirected graphs.
+
+  References
+  ----------
+  .. [1] Traag, V. A., & Bruggeman, J. (2009). Community detection in networks
+         with positive and negative links. Physical Review E, 80(3), 036115.
+         `10.1103/PhysRevE.80.036115 <http://doi.org/10.1103/PhysRevE.80.036115>`_
+  """
+  def __init__(self, graph, initial_membership=None, weights=None, resolution_parameter=1.0, negative_strength=None):
+    """
+    Parameters
+    ----------
+    graph : :class:`ig.Graph`
+      Undirected graph to define the partition on.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    weights : list of double, or edge attribute
+      Weights of edges, which may be negative. Can be either an iterable or an
+      edge attribute.
+
+    resolution_parameter : double
+      Resolution parameter.
+
+    negative_strength : list of double, or vertex attribute
+      Total negative weight of the links of each node. By default, this is
+      determined from the ``weights``. It only needs to be specified if the
+      weights are net weights, such as for an aggregate graph.
+    """
+    if initial_membership is not None:
+      initial_membership = list(initial_membership)
+
+    super(SignedRBConfigurationVertexPartition, self).__init__(graph, initial_membership)
+
+    pygraph_t = _get_py_capsule(graph)
+
+    if weights is not None:
+      if isinstance(weights, str):
+        weights = graph.es[weights]
+      else:
+        # Make sure it is a list
+        weights = list(weights)
+
+    if negative_strength is None:
+      negative_strength = _negative_strength(graph, weights)
+    elif isinstance(negative_strength, str):
+      negative_strength = graph.vs[negative_strength]
+    else:
+      # Make sure it is a list
+      negative_strength = list(negative_strength)
+
+    self._partition = _c_leiden._new_SignedRBConfigurationVertexPartition(pygraph_t,
+        initial_membership, weights, negative_strength, resolution_parameter)
+    self._update_internal_membership()
+
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
+    new_partition = SignedRBConfigurationVertexPartition(self.graph, self.membership, weights,
+        self.resolution_parameter, negative_strength=node_sizes)
+    return new_partition
+
+class SignedModularityVertexPartition(MutableVertexPartition):
+  r""" Implements modularity for graphs with both positive and negative edge
+  weights.
+
+  Notes
+  -----
+  The quality function is
+
+  .. math:: Q = \\frac{1}{2m^+ + 2m^-} \\sum_{ij} \\left(A_{ij} - \\frac{k^+_i k^+_j}{2m^+}
+                                   + \\frac{k^-_i k^-_j}{2m^-} \\right)\\delta(\\sigma_i, \\sigma_j)
+
+  using the same notation as :class:`SignedRBConfigurationVertexPartition`.
+  Without negative weights, this is identical to
+  :class:`ModularityVertexPartition`. This is only implemented for undirected
+  graphs.
+
+  References
+  ----------
+  .. [1] Gómez, S., Jensen, P., & Arenas, A. (2009). Analysis of community
+         structure in networks of correlated data. Physical Review E, 80(1),
+         016114. `10.1103/PhysRevE.80.016114 <http://doi.org/10.1103/PhysRevE.80.016114>`_
+  """
+  def __init__(self, graph, initial_membership=None, weights=None, negative_strength=None):
+    """
+    Parameters
+    ----------
+    graph : :class:`ig.Graph`
+      Undirected graph to define the partition on.
+
+    initial_membership : list of int
+      Initial membership for the partition. If :obj:`None` then defaults to a
+      singleton partition.
+
+    weights : list of double, or edge attribute
+      Weights of edges, which may be negative. Can be either an iterable or an
+      edge attribute.
+
+    negative_strength : list of double, or vertex attribute
+      Total negative weight of the links of each node. By default, this is
+      determined from the ``weights``. It only needs to be specified if the
+      weights are net weights, such as for an aggregate graph.
+    """
+    if initial_membership is not None:
+      initial_membership = list(initial_membership)
+
+    super(SignedModularityVertexPartition, self).__init__(graph, initial_membership)
+
+    pygraph_t = _get_py_capsule(graph)
+
+    if weights is not None:
+      if isinstance(weights, str):
+        weights = graph.es[weights]
+      else:
+        # Make sure it is a list
+        weights = list(weights)
+
+    if negative_strength is None:
+      negative_strength = _negative_strength(graph, weights)
+    elif isinstance(negative_strength, str):
+      negative_strength = graph.vs[negative_strength]
+    else:
+      # Make sure it is a list
+      negative_strength = list(negative_strength)
+
+    self._partition = _c_leiden._new_SignedModularityVertexPartition(pygraph_t,
+        initial_membership, weights, negative_strength)
+    self._update_internal_membership()
+
+  def _deepcopy(self, memo):
+    n, directed, edges, weights, node_sizes = _get_py_igraph_arrays(self._partition)
+    new_partition = SignedModularityVertexPartition(self.graph, self.membership, weights,
+        negative_strength=node_sizes)
+    return new_partition
@@ -36,13 +36,18 @@ from .functions import ALL_COMMS
 from .functions import ALL_NEIGH_COMMS
 from .functions import RAND_COMM
 from .functions import RAND_NEIGH_COMM
+from .functions import PRUNED_ALL_COMMS
 
 from .functions import MOVE_NODES
 from .functions import MERGE_NODES
 
 from .functions import find_partition
+from .functions import find_partition_async
+from .functions import find_partitions_batch
 from .functions import find_partition_multiplex
 from .functions import find_partition_temporal
+from .functions import find_partition_temporal_update
+from .functions import graph_memory_usage
 from .functions import slices_to_layers
 from .functions import time_slices_to_layers
 
@@ -53,5 +58,8 @@ from .VertexPartition import SignificanceVertexPartition
 from .VertexPartition import RBERVertexPartition
 from .VertexPartition import RBConfigurationVertexPartition
 from .VertexPartition import CPMVertexPartition
+from .VertexPartition import BipartiteCPMVertexPartition
+from .VertexPartition import SignedRBConfigurationVertexPartition
+from .VertexPartition import SignedModularityVertexPartition
 
 from .version import *
@@ -1,15 +1,19 @@
 import sys
+import random
 import igraph as _ig
 from . import _c_leiden
 from ._c_leiden import ALL_COMMS
 from ._c_leiden import ALL_NEIGH_COMMS
 from ._c_leiden import RAND_COMM
 from ._c_leiden import RAND_NEIGH_COMM
+from ._c_leiden import PRUNED_ALL_COMMS
 
 from ._c_leiden import MOVE_NODES
 from ._c_leiden import MERGE_NODES
 
 from collections import Counter
+from itertools import chain
+from array import array as _array
 
 
 def _get_py_capsule(graph):
@@ -18,7 +22,7 @@ def _get_py_capsule(graph):
 from .VertexPartition import *
 from .Optimiser import *
 
-def find_partition(graph, partition_type, initial_membership=None, weights=None, n_iterations=2, max_comm_size=0, seed=None, **kwargs):
+def find_partition(graph, partition_type, initial_membership=None, weights=None, n_iterations=2, max_comm_size=0, seed=None, node_order=None, **kwargs):
   """ Detect communities using the default settings.
 
   This function detects communities given the specified method in the
@@ -57,6 +61,12 @@ def find_partition(graph, partition_type, initial_membership=None, weights=None,
     Seed for the random number generator. By default uses a random seed
     if nothing is specified.
 
+  node_order : str or None
+    If not :obj:`None`, reorder the nodes of the internal graph for better
+    memory locality, e.g. ``'rcm'``. See
+    :func:`~VertexPartition.MutableVertexPartition.Reordered`. The returned
+    partition still refers to the nodes of ``graph``.
+
   **kwargs
     Remaining keyword arguments, passed on to constructor of
     ``partition_type``.
@@ -76,11 +86,220 @@ def find_partition(graph, partition_type, initial_membership=None, weights=None,
   >>> partition = la.find_partition(G, la.ModularityVertexPartition)
 
   """
+  partition, optimiser = _prepare_find_partition(graph, partition_type, initial_membership, weights,
+                                                 max_comm_size, seed, node_order, **kwargs)
+
+  optimiser.optimise_partition(partition, n_iterations)
+
+  return partition
+
+async def find_partition_async(graph, partition_type, initial_membership=None, weights=None, n_iterations=2, max_comm_size=0, seed=None, node_order=None, **kwargs):
+  """ Detect communities using the default settings without blocking the
+  event loop.
+
+  This is :func:`find_partition` as a coroutine, which runs the optimisation
+  on a pool of threads, see :func:`Optimiser.optimise_partition_async`.
+  Cancelling the coroutine stops the optimisation.
+
+  Parameters
+  ----------
+  graph : :class:`ig.Graph`
+    The graph for which to detect communities.
+
+  partition_type : type of :class:`
+    The type of partition to use for optimisation.
+
+  **kwargs
+    The remaining arguments are as for :func:`find_partition`.
+
+  Returns
+  -------
+  partition
+    The optimised partition.
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> partition = asyncio.run(la.find_partition_async(G, la.ModularityVertexPartition)) # doctest: +SKIP
+
+  """
+  partition, optimiser = _prepare_find_partition(graph, partition_type, initial_membership, weights,
+                                                 max_comm_size, seed, node_order, **kwargs)
+
+  await optimiser.optimise_partition_async(partition, n_iterations=n_iterations)
+
+  return partition
+
+def find_partitions_batch(edges, edge_offsets, node_offsets, partition_type, weights=None, directed=False, n_iterations=2, max_comm_size=0, seed=None, n_threads=0, optimiser=None, **kwargs):
+  """ Detect communities in many graphs at once.
+
+  The graphs are given together as one concatenated edge array, and are
+  clustered in parallel without creating an :class:`ig.Graph`, a partition or
+  an optimiser per graph. This is suited for clustering many small graphs,
+  for which the overhead of :func:`find_partition` dominates.
+
+  Parameters
+  ----------
+  edges : sequence of pairs of int, or int64 array
+    Edges of all graphs, one graph after the other. The nodes of each graph
+    are numbered from ``0``. May also be a flat sequence, an ``(m, 2)`` int64
+    array (such as a numpy array) or the bytes of such an array.
+
+  edge_offsets : sequence of int
+    Offset of the first edge of each graph, followed by the total number of
+    edges, so that the edges of graph ``g`` are ``edges[edge_offsets[g]:edge_offsets[g+1]]``.
+
+  node_offsets : sequence of int
+    Offset of the first node of each graph in the returned membership,
+    followed by the total number of nodes, so that graph ``g`` has
+    ``node_offsets[g+1] - node_offsets[g]`` nodes.
+
+  partition_type : type of :class:`
+    The type of partition to use for optimisation. Types whose quality
+    depends on more than the graph and its edge weights, that is
+    :class:`BipartiteCPMVertexPartition`,
+    :class:`SignedRBConfigurationVertexPartition` and
+    :class:`SignedModularityVertexPartition`, are not supported and raise a
+    :class:`ValueError`.
+
+  weights : sequence of float, or float array
+    Weights of all edges, in the same order as ``edges``. If :obj:`None`, all
+    edges have weight ``1``.
+
+  directed : bool
+    Whether the graphs are directed.
+
+  n_iterations : int
+    Number of iterations to run the Leiden algorithm on each graph, see
+    :func:`find_partition`.
+
+  max_comm_size : non-negative int
+    Maximal total size of nodes in a community. If zero (the default), then
+    communities can be of any size.
+
+  seed : int
+    Seed for the random number generator of the first graph. Graph ``g``
+    uses seed ``seed + g``, so that results are reproducible regardless of
+    ``n_threads``. By default uses a random seed if nothing is specified.
+
+  n_threads : int
+    Number of threads to use. If ``0`` (the default), the number of available
+    processors is used.
+
+  optimiser : :class:`Optimiser`
+    Optimiser whose settings are used for all graphs, for example
+    :attr:`Optimiser.consider_comms` or :attr:`Optimiser.aggregate_order`,
+    in which case ``max_comm_size`` is also taken from this optimiser. The
+    graphs are optimised as by :func:`Optimiser.optimise_partition`, except
+    that :attr:`Optimiser.time_budget` and :attr:`Optimiser.progress` are not
+    used. By default, an optimiser with the default settings is used.
+
+  **kwargs
+    Remaining keyword arguments, passed on to constructor of
+    ``partition_type``, for example a ``resolution_parameter``.
+
+  Returns
+  -------
+  array of int
+    The membership of all graphs, one graph after the other, so that
+    ``membership[node_offsets[g]:node_offsets[g+1]]`` is the membership of
+    graph ``g``.
+
+  See Also
+  --------
+  :func:`find_partition`
+
+  Examples
+  --------
+  >>> graphs = [ig.Graph.Famous('Zachary'), ig.Graph.Ring(10)]
+  >>> edges = [e for H in graphs for e in H.get_edgelist()]
+  >>> edge_offsets = [0, graphs[0].ecount(), len(edges)]
+  >>> node_offsets = [0, graphs[0].vcount(), graphs[0].vcount() + graphs[1].vcount()]
+  >>> membership = la.find_partitions_batch(edges, edge_offsets, node_offsets,
+  ...                                       la.ModularityVertexPartition)
+
+  """
+  if optimiser is None:
+    optimiser = Optimiser()
+    optimiser.max_comm_size = max_comm_size
+
+  if seed is None:
+    seed = random.getrandbits(31)
+
+  # Only the type and parameters of this partition are used
+  partition = partition_type(_ig.Graph(directed=directed), **kwargs)
+
+  membership = _c_leiden._Optimiser_find_partitions_batch(
+          optimiser._optimiser, partition._partition,
+          _as_packed(edges, 'q'), _as_packed(edge_offsets, 'q'), _as_packed(node_offsets, 'q'),
+          weights=None if weights is None else _as_packed(weights, 'd'),
+          n_iterations=n_iterations, seed=seed, n_threads=n_threads,
+          aggregate_order=optimiser.aggregate_order)
+
+  return _array('q', membership)
+
+def _as_packed(values, typecode):
+  """ Convert a sequence of values (or of pairs of values), an array or bytes
+  to the bytes of a flat array of ``typecode``. """
+  if isinstance(values, (bytes, bytearray)):
+    return bytes(values)
+  try:
+    view = memoryview(values)
+  except TypeError:
+    view = None
+  if view is not None and view.itemsize == 8 and view.format in (typecode, 'l' if typecode == 'q' else typecode):
+    return view.tobytes()
+  values = list(values)
+  try:
+    return _array(typecode, values).tobytes()
+  except TypeError:
+    return _array(typecode, chain.from_iterable(values)).tobytes()
+
+def graph_memory_usage(graph):
+  """ Estimated number of bytes held by the C++ graph of a partition on
+  ``graph``.
+
+  This is the part of
+  :func:`~VertexPartition.MutableVertexPartition.memory_usage` that is due to
+  the graph, which is shared by partitions created with
+  :func:`~VertexPartition.MutableVertexPartition.share_graph`. It can be
+  estimated before any partition is created, for example to decide how many
+  graphs fit in memory at the same time.
+
+  Parameters
+  ----------
+  graph : :class:`ig.Graph`
+    The graph.
+
+  Returns
+  -------
+  dict
+    The estimated number of bytes for the ``adjacency``, ``weights`` and
+    ``nodes`` of the graph, as for
+    :func:`~VertexPartition.MutableVertexPartition.memory_usage`, and their
+    ``total``. The edge weights are always stored, also for unweighted graphs.
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> usage = la.graph_memory_usage(G)
+  >>> usage['total'] > 0
+  True
+  """
+  return _c_leiden._graph_memory_usage(_get_py_capsule(graph))
+
+def _prepare_find_partition(graph, partition_type, initial_membership, weights, max_comm_size, seed, node_order, **kwargs):
+  """ Create the partition and optimiser for :func:`find_partition`. """
   if not weights is None:
     kwargs['weights'] = weights
-  partition = partition_type(graph,
-                             initial_membership=initial_membership,
-                             **kwargs)
+  if node_order is None:
+    partition = partition_type(graph,
+                               initial_membership=initial_membership,
+                               **kwargs)
+  else:
+    partition = partition_type.Reordered(graph, node_order,
+                                         initial_membership=initial_membership,
+                                         **kwargs)
   optimiser = Optimiser()
 
   optimiser.max_comm_size = max_comm_size
@@ -88,9 +307,7 @@ def find_partition(graph, partition_type, initial_membership=None, weights=None,
   if (not seed is None):
     optimiser.set_rng_seed(seed)
 
-  optimiser.optimise_partition(partition, n_iterations)
-
-  return partition
+  return partition, optimiser
 
 def find_partition_multiplex(graphs, partition_type, layer_weights=None, n_iterations=2, max_comm_size=0, seed=None, **kwargs):
   """ Detect communities for multiplex graphs.
@@ -194,6 +411,16 @@ def find_partition_temporal(graphs, partition_type,
   practice with a weight of 1). See :func:`time_slices_to_layers` for
   a more detailed explanation.
 
+  The layer of each slice only contains the nodes and edges of that slice,
+  with only the attributes required for the optimisation, and is passed to
+  :func:`Optimiser.optimise_partition_multiplex` with the nodes of the slice
+  as its ``layer_nodes``. Only the interslice layer contains the nodes of all
+  slices. The memory use and the cost of moving a node are hence
+  proportional to the size of the slices rather than to the number of slices
+  times the number of nodes of all slices. The optimiser then only considers
+  neighbouring communities, see ``layer_nodes`` in
+  :func:`Optimiser.optimise_partition_multiplex`.
+
   Parameters
   ----------
   graphs : list of :class:`ig.Graph`
@@ -206,14 +433,15 @@ def find_partition_temporal(graphs, partition_type,
     The weight of the coupling between two consecutive time slices.
 
   slice_attr : string
-    The vertex attribute to use for indicating the slice of a node.
+    Not used, the layers are no longer annotated with the slice of a node. Only
+    kept for backwards compatibility.
 
   vertex_id_attr : string
     The vertex to use to identify nodes.
 
   edge_type_attr : string
-    The edge attribute to use for indicating the type of link (`interslice` or
-    `intraslice`).
+    Not used, the layers are no longer annotated with the type of link. Only
+    kept for backwards compatibility.
 
   weight_attr : string
     The edge attribute used to indicate the weight.
@@ -262,19 +490,18 @@ def find_partition_temporal(graphs, partition_type,
   ...                                                      interslice_weight=1)
   """
   # Create layers
-  G_layers, G_interslice, G = time_slices_to_layers(graphs,
-                                                    interslice_weight,
-                                                    slice_attr=slice_attr,
-                                                    vertex_id_attr=vertex_id_attr,
-                                                    edge_type_attr=edge_type_attr,
-                                                    weight_attr=weight_attr)
+  G_layers, G_interslice = _temporal_layers(graphs,
+                                            interslice_weight,
+                                            vertex_id_attr=vertex_id_attr,
+                                            weight_attr=weight_attr,
+                                            lean=True)
   # Optimise partitions
   arg_dict = {}
   if 'node_sizes' in partition_type.__init__.__code__.co_varnames:
     arg_dict['node_sizes'] = 'node_size'
 
   if 'weights' in partition_type.__init__.__code__.co_varnames:
-    arg_dict['weights'] = 'weight'
+    arg_dict['weights'] = weight_attr
 
   arg_dict.update(kwargs)
 
@@ -294,17 +521,186 @@ def find_partition_temporal(graphs, partition_type,
   if (not seed is None):
     optimiser.set_rng_seed(seed)
 
-  improvement = optimiser.optimise_partition_multiplex(partitions + [partition_interslice], n_iterations=n_iterations)
+  # The nodes of the slices are numbered consecutively in the disjoint union,
+  # which the interslice layer contains in full.
+  vertex_offsets = [0]
+  for H in graphs:
+    vertex_offsets.append(vertex_offsets[-1] + H.vcount())
+  layer_nodes = [range(vertex_offsets[slice_idx], vertex_offsets[slice_idx + 1])
+                 for slice_idx in range(len(graphs))]
+
+  improvement = optimiser.optimise_partition_multiplex(partitions + [partition_interslice],
+                                                       n_iterations=n_iterations,
+                                                       layer_nodes=layer_nodes + [None])
 
   # Transform results back into original form.
-  membership = {(v[slice_attr], v[vertex_id_attr]): m for v, m in zip(G.vs, partitions[0].membership)}
+  membership = partition_interslice.membership
 
   membership_time_slices = []
-  for slice_idx, H in enumerate(graphs):
-    membership_slice = [membership[(slice_idx, v[vertex_id_attr])] for v in H.vs]
-    membership_time_slices.append(list(membership_slice))
+  offset = 0
+  for H in graphs:
+    membership_time_slices.append(membership[offset:offset + H.vcount()])
+    offset += H.vcount()
   return membership_time_slices, improvement
 
+def find_partition_temporal_update(previous_graph, previous_membership,
+                                   graph, partition_type,
+                                   interslice_weight=1,
+                                   vertex_id_attr='id', weight_attr='weight',
+                                   new_community_start=None,
+                                   n_iterations=2, max_comm_size=0, seed=None,
+                                   **kwargs):
+  """ Detect communities for a new time slice, given the previous slice.
+
+  This is an incremental version of :func:`find_partition_temporal`, for
+  when time slices arrive one by one. Only the new slice and its coupling to
+  the previous slice are optimised, while the membership of the nodes of the
+  previous slice is kept fixed (see ``is_membership_fixed`` in
+  :func:`Optimiser.optimise_partition_multiplex`). The cost of adding a slice
+  hence does not depend on the number of earlier slices.
+
+  Nodes in the previous and new slice are coupled if they have an identical
+  value of the ``vertex_id_attr``, with a weight of ``interslice_weight``.
+  Since the nodes of the previous slice are fixed, only their ids and
+  membership are used, not their edges. Communities of the new slice that
+  contain nodes of the previous slice keep the label of that community in
+  ``previous_membership``. Other communities are labelled consecutively,
+  starting from ``new_community_start``.
+
+  Parameters
+  ----------
+  previous_graph : :class:`ig.Graph`
+    The previous time slice.
+
+  previous_membership : list of int
+    Membership of the nodes of the previous time slice, for example as
+    returned from an earlier call to this function or
+    :func:`find_partition_temporal`.
+
+  graph : :class:`ig.Graph`
+    The new time slice.
+
+  partition_type : type of :class:`VertexPartition.MutableVertexPartition`
+    The type of partition to use for optimisation.
+
+  interslice_weight : float
+    The weight of the coupling between the two time slices.
+
+  vertex_id_attr : string
+    The vertex to use to identify nodes.
+
+  weight_attr : string
+    The edge attribute used to indicate the weight.
+
+  new_community_start : int
+    Label of the first community that does not contain any node of the
+    previous slice. By default, this is one more than the largest label in
+    ``previous_membership``.
+
+  n_iterations : int
+    Number of iterations to run the Leiden algorithm. By default, 2 iterations
+    are run. If the number of iterations is negative, the Leiden algorithm is
+    run until an iteration in which there was no improvement.
+
+  max_comm_size : non-negative int
+    Maximal total size of nodes in a community. If zero (the default), then
+    communities can be of any size.
+
+  seed : int
+    Seed for the random number generator. By default uses a random seed
+    if nothing is specified.
+
+  **kwargs
+    Remaining keyword arguments, passed on to constructor of
+    ``partition_type``.
+
+  Returns
+  -------
+  list of int
+    Membership of the nodes of the new slice.
+
+  float
+    Improvement in quality of combined partitions, see
+    :func:`Optimiser.optimise_partition_multiplex`.
+
+  See Also
+  --------
+  :func:`find_partition_temporal`
+
+  Examples
+  --------
+  >>> n = 100
+  >>> G_1 = ig.Graph.Lattice([n], 1)
+  >>> G_1.vs['id'] = range(n)
+  >>> G_2 = ig.Graph.Lattice([n], 1)
+  >>> G_2.vs['id'] = range(n)
+  >>> membership, improvement = la.find_partition_temporal([G_1],
+  ...                                                      la.ModularityVertexPartition)
+  >>> membership_2, improvement = la.find_partition_temporal_update(
+  ...   G_1, membership[0], G_2, la.ModularityVertexPartition)
+  """
+  previous_membership = list(previous_membership)
+  if len(previous_membership) != previous_graph.vcount():
+    raise ValueError("Previous membership does not have the same length as the number of nodes of the previous slice.")
+
+  # Only create a layer for the new slice, the previous slice is fixed and its
+  # layer would not contribute to any improvement.
+  G_layers, G_interslice = _temporal_layers([previous_graph, graph],
+                                            interslice_weight,
+                                            vertex_id_attr=vertex_id_attr,
+                                            weight_attr=weight_attr,
+                                            slice_layers=[1])
+
+  # Number the communities of the previous slice consecutively, followed by a
+  # singleton community for each node of the new slice.
+  n_previous = previous_graph.vcount()
+  previous_labels = sorted(set(previous_membership))
+  previous_label_idx = {c: i for i, c in enumerate(previous_labels)}
+  initial_membership = [previous_label_idx[c] for c in previous_membership] + \
+                       list(range(len(previous_labels), len(previous_labels) + graph.vcount()))
+
+  arg_dict = {}
+  if 'node_sizes' in partition_type.__init__.__code__.co_varnames:
+    arg_dict['node_sizes'] = 'node_size'
+
+  if 'weights' in partition_type.__init__.__code__.co_varnames:
+    arg_dict['weights'] = weight_attr
+
+  arg_dict.update(kwargs)
+  arg_dict['graph'] = G_layers[0]
+  arg_dict['initial_membership'] = initial_membership
+  partition = partition_type(**arg_dict)
+
+  partition_interslice = CPMVertexPartition(G_interslice, initial_membership,
+                                            resolution_parameter=0,
+                                            node_sizes='node_size', weights=weight_attr)
+  optimiser = Optimiser()
+
+  optimiser.max_comm_size = max_comm_size
+
+  if (not seed is None):
+    optimiser.set_rng_seed(seed)
+
+  improvement = optimiser.optimise_partition_multiplex(
+    [partition, partition_interslice],
+    n_iterations=n_iterations,
+    fixed_nodes=range(n_previous))
+
+  # Transform results back into the labels of the previous slice. The
+  # communities of fixed nodes keep their (consecutive) labels.
+  if new_community_start is None:
+    new_community_start = max(previous_labels) + 1 if previous_labels else 0
+  new_labels = {}
+  membership = []
+  for c in partition.membership[n_previous:]:
+    if c < len(previous_labels):
+      membership.append(previous_labels[c])
+    else:
+      if not c in new_labels:
+        new_labels[c] = new_community_start + len(new_labels)
+      membership.append(new_labels[c])
+  return membership, improvement
+
 #%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 # These are helper functions to create a proper
 # disjoint union in python. The igraph implementation
@@ -319,18 +715,110 @@ def get_attrs_or_nones(seq, attr_name):
 def disjoint_union_attrs(graphs):
   G = _ig.Graph.disjoint_union(graphs[0], graphs[1:])
 
-  vertex_attributes = set(sum([H.vertex_attributes() for H in graphs], []))
-  edge_attributes = set(sum([H.edge_attributes() for H in graphs], []))
+  vertex_attributes = set(chain.from_iterable(H.vertex_attributes() for H in graphs))
+  edge_attributes = set(chain.from_iterable(H.edge_attributes() for H in graphs))
 
   for attr in vertex_attributes:
-    attr_value = sum([get_attrs_or_nones(H.vs, attr) for H in graphs], [])
+    attr_value = list(chain.from_iterable(get_attrs_or_nones(H.vs, attr) for H in graphs))
     G.vs[attr] = attr_value
   for attr in edge_attributes:
-    attr_value = sum([get_attrs_or_nones(H.es, attr) for H in graphs], [])
+    attr_value = list(chain.from_iterable(get_attrs_or_nones(H.es, attr) for H in graphs))
     G.es[attr] = attr_value
 
   return G
 
+# Each edge is a packed pair of int64 nodes.
+_EDGE_NBYTES = 2*_array('q').itemsize
+
+def _edge_view(edges):
+  """ View packed int64 pairs of nodes as the array of edges taken by igraph,
+  without creating a tuple per edge. """
+  if not edges:
+    return []
+  return memoryview(edges).cast('q', [len(edges)//_EDGE_NBYTES, 2])
+
+def _native_temporal_layers(slices, coupling, vertex_id_attr, layers=(), lean=False):
+  """ Create the edges of the layers of the given slices and join the ids of
+  the nodes of each pair of coupled slices (natively, using a hash join).
+
+  Returns for each layer the packed int64 pairs of nodes of its edges, and
+  for each pair of coupled slices the packed int64 pairs of nodes to couple.
+  The nodes are numbered as in the disjoint union of the slices, except for
+  the layers if ``lean`` is True, whose nodes are numbered within their
+  slice. """
+  slice_ids = _slice_id_codes(slices, vertex_id_attr)
+  try:
+    return _c_leiden._temporal_layers([_get_py_capsule(H) for H in slices],
+                                      slice_ids, coupling, list(layers), lean)
+  except ValueError:
+    for slice_idx in sorted(set(chain.from_iterable(coupling))):
+      nodes = slices[slice_idx].vs[vertex_id_attr]
+      err = '\n'.join(
+        ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes).items() if count > 1]
+        )
+      if err:
+        raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(slice_idx, err))
+    raise
+
+def _temporal_layers(graphs, interslice_weight, vertex_id_attr, weight_attr, slice_layers=None, lean=False):
+  """ Create the layers for :func:`find_partition_temporal`.
+
+  This results in the same layers as :func:`time_slices_to_layers`, but each
+  layer only contains the edges of its own slice and the ``node_size`` and
+  ``weight_attr`` attributes, without copying any other attributes of the
+  disjoint union to every layer. No disjoint union is created, and the slices
+  themselves are not modified. If ``slice_layers`` is specified, layers are
+  only created for those slices. If ``lean`` is True, the layer of a slice
+  only contains the nodes of that slice, in the same order. The edges are
+  created natively, see :func:`_native_temporal_layers`. """
+  for H in graphs:
+    if not vertex_id_attr in H.vertex_attributes():
+      raise ValueError("Could not find the vertex attribute {0} to identify nodes in different slices.".format(vertex_id_attr ))
+
+  vertex_offsets = [0]
+  for H in graphs:
+    vertex_offsets.append(vertex_offsets[-1] + H.vcount())
+  n = vertex_offsets[-1]
+
+  if slice_layers is None:
+    slice_layers = range(len(graphs))
+
+  coupling = [(slice_idx, slice_idx + 1) for slice_idx in range(len(graphs) - 1)]
+  layer_edges, interslice_edges = _native_temporal_layers(graphs, coupling, vertex_id_attr,
+                                                          slice_layers, lean)
+
+  G_layers = []
+  for slice_idx, edges in zip(slice_layers, layer_edges):
+    H = graphs[slice_idx]
+    offset = vertex_offsets[slice_idx]
+    H_layer = _ig.Graph(n=H.vcount() if lean else n, edges=_edge_view(edges), directed=H.is_directed())
+    if weight_attr in H.edge_attributes():
+      H_layer.es[weight_attr] = H.es[weight_attr]
+    else:
+      H_layer.es[weight_attr] = 1
+    if lean:
+      H_layer.vs['node_size'] = 1
+    else:
+      H_layer.vs['node_size'] = [0]*offset + [1]*H.vcount() + [0]*(n - offset - H.vcount())
+    G_layers.append(H_layer)
+
+  G_interslice = _ig.Graph(n=n, edges=_edge_view(b''.join(interslice_edges)), directed=graphs[0].is_directed())
+  G_interslice.es[weight_attr] = 1 if interslice_weight is None else interslice_weight
+  G_interslice.vs['node_size'] = 0
+
+  return G_layers, G_interslice
+
+def _slice_id_codes(graphs, vertex_id_attr):
+  """ Encode the ids of the nodes of each slice as packed int64 arrays, such
+  that identical ids are encoded identically across slices. Integer ids are
+  used as is, other ids are numbered in order of appearance. """
+  ids = [H.vs[vertex_id_attr] for H in graphs]
+  try:
+    return [_array('q', H_ids).tobytes() for H_ids in ids]
+  except (TypeError, OverflowError):
+    codes = _ig.UniqueIdGenerator()
+    return [_array('q', [codes[v] for v in H_ids]).tobytes() for H_ids in ids]
+
 #%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 # Conversion to layer graphs
 
@@ -398,7 +886,8 @@ def slices_to_layers(G_coupling,
 
   vertex_id_attr : string
     The vertex attribute which is used to identify whether two nodes in two
-    slices represent the same node, and hence, should be coupled.
+    slices represent the same node, and hence, should be coupled. Nodes are
+    joined most efficiently if the ids are integers.
 
   edge_type_attr : string
     The edge attribute to use for indicating the type of link (``interslice``
@@ -474,55 +963,81 @@ def slices_to_layers(G_coupling,
   if not weight_attr in G_coupling.edge_attributes():
     raise ValueError("Could not find the edge attribute {0} in the coupling graph.".format(weight_attr))
 
-  # Create disjoint union of the time graphs
-  for v_slice in G_coupling.vs:
-    H = v_slice[slice_attr]
-    H.vs[slice_attr] = v_slice.index
+  slices = G_coupling.vs[slice_attr]
+  for slice_idx, H in enumerate(slices):
+    H.vs[slice_attr] = slice_idx
     if not vertex_id_attr in H.vertex_attributes():
       raise ValueError("Could not find the vertex attribute {0} to identify nodes in different slices.".format(vertex_id_attr ))
     if not weight_attr in H.edge_attributes():
       H.es[weight_attr] = 1
 
-  G = disjoint_union_attrs(G_coupling.vs[slice_attr])
-  G.es[edge_type_attr] = 'intraslice'
-
-  for v_slice in G_coupling.vs:
-    for u_slice in v_slice.neighbors(mode=_ig.OUT):
-      if v_slice.index < u_slice.index or G_coupling.is_directed():
-        nodes_v = G.vs.select(lambda v: v[slice_attr]==v_slice.index)[vertex_id_attr]
-        if len(set(nodes_v)) != len(nodes_v):
-          err = '\n'.join(
-            ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes_v).items() if count > 1]
-            )
-          raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(v_slice.index, err))
-        nodes_u = G.vs.select(lambda v: v[slice_attr]==u_slice.index)[vertex_id_attr]
-        if len(set(nodes_u)) != len(nodes_u):
-          err = '\n'.join(
-            ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes_u).items() if count > 1]
-            )
-          raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(u_slice.index, err))
-        common_nodes = set(nodes_v).intersection(set(nodes_u))
-        nodes_v = sorted([v for v in G.vs if v[slice_attr] == v_slice.index and v[vertex_id_attr] in common_nodes], key=lambda v: v[vertex_id_attr])
-        nodes_u = sorted([v for v in G.vs if v[slice_attr] == u_slice.index and v[vertex_id_attr] in common_nodes], key=lambda v: v[vertex_id_attr])
-        edges = zip(nodes_v, nodes_u)
-        e_start = G.ecount()
-        G.add_edges(edges)
-        e_end = G.ecount()
-        e_idx = range(e_start, e_end)
-        interslice_weight = G_coupling.es[G_coupling.get_eid(v_slice, u_slice)][weight_attr]
-        if not interslice_weight is None:
-          G.es[e_idx][weight_attr] = interslice_weight
-        G.es[e_idx][edge_type_attr] = 'interslice'
-
-  # Convert aggregate graph to individual layers for each time slice.
-  G_layers = [None]*G_coupling.vcount()
-  for v_slice in G_coupling.vs:
-    H = G.subgraph_edges(G.es.select(_within=[v.index for v in G.vs if v[slice_attr] == v_slice.index]), delete_vertices=False)
-    H.vs['node_size'] = [1 if v[slice_attr] == v_slice.index else 0 for v in H.vs]
-    G_layers[v_slice.index] = H
-
-  # Create one graph for the interslice links.
-  G_interslice = G.subgraph_edges(G.es.select(type_eq='interslice'), delete_vertices=False)
+  # The nodes and intraslice edges of each slice occupy a contiguous range in
+  # the disjoint union.
+  vertex_offsets = [0]
+  edge_offsets = [0]
+  for H in slices:
+    vertex_offsets.append(vertex_offsets[-1] + H.vcount())
+    edge_offsets.append(edge_offsets[-1] + H.ecount())
+  n = vertex_offsets[-1]
+  directed = slices[0].is_directed() if slices else False
+
+  # Pairs of slices to couple, with the weight of their coupling.
+  coupling = []
+  coupling_weights = []
+  for e in G_coupling.es:
+    v_slice, u_slice = e.tuple
+    if not G_coupling.is_directed():
+      if v_slice == u_slice:
+        continue
+      v_slice, u_slice = min(v_slice, u_slice), max(v_slice, u_slice)
+    coupling.append((v_slice, u_slice))
+    coupling_weights.append(e[weight_attr])
+
+  # The edges of the layers and the interslice edges are created natively,
+  # numbered as in the disjoint union of the slices.
+  layer_edges, coupling_edges = _native_temporal_layers(slices, coupling, vertex_id_attr,
+                                                        range(len(slices)))
+  interslice_edges = b''.join(coupling_edges)
+  m_interslice = len(interslice_edges)//_EDGE_NBYTES
+  interslice_weights = []
+  for edges, interslice_weight in zip(coupling_edges, coupling_weights):
+    interslice_weights.extend([interslice_weight]*(len(edges)//_EDGE_NBYTES))
+
+  # The attributes of the nodes of all slices, and of their edges, where a
+  # slice without an attribute has None.
+  vertex_attrs = {}
+  for attr in set(chain.from_iterable(H.vertex_attributes() for H in slices)):
+    vertex_attrs[attr] = list(chain.from_iterable(get_attrs_or_nones(H.vs, attr) for H in slices))
+  edge_attributes = set(chain.from_iterable(H.edge_attributes() for H in slices))
+
+  # Create one graph for each slice and one for the interslice links, all on
+  # the nodes of the disjoint union.
+  G_layers = [None]*len(slices)
+  for slice_idx, (H, edges) in enumerate(zip(slices, layer_edges)):
+    edge_attrs = {attr: get_attrs_or_nones(H.es, attr) for attr in edge_attributes}
+    edge_attrs[edge_type_attr] = ['intraslice']*H.ecount()
+    H_layer = _ig.Graph(n=n, edges=_edge_view(edges), directed=directed,
+                        vertex_attrs=vertex_attrs, edge_attrs=edge_attrs)
+    H_layer.vs['node_size'] = [0]*vertex_offsets[slice_idx] + \
+                              [1]*H.vcount() + \
+                              [0]*(n - vertex_offsets[slice_idx + 1])
+    G_layers[slice_idx] = H_layer
+
+  edge_attrs = {attr: [None]*m_interslice for attr in edge_attributes}
+  edge_attrs[weight_attr] = interslice_weights
+  edge_attrs[edge_type_attr] = ['interslice']*m_interslice
+  G_interslice = _ig.Graph(n=n, edges=_edge_view(interslice_edges), directed=directed,
+                           vertex_attrs=vertex_attrs, edge_attrs=edge_attrs)
   G_interslice.vs['node_size'] = 0
 
+  # The complete graph contains the intraslice edges of all slices, followed by
+  # the interslice edges.
+  edge_attrs = {}
+  for attr in edge_attributes:
+    edge_attrs[attr] = list(chain.from_iterable(get_attrs_or_nones(H.es, attr) for H in slices)) + \
+                       G_interslice.es[attr]
+  edge_attrs[edge_type_attr] = ['intraslice']*edge_offsets[-1] + ['interslice']*m_interslice
+  G = _ig.Graph(n=n, edges=_edge_view(b''.join(layer_edges) + interslice_edges), directed=directed,
+                vertex_attrs=vertex_attrs, edge_attrs=edge_attrs)
+
   return G_layers, G_interslice, G
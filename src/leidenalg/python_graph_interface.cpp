@@ -0,0 +1,463 @@
+#include "python_graph_interface.h"
+
+py_snapshot_t::py_snapshot_t(PyObject* py_sequence)
+{
+  py_tuple = PySequence_Tuple(py_sequence);
+  n = (py_tuple != NULL) ? (size_t)PyTuple_Size(py_tuple) : 0;
+}
+
+py_snapshot_t::~py_snapshot_t()
+{
+  Py_XDECREF(py_tuple);
+}
+
+/****************************************************************************
+  Index the (integer coded) ids of the nodes of a slice, mapping each id to the
+  index of the node in the disjoint union of all slices (i.e. offset by the
+  number of nodes in all preceding slices). Returns false if the ids are not
+  unique.
+*****************************************************************************/
+bool index_slice_ids(const int64_t* ids, size_t n, size_t offset, unordered_map<int64_t, size_t>& index)
+{
+  index.clear();
+  index.reserve(n);
+  for (size_t v = 0; v < n; v++)
+  {
+    if (!index.emplace(ids[v], offset + v).second)
+      return false;
+  }
+  return true;
+}
+
+/****************************************************************************
+  Hash join of the ids of slice u against the index of slice v. For each node
+  of u whose id also occurs in v, the pair of nodes (v, u) is appended to
+  edges, in the order of the nodes in slice u.
+*****************************************************************************/
+void join_slice_ids(unordered_map<int64_t, size_t> const& index_v, const int64_t* ids_u, size_t n_u, size_t offset_u, vector<int64_t>& edges)
+{
+  for (size_t u = 0; u < n_u; u++)
+  {
+    unordered_map<int64_t, size_t>::const_iterator it = index_v.find(ids_u[u]);
+    if (it != index_v.end())
+    {
+      edges.push_back(it->second);
+      edges.push_back(offset_u + u);
+    }
+  }
+}
+
+/****************************************************************************
+  Order of the nodes for laying out a graph in memory, such that nodes that
+  are adjacent tend to be close in the order. The order lists the nodes by
+  their new index.
+
+    bfs     Breadth-first search, starting each component at its first node.
+    rcm     Reverse Cuthill-McKee, i.e. a breadth-first search starting each
+            component at a node of minimum degree and visiting neighbours by
+            increasing degree, after which the order is reversed.
+    degree  By decreasing degree, so that the hubs share the first pages.
+
+  The order and the scratch space may be kept by the caller, so that repeated
+  calls, such as for each aggregation level, do not allocate.
+*****************************************************************************/
+void node_order(Graph* graph, string const& method, vector<size_t>& order, node_order_scratch_t& scratch)
+{
+  size_t n = graph->vcount();
+  bool rcm = (method == "rcm");
+  if (!rcm && method != "bfs" && method != "degree")
+    throw Exception("Unknown node order, should be 'bfs', 'rcm' or 'degree'.");
+
+  // Only the rcm and degree orders need the degrees
+  vector<size_t>& degree = scratch.degree;
+  if (method != "bfs")
+  {
+    degree.resize(n);
+    for (size_t v = 0; v < n; v++)
+      degree[v] = graph->degree(v, IGRAPH_ALL);
+  }
+  auto by_degree = [&degree](size_t v, size_t u) { return degree[v] < degree[u]; };
+
+  if (method == "degree")
+  {
+    order = range(n);
+    std::stable_sort(order.begin(), order.end(),
+                     [&degree](size_t v, size_t u) { return degree[v] > degree[u]; });
+    return;
+  }
+
+  vector<size_t>& start = scratch.start;
+  if (rcm)
+  {
+    start = range(n);
+    std::stable_sort(start.begin(), start.end(), by_degree);
+  }
+
+  order.clear();
+  order.reserve(n);
+  vector<bool>& visited = scratch.visited;
+  visited.assign(n, false);
+  vector<size_t>& sorted_neighbours = scratch.neighbours;
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t s = rcm ? start[i] : i;
+    if (visited[s])
+      continue;
+    visited[s] = true;
+    size_t head = order.size();
+    order.push_back(s);
+    while (head < order.size())
+    {
+      size_t v = order[head++];
+      vector<size_t> const* neighbours = &graph->get_neighbours(v, IGRAPH_ALL);
+      if (rcm)
+      {
+        sorted_neighbours.assign(neighbours->begin(), neighbours->end());
+        std::stable_sort(sorted_neighbours.begin(), sorted_neighbours.end(), by_degree);
+        neighbours = &sorted_neighbours;
+      }
+      for (size_t u : *neighbours)
+      {
+        if (!visited[u])
+        {
+          visited[u] = true;
+          order.push_back(u);
+        }
+      }
+    }
+  }
+
+  if (rcm)
+    std::reverse(order.begin(), order.end());
+}
+
+vector<size_t> node_order(Graph* graph, string const& method)
+{
+  vector<size_t> order;
+  node_order_scratch_t scratch;
+  node_order(graph, method, order, scratch);
+  return order;
+}
+
+/****************************************************************************
+  Estimated memory of a Graph of n nodes and m edges, together with its
+  underlying igraph graph. This is based on the sizes of the main arrays, and
+  ignores allocator overhead.
+*****************************************************************************/
+memory_usage_t estimate_graph_memory_usage(size_t n, size_t m)
+{
+  memory_usage_t usage;
+  // igraph stores from, to and two edge orderings, and two index arrays
+  usage.adjacency = (4*m + 2*(n + 1))*sizeof(igraph_integer_t);
+  usage.weights = m*sizeof(double);
+  // Node sizes, self weights, in and out strength, and degrees
+  usage.nodes = n*(4*sizeof(double) + 3*sizeof(size_t));
+  return usage;
+}
+
+PyObject* memory_usage_to_py(memory_usage_t const& usage, bool with_partition)
+{
+  PyObject* py_usage = PyDict_New();
+  const char* keys[] = {"adjacency", "weights", "nodes", "total",
+                        "membership", "communities", "community_caches",
+                        "aggregation"};
+  size_t values[] = {usage.adjacency, usage.weights, usage.nodes, usage.total(),
+                     usage.membership, usage.communities, usage.community_caches,
+                     usage.aggregation};
+  // A graph on its own only has the first parts.
+  size_t nb_values = with_partition ? sizeof(values)/sizeof(values[0]) : 4;
+  for (size_t i = 0; i < nb_values; i++)
+  {
+    PyObject* py_value = PyLong_FromSize_t(values[i]);
+    PyDict_SetItemString(py_usage, keys[i], py_value);
+    Py_DECREF(py_value);
+  }
+  return py_usage;
+}
+
+/****************************************************************************
+  Join the ids of each pair of coupled slices (v, u) with a hash join. The
+  pairs of nodes to couple are appended to edges, one list per pair, with
+  the nodes numbered as in the disjoint union of the slices. Only a single
+  index is kept at any time, which is reused as long as consecutive pairs
+  share the same first slice (e.g. a star coupling). Slices that are only
+  ever joined against are checked separately for unique ids afterwards.
+  Returns false if the ids of a slice are not unique, with that slice in
+  failed_slice.
+*****************************************************************************/
+bool join_coupled_slices(vector<const int64_t*> const& ids, vector<size_t> const& n, vector<size_t> const& offset,
+                         vector< std::pair<size_t, size_t> > const& coupling,
+                         vector< vector<int64_t> >& edges, size_t* failed_slice)
+{
+  size_t nb_slices = ids.size();
+  size_t nb_coupling = coupling.size();
+  edges.assign(nb_coupling, vector<int64_t>());
+  vector<bool> checked(nb_slices, false);
+  unordered_map<int64_t, size_t> index;
+  size_t indexed = nb_slices;
+  for (size_t c = 0; c < nb_coupling; c++)
+  {
+    size_t v = coupling[c].first, u = coupling[c].second;
+    if (indexed != v)
+    {
+      if (!index_slice_ids(ids[v], n[v], offset[v], index))
+      {
+        *failed_slice = v;
+        return false;
+      }
+      indexed = v;
+      checked[v] = true;
+    }
+    join_slice_ids(index, ids[u], n[u], offset[u], edges[c]);
+  }
+
+  for (size_t c = 0; c < nb_coupling; c++)
+  {
+    size_t u = coupling[c].second;
+    if (!checked[u])
+    {
+      if (!index_slice_ids(ids[u], n[u], offset[u], index))
+      {
+        *failed_slice = u;
+        return false;
+      }
+      checked[u] = true;
+    }
+  }
+  return true;
+}
+
+/****************************************************************************
+  Edges of a slice as int64 pairs of nodes, offset by the number of nodes in
+  all preceding slices, or numbered within the slice for an offset of zero.
+*****************************************************************************/
+void slice_edges(igraph_t* graph, size_t offset, vector<int64_t>& edges)
+{
+  igraph_integer_t m = igraph_ecount(graph);
+  edges.resize(2*m);
+  for (igraph_integer_t e = 0; e < m; e++)
+  {
+    igraph_integer_t from, to;
+    igraph_edge(graph, e, &from, &to);
+    edges[2*e] = offset + from;
+    edges[2*e + 1] = offset + to;
+  }
+}
+
+PyObject* packed_int64_list(vector< vector<int64_t> > const& values)
+{
+  PyObject* py_list = PyList_New(values.size());
+  if (py_list == NULL)
+    return NULL;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    PyObject* py_values = PyBytes_FromStringAndSize((const char*)values[i].data(), values[i].size()*sizeof(int64_t));
+    if (py_values == NULL)
+    {
+      Py_DECREF(py_list);
+      return NULL;
+    }
+    PyList_SetItem(py_list, i, py_values);
+  }
+  return py_list;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  PyObject* _temporal_layers(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_slices = NULL;
+    PyObject* py_slice_ids = NULL;
+    PyObject* py_coupling = NULL;
+    PyObject* py_layers = NULL;
+    int lean = false;
+
+    static const char* kwlist[] = {"slices", "slice_ids", "coupling", "layers", "lean", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOO|p", (char**) kwlist,
+                                     &py_slices, &py_slice_ids, &py_coupling, &py_layers, &lean))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "temporal_layers();" << endl;
+    #endif
+
+    // The slices are passed as capsules of their igraph graphs, and the ids of
+    // each slice as packed int64 arrays. The nodes of the slices are numbered
+    // consecutively in the disjoint union.
+    py_snapshot_t py_slice_items(py_slices);
+    py_snapshot_t py_slice_id_items(py_slice_ids);
+    py_snapshot_t py_coupling_items(py_coupling);
+    py_snapshot_t py_layer_items(py_layers);
+    if (py_slice_items.py_tuple == NULL || py_slice_id_items.py_tuple == NULL ||
+        py_coupling_items.py_tuple == NULL || py_layer_items.py_tuple == NULL)
+      return NULL;
+    size_t nb_slices = py_slice_items.size();
+    if (py_slice_id_items.size() != nb_slices)
+    {
+      PyErr_SetString(PyExc_ValueError, "Expected the ids of each slice.");
+      return NULL;
+    }
+    vector<igraph_t*> graphs(nb_slices);
+    vector<const int64_t*> ids(nb_slices);
+    vector<size_t> n(nb_slices);
+    vector<size_t> offset(nb_slices);
+    size_t total_n = 0;
+    for (size_t s = 0; s < nb_slices; s++)
+    {
+      graphs[s] = (igraph_t*) PyCapsule_GetPointer(py_slice_items[s], NULL);
+      if (graphs[s] == NULL)
+        return NULL;
+      PyObject* py_ids = py_slice_id_items[s];
+      if (!PyBytes_Check(py_ids))
+      {
+        PyErr_SetString(PyExc_TypeError, "Expected packed int64 ids for each slice.");
+        return NULL;
+      }
+      ids[s] = (const int64_t*)PyBytes_AsString(py_ids);
+      n[s] = PyBytes_Size(py_ids) / sizeof(int64_t);
+      if (n[s] != (size_t)igraph_vcount(graphs[s]))
+      {
+        PyErr_Format(PyExc_ValueError, "Number of ids of slice %zu does not equal its number of nodes.", s);
+        return NULL;
+      }
+      offset[s] = total_n;
+      total_n += n[s];
+    }
+
+    size_t nb_coupling = py_coupling_items.size();
+    vector< std::pair<size_t, size_t> > coupling(nb_coupling);
+    for (size_t c = 0; c < nb_coupling; c++)
+    {
+      Py_ssize_t v, u;
+      if (!PyArg_ParseTuple(py_coupling_items[c], "nn", &v, &u))
+        return NULL;
+      if (v < 0 || u < 0 || (size_t)v >= nb_slices || (size_t)u >= nb_slices)
+      {
+        PyErr_SetString(PyExc_ValueError, "Slice index out of range.");
+        return NULL;
+      }
+      coupling[c] = std::make_pair((size_t)v, (size_t)u);
+    }
+
+    size_t nb_layers = py_layer_items.size();
+    vector<size_t> layers(nb_layers);
+    for (size_t l = 0; l < nb_layers; l++)
+    {
+      size_t s = PyLong_AsSize_t(py_layer_items[l]);
+      if (PyErr_Occurred())
+        return NULL;
+      if (s >= nb_slices)
+      {
+        PyErr_SetString(PyExc_ValueError, "Slice index out of range.");
+        return NULL;
+      }
+      layers[l] = s;
+    }
+
+    #ifdef DEBUG
+      cerr << "Creating " << nb_layers << " layers and joining " << nb_coupling << " pairs of slices with " << total_n << " nodes in total." << endl;
+    #endif
+
+    // The edges of each layer, numbered within the slice for lean layers and
+    // as in the disjoint union otherwise, and the interslice edges of each
+    // pair of coupled slices.
+    vector< vector<int64_t> > layer_edges(nb_layers);
+    for (size_t l = 0; l < nb_layers; l++)
+      slice_edges(graphs[layers[l]], lean ? 0 : offset[layers[l]], layer_edges[l]);
+
+    vector< vector<int64_t> > interslice_edges;
+    size_t failed_slice = 0;
+    if (!join_coupled_slices(ids, n, offset, coupling, interslice_edges, &failed_slice))
+    {
+      PyErr_Format(PyExc_ValueError, "No unique IDs for slice %zu.", failed_slice);
+      return NULL;
+    }
+
+    PyObject* py_layer_edges = packed_int64_list(layer_edges);
+    if (py_layer_edges == NULL)
+      return NULL;
+    PyObject* py_interslice_edges = packed_int64_list(interslice_edges);
+    if (py_interslice_edges == NULL)
+    {
+      Py_DECREF(py_layer_edges);
+      return NULL;
+    }
+    return Py_BuildValue("NN", py_layer_edges, py_interslice_edges);
+  }
+
+  PyObject* _node_order(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+    char* method = NULL;
+
+    static const char* kwlist[] = {"graph", "method", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Os", (char**) kwlist,
+                                     &py_obj_graph, &method))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "node_order(" << method << ");" << endl;
+    #endif
+
+    igraph_t* py_graph = (igraph_t*) PyCapsule_GetPointer(py_obj_graph, NULL);
+    if (py_graph == NULL)
+      return NULL;
+
+    vector<int64_t> order;
+    try
+    {
+      Graph graph(py_graph);
+      vector<size_t> nodes = node_order(&graph, string(method));
+      order.assign(nodes.begin(), nodes.end());
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    return PyBytes_FromStringAndSize((const char*)order.data(), order.size()*sizeof(int64_t));
+  }
+
+  PyObject* _graph_memory_usage(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+
+    static const char* kwlist[] = {"graph", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_obj_graph))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "graph_memory_usage();" << endl;
+    #endif
+
+    igraph_t* py_graph = (igraph_t*) PyCapsule_GetPointer(py_obj_graph, NULL);
+    if (py_graph == NULL)
+      return NULL;
+
+    memory_usage_t usage = estimate_graph_memory_usage(igraph_vcount(py_graph), igraph_ecount(py_graph));
+    return memory_usage_to_py(usage, false);
+  }
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,57 +3,2226 @@
   PyObject* capsule_Optimiser(Optimiser* optimiser)
   {
     PyObject* py_optimiser = PyCapsule_New(optimiser, "leidenalg.Optimiser", del_Optimiser);
+    if (py_optimiser != NULL && PyCapsule_SetContext(py_optimiser, new optimiser_workspace_t()) != 0)
+    {
+      Py_DECREF(py_optimiser);
+      return NULL;
+    }
+    return py_optimiser;
+  }
+
+  Optimiser* decapsule_Optimiser(PyObject* py_optimiser)
+  {
+    Optimiser* optimiser = (Optimiser*) PyCapsule_GetPointer(py_optimiser, "leidenalg.Optimiser");
+    return optimiser;
+  }
+
+  optimiser_workspace_t* decapsule_Optimiser_workspace(PyObject* py_optimiser)
+  {
+    optimiser_workspace_t* workspace = (optimiser_workspace_t*) PyCapsule_GetContext(py_optimiser);
+    return workspace;
+  }
+
+  void del_Optimiser(PyObject* py_optimiser)
+  {
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    delete workspace;
+    delete optimiser;
+  }
+
+  vector<bool> create_is_membership_fixed(PyObject* py_is_membership_fixed, PyObject* py_fixed_nodes, size_t n)
+  {
+    vector<bool> is_membership_fixed(n, false);
+    if (py_is_membership_fixed != NULL && py_is_membership_fixed != Py_None)
+    {
+      #ifdef DEBUG
+        cerr << "Reading is_membership_fixed." << endl;
+      #endif
+
+      if (PyBytes_Check(py_is_membership_fixed) || PyByteArray_Check(py_is_membership_fixed))
+      {
+        // Packed bitset, with node v at bit (v % 8) of byte (v / 8), i.e. the
+        // little bit order of numpy.packbits(..., bitorder='little').
+        const char* bits = NULL;
+        size_t nb_bytes = 0;
+        if (PyBytes_Check(py_is_membership_fixed))
+        {
+          bits = PyBytes_AsString(py_is_membership_fixed);
+          nb_bytes = PyBytes_Size(py_is_membership_fixed);
+        }
+        else
+        {
+          bits = PyByteArray_AsString(py_is_membership_fixed);
+          nb_bytes = PyByteArray_Size(py_is_membership_fixed);
+        }
+
+        if (nb_bytes != (n + 7)/8)
+          throw Exception("Membership fixed bitset not the same size as the number of nodes.");
+
+        for (size_t i = 0; i < nb_bytes; i++)
+        {
+          unsigned char byte = (unsigned char)bits[i];
+          // Most bytes are zero when only few nodes are fixed
+          if (byte == 0)
+            continue;
+          for (size_t b = 0; b < 8; b++)
+          {
+            size_t v = 8*i + b;
+            if (v < n && ((byte >> b) & 1))
+              is_membership_fixed[v] = true;
+          }
+        }
+      }
+      else
+      {
+        py_snapshot_t py_items(py_is_membership_fixed);
+        if (py_items.py_tuple == NULL)
+        {
+          PyErr_Clear();
+          throw Exception("Expected a list for the membership fixed vector.");
+        }
+        size_t nb_is_membership_fixed = py_items.size();
+        if (nb_is_membership_fixed != n)
+          throw Exception("Membership fixed vector not the same size as the number of nodes.");
+
+        for (size_t v = 0; v < n; v++)
+        {
+          PyObject* py_item = py_items[v];
+          is_membership_fixed[v] = PyObject_IsTrue(py_item);
+        }
+      }
+    }
+
+    if (py_fixed_nodes != NULL && py_fixed_nodes != Py_None)
+    {
+      #ifdef DEBUG
+        cerr << "Reading fixed_nodes." << endl;
+      #endif
+
+      py_snapshot_t py_items(py_fixed_nodes);
+      if (py_items.py_tuple == NULL)
+      {
+        PyErr_Clear();
+        throw Exception("Expected a list of fixed nodes.");
+      }
+      size_t nb_fixed_nodes = py_items.size();
+      for (size_t i = 0; i < nb_fixed_nodes; i++)
+      {
+        PyObject* py_item = py_items[i];
+        size_t v = PyLong_AsSize_t(py_item);
+        if (PyErr_Occurred())
+        {
+          PyErr_Clear();
+          throw Exception("Expected non-negative integer values for fixed nodes.");
+        }
+        if (v >= n)
+          throw Exception("Fixed node cannot exceed number of nodes.");
+        is_membership_fixed[v] = true;
+      }
+    }
+
+    return is_membership_fixed;
+  }
+
+  void copy_optimiser_settings(Optimiser* source, Optimiser* target)
+  {
+    target->consider_comms = source->consider_comms;
+    target->refine_partition = source->refine_partition;
+    target->refine_consider_comms = source->refine_consider_comms;
+    target->optimise_routine = source->optimise_routine;
+    target->refine_routine = source->refine_routine;
+    target->consider_empty_community = source->consider_empty_community;
+    target->min_comm_size = source->min_comm_size;
+    target->max_comm_size = source->max_comm_size;
+    target->community_constraint_enforcement = source->community_constraint_enforcement;
+  }
+
+  // Also copy the settings of the binding, for optimisers that run with a
+  // workspace of their own, such as those of the runs of consensus_partition.
+  void copy_optimiser_settings(Optimiser* source, Optimiser* target,
+                               optimiser_workspace_t const* source_workspace, optimiser_workspace_t* target_workspace)
+  {
+    copy_optimiser_settings(source, target);
+    target_workspace->pruned_all_comms = source_workspace->pruned_all_comms;
+    target_workspace->fused_moves = source_workspace->fused_moves;
+    target_workspace->candidate_index = source_workspace->candidate_index;
+    target_workspace->candidate_limit = source_workspace->candidate_limit;
+  }
+
+  /****************************************************************************
+    Whether an optimisation needs the driver of the binding, i.e. whether any
+    of its features is used: a time budget, a progress callback, an aggregate
+    order, PRUNED_ALL_COMMS, fused moves or the levels. Otherwise the
+    optimisation is left to libleidenalg, so that the default algorithm is
+    exactly that of the C++ library.
+  *****************************************************************************/
+  bool uses_optimise_driver(optimiser_workspace_t const* workspace, int aggregate_order, bool return_levels)
+  {
+    return workspace->has_deadline || workspace->progress_callback != NULL ||
+           aggregate_order != AGGREGATE_ORDER_NONE || workspace->pruned_all_comms ||
+           workspace->fused_moves || return_levels;
+  }
+
+  /****************************************************************************
+    Run one iteration of the Leiden algorithm on the partitions, with the
+    driver of the binding if uses_optimise_driver, and with
+    Optimiser::optimise_partition of libleidenalg otherwise. The latter cannot
+    be stopped while it runs, so a request to cancel or a signal is only taken
+    into account once it is done, and its peak memory is estimated from the
+    partitions and one aggregation level.
+  *****************************************************************************/
+  double optimise_partition_run(Optimiser* optimiser,
+                                vector<MutableVertexPartition*> const& partitions,
+                                vector<double> const& layer_weights,
+                                vector<bool> const& is_membership_fixed,
+                                int aggregate_order,
+                                vector< vector<size_t> >* levels,
+                                optimiser_workspace_t* workspace)
+  {
+    if (uses_optimise_driver(workspace, aggregate_order, levels != NULL))
+      return optimise_partition_levels(optimiser, partitions, layer_weights, is_membership_fixed,
+                                       aggregate_order, levels, workspace);
+
+    double q;
+    if (partitions.size() == 1)
+      q = optimiser->optimise_partition(partitions[0], is_membership_fixed);
+    else
+      q = optimiser->optimise_partition(partitions, layer_weights, is_membership_fixed);
+
+    size_t usage = 0;
+    for (MutableVertexPartition* partition : partitions)
+    {
+      memory_usage_t partition_usage = estimate_memory_usage(partition);
+      usage += partition_usage.total() + partition_usage.aggregation;
+    }
+    workspace->peak_memory_usage = std::max(workspace->peak_memory_usage, usage);
+    workspace->status = poll_optimise_status(workspace);
+    return q;
+  }
+
+  double optimise_partition_iterations(Optimiser* optimiser, MutableVertexPartition* partition, int n_iterations,
+                                       optimiser_workspace_t* workspace, int aggregate_order)
+  {
+    // Same iteration scheme as Optimiser.optimise_partition in Python: a
+    // negative number of iterations runs until there is no more improvement.
+    // With a workspace, the settings of the binding in it select the driver,
+    // as for Optimiser.optimise_partition.
+    vector<MutableVertexPartition*> partitions(1, partition);
+    vector<double> layer_weights(1, 1.0);
+    vector<bool> is_membership_fixed(partition->get_graph()->vcount(), false);
+    double diff = 0.0;
+    int itr = 0;
+    bool continue_iteration = itr < n_iterations || n_iterations < 0;
+    while (continue_iteration)
+    {
+      double diff_inc;
+      if (workspace != NULL)
+        diff_inc = optimise_partition_run(optimiser, partitions, layer_weights, is_membership_fixed,
+                                          aggregate_order, NULL, workspace);
+      else
+        diff_inc = optimiser->optimise_partition(partition);
+      diff += diff_inc;
+      itr += 1;
+      if (n_iterations < 0)
+        continue_iteration = (diff_inc > 0);
+      else
+        continue_iteration = itr < n_iterations;
+    }
+    return diff;
+  }
+
+  double optimise_partition_levels(Optimiser* optimiser,
+                                   vector<MutableVertexPartition*> partitions,
+                                   vector<double> const& layer_weights,
+                                   vector<bool> const& is_membership_fixed,
+                                   int aggregate_order,
+                                   vector< vector<size_t> >* levels,
+                                   optimiser_workspace_t* workspace)
+  {
+    // Same procedure as Optimiser::optimise_partition, which discards the
+    // aggregate graphs once it is done with them. Here the map from the nodes
+    // of each level to the nodes of the next level is kept in levels, so that
+    // composing all maps yields the final membership. The nodes of each
+    // aggregate graph are laid out according to aggregate_order.
+    size_t nb_layers = partitions.size();
+    if (nb_layers == 0)
+      throw Exception("No partitions provided.");
+
+    vector<Graph*> graphs(nb_layers);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+      graphs[layer] = partitions[layer]->get_graph();
+
+    size_t n = graphs[0]->vcount();
+    for (size_t layer = 1; layer < nb_layers; layer++)
+      if (graphs[layer]->vcount() != n)
+        throw Exception("Number of nodes are not equal for all graphs.");
+    if (is_membership_fixed.size() != n)
+      throw Exception("Number of nodes in is_membership_fixed does not match the number of nodes.");
+
+    // The vectors of all levels live in the workspace, which keeps their
+    // memory for the next level and the next call.
+    optimiser_workspace_t local_workspace;
+    if (workspace == NULL)
+      workspace = &local_workspace;
+
+    vector<size_t>& fixed_nodes = workspace->fixed_nodes;
+    vector<size_t>& fixed_membership = workspace->fixed_membership;
+    fixed_nodes.clear();
+    fixed_membership.assign(n, 0);
+    for (size_t v = 0; v < n; v++)
+    {
+      if (is_membership_fixed[v])
+      {
+        fixed_nodes.push_back(v);
+        fixed_membership[v] = partitions[0]->membership(v);
+      }
+    }
+
+    vector<Graph*>& collapsed_graphs = workspace->collapsed_graphs;
+    vector<MutableVertexPartition*>& collapsed_partitions = workspace->collapsed_partitions;
+    vector<Graph*>& new_collapsed_graphs = workspace->new_collapsed_graphs;
+    vector<MutableVertexPartition*>& new_collapsed_partitions = workspace->new_collapsed_partitions;
+    vector<MutableVertexPartition*>& sub_collapsed_partitions = workspace->sub_collapsed_partitions;
+    vector<bool>& is_collapsed_membership_fixed = workspace->is_collapsed_membership_fixed;
+    vector<size_t>& aggregate_node_per_individual_node = workspace->aggregate_node_per_individual_node;
+    vector<size_t>& new_collapsed_membership = workspace->new_collapsed_membership;
+
+    collapsed_graphs.assign(graphs.begin(), graphs.end());
+    collapsed_partitions.assign(partitions.begin(), partitions.end());
+    new_collapsed_graphs.assign(nb_layers, NULL);
+    new_collapsed_partitions.assign(nb_layers, NULL);
+    sub_collapsed_partitions.assign(nb_layers, NULL);
+    is_collapsed_membership_fixed.assign(is_membership_fixed.begin(), is_membership_fixed.end());
+    aggregate_node_per_individual_node.resize(n);
+    for (size_t v = 0; v < n; v++)
+      aggregate_node_per_individual_node[v] = v;
+
+    if (levels != NULL)
+      levels->clear();
+    track_memory_usage(partitions, workspace);
+
+    double total_improv = 0.0;
+    bool aggregate_further = true;
+    workspace->progress.level = 0;
+    try
+    {
+      do
+      {
+        // Stop between levels when requested. The partitions then hold the
+        // communities found so far, and are renumbered as usual below.
+        workspace->status = poll_optimise_status(workspace);
+        if (workspace->status != OPTIMISE_COMPLETE)
+          break;
+
+        #ifdef DEBUG
+          cerr << "Optimising level with " << collapsed_graphs[0]->vcount() << " nodes." << endl;
+        #endif
+        // The moves are only counted when they are reported.
+        if (workspace->progress_callback != NULL)
+          workspace->level_membership = collapsed_partitions[0]->membership();
+
+        // The routines of libleidenalg read the constraints on the community
+        // sizes from the optimiser, so these also hold for the pruned routines,
+        // while fused moves are not used when they do not support them.
+        double improv = 0.0;
+        bool fused = workspace->fused_moves && supports_fused_moves(optimiser);
+        bool merge = (optimiser->optimise_routine == Optimiser::MERGE_NODES);
+        if (fused && (merge || optimiser->optimise_routine == Optimiser::MOVE_NODES))
+        {
+          int consider_comms = workspace->pruned_all_comms ? Optimiser::ALL_NEIGH_COMMS : optimiser->consider_comms;
+          improv = move_nodes_fused(optimiser, collapsed_partitions, layer_weights, is_collapsed_membership_fixed,
+                                    consider_comms, merge, NULL, workspace);
+          if (workspace->pruned_all_comms && workspace->status == OPTIMISE_COMPLETE)
+            improv += move_nodes_fused(optimiser, collapsed_partitions, layer_weights, is_collapsed_membership_fixed,
+                                       Optimiser::ALL_COMMS, merge, NULL, workspace);
+        }
+        else if (workspace->pruned_all_comms && optimiser->optimise_routine == Optimiser::MOVE_NODES)
+          improv = move_nodes_pruned(optimiser, collapsed_partitions, layer_weights, is_collapsed_membership_fixed, false);
+        else if (workspace->pruned_all_comms && optimiser->optimise_routine == Optimiser::MERGE_NODES)
+          improv = merge_nodes_pruned(optimiser, collapsed_partitions, layer_weights, is_collapsed_membership_fixed, false);
+        else if (optimiser->optimise_routine == Optimiser::MOVE_NODES)
+          improv = optimiser->move_nodes(collapsed_partitions, layer_weights, is_collapsed_membership_fixed,
+                                         optimiser->consider_comms, optimiser->consider_empty_community, false);
+        else if (optimiser->optimise_routine == Optimiser::MERGE_NODES)
+          improv = optimiser->merge_nodes(collapsed_partitions, layer_weights, is_collapsed_membership_fixed,
+                                          optimiser->consider_comms, false);
+        total_improv += improv;
+        // The routines of libleidenalg cannot be stopped while they run, so
+        // they are only stopped once they are done.
+        if (!fused)
+          workspace->status = poll_optimise_status(workspace);
+
+        // The routines renumber the communities, so the moves are counted by
+        // matching the communities before and after rather than by label.
+        size_t level_moves = 0;
+        if (workspace->progress_callback != NULL)
+          level_moves = count_moved_nodes(workspace->level_membership, collapsed_partitions[0]->membership());
+
+        // Without refinement, the communities of this level are the nodes of
+        // the next level, and the individual nodes take over their labels.
+        if (!optimiser->refine_partition)
+          relabel_for_aggregation(collapsed_partitions, aggregate_order, &workspace->aggregation);
+
+        // Carry the communities of this level back to the individual nodes.
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          if (collapsed_partitions[layer] != partitions[layer])
+          {
+            if (optimiser->refine_partition)
+              partitions[layer]->from_coarse_partition(collapsed_partitions[layer], aggregate_node_per_individual_node);
+            else
+              partitions[layer]->from_coarse_partition(collapsed_partitions[layer]);
+          }
+        }
+
+        // When stopped while moving nodes, the partitions keep the
+        // communities of this level, without refining or aggregating.
+        if (workspace->status != OPTIMISE_COMPLETE)
+          break;
+
+        size_t level_vcount = collapsed_graphs[0]->vcount();
+        if (optimiser->refine_partition)
+        {
+          // Refine the communities, and aggregate based on the refinement.
+          for (size_t layer = 0; layer < nb_layers; layer++)
+            sub_collapsed_partitions[layer] = collapsed_partitions[layer]->create(collapsed_graphs[layer]);
+
+          bool refine_merge = (optimiser->refine_routine == Optimiser::MERGE_NODES);
+          if (fused && (refine_merge || optimiser->refine_routine == Optimiser::MOVE_NODES))
+            move_nodes_fused(optimiser, sub_collapsed_partitions, layer_weights, vector<bool>(),
+                             optimiser->refine_consider_comms, refine_merge, collapsed_partitions[0], workspace);
+          else if (optimiser->refine_routine == Optimiser::MOVE_NODES)
+            optimiser->move_nodes_constrained(sub_collapsed_partitions, layer_weights,
+                                              optimiser->refine_consider_comms, collapsed_partitions[0]);
+          else if (optimiser->refine_routine == Optimiser::MERGE_NODES)
+            optimiser->merge_nodes_constrained(sub_collapsed_partitions, layer_weights,
+                                               optimiser->refine_consider_comms, collapsed_partitions[0]);
+          if (workspace->status != OPTIMISE_COMPLETE)
+            break;
+          relabel_for_aggregation(sub_collapsed_partitions, aggregate_order, &workspace->aggregation);
+
+          for (size_t v = 0; v < n; v++)
+            aggregate_node_per_individual_node[v] = sub_collapsed_partitions[0]->membership(aggregate_node_per_individual_node[v]);
+
+          for (size_t layer = 0; layer < nb_layers; layer++)
+            new_collapsed_graphs[layer] = collapsed_graphs[layer]->collapse_graph(sub_collapsed_partitions[layer]);
+          track_memory_usage(partitions, workspace);
+
+          // The aggregate nodes start out in the community of the
+          // unrefined partition that contains them.
+          new_collapsed_membership.assign(new_collapsed_graphs[0]->vcount(), 0);
+          for (size_t v = 0; v < level_vcount; v++)
+            new_collapsed_membership[sub_collapsed_partitions[0]->membership(v)] = collapsed_partitions[0]->membership(v);
+
+          if (levels != NULL)
+            levels->push_back(sub_collapsed_partitions[0]->membership());
+
+          for (size_t layer = 0; layer < nb_layers; layer++)
+          {
+            new_collapsed_partitions[layer] = collapsed_partitions[layer]->create(new_collapsed_graphs[layer], new_collapsed_membership);
+            delete sub_collapsed_partitions[layer];
+            sub_collapsed_partitions[layer] = NULL;
+          }
+        }
+        else
+        {
+          for (size_t v = 0; v < n; v++)
+            aggregate_node_per_individual_node[v] = collapsed_partitions[0]->membership(aggregate_node_per_individual_node[v]);
+
+          for (size_t layer = 0; layer < nb_layers; layer++)
+          {
+            new_collapsed_graphs[layer] = collapsed_graphs[layer]->collapse_graph(collapsed_partitions[layer]);
+            new_collapsed_partitions[layer] = collapsed_partitions[layer]->create(new_collapsed_graphs[layer]);
+          }
+
+          if (levels != NULL)
+            levels->push_back(collapsed_partitions[0]->membership());
+        }
+
+        // An aggregate node is fixed if it contains a fixed node.
+        is_collapsed_membership_fixed.assign(new_collapsed_graphs[0]->vcount(), false);
+        for (size_t v : fixed_nodes)
+          is_collapsed_membership_fixed[aggregate_node_per_individual_node[v]] = true;
+
+        aggregate_further = (new_collapsed_graphs[0]->vcount() < level_vcount) &&
+                            (level_vcount > collapsed_partitions[0]->n_communities());
+
+        track_memory_usage(partitions, workspace);
+        release_level(partitions, collapsed_graphs, collapsed_partitions);
+        release_sub_partitions(workspace);
+        collapsed_partitions.swap(new_collapsed_partitions);
+        collapsed_graphs.swap(new_collapsed_graphs);
+
+        // Report at the end of the level, where the partitions are consistent,
+        // so that the callback may also stop the optimisation.
+        workspace->progress.level_nodes = level_vcount;
+        workspace->progress.nodes_processed += level_vcount;
+        workspace->progress.moves += level_moves;
+        workspace->progress.improvement += improv;
+        workspace->status = report_progress(workspace);
+        if (workspace->status != OPTIMISE_COMPLETE)
+          break;
+        workspace->progress.level++;
+      } while (aggregate_further);
+    }
+    catch (...)
+    {
+      release_levels(partitions, workspace);
+      throw;
+    }
+    workspace->progress.iteration++;
+
+    size_t top_vcount = collapsed_graphs[0]->vcount();
+    release_levels(partitions, workspace);
+
+    partitions[0]->renumber_communities();
+    partitions[0]->renumber_communities(fixed_nodes, fixed_membership);
+    vector<size_t> const& membership = partitions[0]->membership();
+    for (size_t layer = 1; layer < nb_layers; layer++)
+      partitions[layer]->set_membership(membership);
+
+    if (levels != NULL)
+    {
+      // Final level: from the top aggregate nodes to the renumbered communities.
+      vector<size_t> top_level(top_vcount, 0);
+      for (size_t v = 0; v < n; v++)
+        top_level[aggregate_node_per_individual_node[v]] = membership[v];
+      levels->push_back(top_level);
+    }
+
+    return total_improv;
+  }
+
+  /****************************************************************************
+    Move nodes considering all communities, as for ALL_COMMS, but first move
+    nodes considering only their neighbouring communities until that converges.
+    The pass over all communities then still visits every node at least once,
+    at O(k) per node for k communities, but starts from a partition in which
+    few nodes move, so that it usually takes about one sweep rather than the
+    repeated sweeps of ALL_COMMS from the start. It runs until no node can be
+    moved, so that the result is as stable as with ALL_COMMS. This is not a
+    sampling scheme: every community is still evaluated for every node.
+  *****************************************************************************/
+  double move_nodes_pruned(Optimiser* optimiser, vector<MutableVertexPartition*> partitions,
+                           vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                           bool renumber)
+  {
+    double improv = optimiser->move_nodes(partitions, layer_weights, is_membership_fixed,
+                                          Optimiser::ALL_NEIGH_COMMS, optimiser->consider_empty_community, renumber);
+    improv += optimiser->move_nodes(partitions, layer_weights, is_membership_fixed,
+                                    Optimiser::ALL_COMMS, optimiser->consider_empty_community, renumber);
+    return improv;
+  }
+
+  double merge_nodes_pruned(Optimiser* optimiser, vector<MutableVertexPartition*> partitions,
+                            vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                            bool renumber)
+  {
+    // Merging only moves nodes that are still on their own, so the merge over
+    // all communities only concerns the nodes left by the first merge.
+    double improv = optimiser->merge_nodes(partitions, layer_weights, is_membership_fixed,
+                                           Optimiser::ALL_NEIGH_COMMS, renumber);
+    improv += optimiser->merge_nodes(partitions, layer_weights, is_membership_fixed,
+                                     Optimiser::ALL_COMMS, renumber);
+    return improv;
+  }
+
+  /****************************************************************************
+    Whether move_nodes_fused can replace the routines of libleidenalg for the
+    settings of the optimiser. Minimum community sizes and the enforcement of
+    the size constraints are only supported by the routines of libleidenalg,
+    which optimise_partition_levels then uses instead, also for the levels
+    and the refinement. A maximum community size on its own is a hard limit,
+    as in libleidenalg.
+  *****************************************************************************/
+  bool supports_fused_moves(Optimiser* optimiser)
+  {
+    return optimiser->min_comm_size == 0 && optimiser->community_constraint_enforcement == 0;
+  }
+
+  /****************************************************************************
+    Key by which the candidate index of ALL_COMMS orders the communities, see
+    move_nodes_fused. A node has no weight to or from a community that none
+    of its neighbours is in, so that the difference in quality of moving it
+    there only depends on that community through a single term: the size of
+    the community for CPM and RBER, and its total weight for modularity and
+    RBConfiguration on undirected graphs. The best of these communities is
+    then at one end of the index, and considering only that one, besides the
+    neighbouring communities, gives the same improvement as considering all
+    communities, in which case is_exact is set. Otherwise, with several
+    layers, directed configuration models or other quality functions, no
+    such key exists, and the index orders the communities by size, which only
+    approximates considering all communities.
+  *****************************************************************************/
+  int comm_index_key(vector<MutableVertexPartition*> const& partitions, int kernel, bool* is_exact)
+  {
+    *is_exact = false;
+    if (partitions.size() == 1)
+    {
+      if (kernel == KERNEL_CPM || kernel == KERNEL_RBER)
+        *is_exact = true;
+      else if ((kernel == KERNEL_MODULARITY || kernel == KERNEL_RB_CONFIGURATION) &&
+               !partitions[0]->get_graph()->is_directed())
+      {
+        *is_exact = true;
+        return COMM_INDEX_TOTAL_WEIGHT;
+      }
+    }
+    return COMM_INDEX_SIZE;
+  }
+
+  double comm_index_value(MutableVertexPartition* partition, int key, size_t comm)
+  {
+    if (key == COMM_INDEX_TOTAL_WEIGHT)
+      return partition->total_weight_from_comm(comm) + partition->total_weight_to_comm(comm);
+    return partition->csize(comm);
+  }
+
+  /****************************************************************************
+    Coefficient by which the difference in quality of moving node v to a
+    community without any of its neighbours decreases with the key of that
+    community, for the keys of comm_index_key that are exact. A positive
+    coefficient favours the start of the index, and a negative one its end.
+    These are the null model terms of diff_move_configuration, for which the
+    weights from and to a community are equal, and the penalty terms of
+    diff_move_penalty.
+  *****************************************************************************/
+  double comm_index_coefficient(MutableVertexPartition* partition, int kernel, size_t v)
+  {
+    Graph* graph = partition->get_graph();
+    switch (kernel)
+    {
+      case KERNEL_CPM:
+        return 2.0*static_cast<CPMVertexPartition*>(partition)->resolution_parameter*graph->node_size(v);
+      case KERNEL_RBER:
+        return 2.0*static_cast<RBERVertexPartition*>(partition)->resolution_parameter*graph->density()*graph->node_size(v);
+      case KERNEL_MODULARITY:
+      case KERNEL_RB_CONFIGURATION:
+      {
+        double total_weight = graph->total_weight()*(2.0 - graph->is_directed());
+        if (total_weight == 0.0)
+          return 0.0;
+        double gamma = (kernel == KERNEL_MODULARITY) ?
+                       1.0/total_weight : static_cast<RBConfigurationVertexPartition*>(partition)->resolution_parameter;
+        return gamma*graph->strength(v, IGRAPH_OUT)/total_weight;
+      }
+    }
+    return 0.0;
+  }
+
+  // Random index in [0, n), the same on all platforms
+  inline size_t random_index(std::mt19937_64& rng, size_t n)
+  {
+    return rng() % n;
+  }
+
+  /****************************************************************************
+    Add the weights of the edges of node v in mode to the communities of its
+    neighbours, halving self-loops of undirected graphs, as weight_to_comm
+    and weight_from_comm do. With a constrained partition, only neighbours in
+    the same constrained community as v are considered.
+  *****************************************************************************/
+  inline void accumulate_comm_weights(MutableVertexPartition* partition, Graph* graph, size_t v,
+                                      igraph_neimode_t mode, MutableVertexPartition* constrained_partition,
+                                      community_accumulator_t& accumulator)
+  {
+    vector<size_t> const& neighbours = graph->get_neighbours(v, mode);
+    vector<size_t> const& edges = graph->get_neighbour_edges(v, mode);
+    bool is_directed = graph->is_directed();
+    for (size_t i = 0; i < neighbours.size(); i++)
+    {
+      size_t u = neighbours[i];
+      if (constrained_partition != NULL &&
+          constrained_partition->membership(u) != constrained_partition->membership(v))
+        continue;
+      double w = graph->edge_weight(edges[i]);
+      if (u == v && !is_directed)
+        w /= 2.0;
+      accumulator.add(partition->membership(u), w);
+    }
+  }
+
+  /****************************************************************************
+    Move nodes as Optimiser::move_nodes does, or only merge nodes that are on
+    their own as Optimiser::merge_nodes does if merge is true. If a
+    constrained partition is given, nodes only move within their community in
+    that partition, as for the constrained variants of these routines.
+
+    Unlike these routines, the layers are fused: the weights of a node to and
+    from the communities of its neighbours are accumulated in a single pass
+    over its neighbours in each layer, which also collects the candidate
+    communities. The improvement of a move then sums the diff_move kernel of
+    each layer per candidate, see diff_move_kernels.h, which is resolved at
+    compile time if all layers have the same kernel. The
+    queue, flags and candidate lists are kept in the workspace across levels
+    and calls, and the random choices use the generator of the workspace.
+    With the candidate index of the workspace, ALL_COMMS considers the
+    neighbouring communities and the first communities of an index ordered
+    by the key of comm_index_key, rather than every community.
+    Every few thousand nodes, the status is polled, so that a time budget, a
+    request to cancel or a signal also stops a level that takes long. The
+    partitions are then left consistent, with the moves made so far, and the
+    status of the workspace is set.
+  *****************************************************************************/
+  template <int kernel>
+  double move_nodes_fused_kernel(Optimiser* optimiser, vector<MutableVertexPartition*> const& partitions,
+                                 vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                                 int consider_comms, bool merge, MutableVertexPartition* constrained_partition,
+                                 optimiser_workspace_t* workspace)
+  {
+    const size_t poll_interval = 4096;
+
+    size_t nb_layers = partitions.size();
+    vector<Graph*> graphs(nb_layers);
+    vector<bool> is_directed(nb_layers);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+    {
+      graphs[layer] = partitions[layer]->get_graph();
+      is_directed[layer] = graphs[layer]->is_directed();
+    }
+    vector<int> const& layer_kernels = workspace->layer_kernels;
+    vector<community_accumulator_t>& weight_to = workspace->weight_to_comms;
+    vector<community_accumulator_t>& weight_from = workspace->weight_from_comms;
+    if (weight_to.size() < nb_layers)
+    {
+      weight_to.resize(nb_layers);
+      weight_from.resize(nb_layers);
+    }
+    size_t n = graphs[0]->vcount();
+    size_t max_comm_size = optimiser->max_comm_size;
+    bool has_fixed = !is_membership_fixed.empty();
+    bool consider_empty_community = optimiser->consider_empty_community && !merge && constrained_partition == NULL;
+    std::mt19937_64& rng = workspace->rng;
+
+    // Constraint, if any, and the nodes of the constrained communities for
+    // the routines that need them.
+    vector<size_t> no_constraint;
+    vector<size_t> const& constrained_membership = constrained_partition != NULL ?
+                                                   constrained_partition->membership() : no_constraint;
+    vector< vector<size_t> > constrained_comms;
+    if (constrained_partition != NULL && (consider_comms == Optimiser::ALL_COMMS || consider_comms == Optimiser::RAND_COMM))
+      constrained_comms = constrained_partition->get_communities();
+
+    // Visit the nodes that are not fixed in random order
+    vector<size_t>& nodes = workspace->nodes;
+    nodes.clear();
+    for (size_t v = 0; v < n; v++)
+      if (!has_fixed || !is_membership_fixed[v])
+        nodes.push_back(v);
+    for (size_t i = nodes.size(); i > 1; i--)
+      std::swap(nodes[i - 1], nodes[random_index(rng, i)]);
+
+    std::deque<size_t>& node_queue = workspace->node_queue;
+    node_queue.assign(nodes.begin(), nodes.end());
+
+    // Fixed nodes count as stable, so that they are never queued again.
+    vector<bool>& is_node_stable = workspace->is_node_stable;
+    is_node_stable.assign(n, false);
+    if (has_fixed)
+      for (size_t v = 0; v < n; v++)
+        is_node_stable[v] = is_membership_fixed[v];
+
+    vector<size_t>& comms = workspace->candidate_comms;
+    vector<bool>& is_candidate_comm = workspace->is_candidate_comm;
+    vector<size_t>& constrained_neighbours = workspace->constrained_neighbours;
+    comms.clear();
+
+    // Communities ordered by the key of comm_index_key, so that ALL_COMMS only
+    // considers the neighbouring communities and the first communities of the
+    // index. The index is updated for the two communities of each move.
+    bool is_exact_index = false;
+    int index_key = comm_index_key(partitions, layer_kernels[0], &is_exact_index);
+    bool use_index = workspace->candidate_index && consider_comms == Optimiser::ALL_COMMS &&
+                     constrained_partition == NULL && (is_exact_index || workspace->candidate_limit > 0);
+    size_t index_limit = (workspace->candidate_limit > 0) ? workspace->candidate_limit : 1;
+    std::set< std::pair<double, size_t> >& comm_index = workspace->comm_index;
+    vector<double>& comm_index_values = workspace->comm_index_values;
+    vector<bool>& is_indexed_comm = workspace->is_indexed_comm;
+    auto index_comm = [&](size_t comm)
+    {
+      if (is_indexed_comm.size() <= comm)
+      {
+        is_indexed_comm.resize(comm + 1, false);
+        comm_index_values.resize(comm + 1, 0.0);
+      }
+      if (is_indexed_comm[comm])
+      {
+        comm_index.erase(std::make_pair(comm_index_values[comm], comm));
+        is_indexed_comm[comm] = false;
+      }
+      if (partitions[0]->cnodes(comm) > 0)
+      {
+        comm_index_values[comm] = comm_index_value(partitions[0], index_key, comm);
+        comm_index.insert(std::make_pair(comm_index_values[comm], comm));
+        is_indexed_comm[comm] = true;
+      }
+    };
+    comm_index.clear();
+    if (use_index)
+    {
+      is_indexed_comm.assign(partitions[0]->n_communities(), false);
+      comm_index_values.resize(partitions[0]->n_communities());
+      for (size_t comm = 0; comm < partitions[0]->n_communities(); comm++)
+        index_comm(comm);
+    }
+
+    double total_improv = 0.0;
+    size_t nb_processed = 0;
+    while (!node_queue.empty())
+    {
+      size_t v = node_queue.front();
+      node_queue.pop_front();
+
+      if (++nb_processed % poll_interval == 0)
+      {
+        int status = poll_optimise_status(workspace);
+        if (status != OPTIMISE_COMPLETE)
+        {
+          workspace->status = status;
+          break;
+        }
+      }
+
+      size_t v_comm = partitions[0]->membership(v);
+      // Merging only moves nodes that are still on their own
+      if (merge && partitions[0]->cnodes(v_comm) != 1)
+        continue;
+
+      // An empty community may be added below
+      size_t nb_comms = partitions[0]->n_communities();
+      if (is_candidate_comm.size() < nb_comms + 1)
+        is_candidate_comm.resize(nb_comms + 1, false);
+      auto add_candidate = [&comms, &is_candidate_comm](size_t comm)
+      {
+        if (!is_candidate_comm[comm])
+        {
+          is_candidate_comm[comm] = true;
+          comms.push_back(comm);
+        }
+      };
+
+      // Weights to and from the communities of the neighbours, in a single
+      // pass over the neighbours in each layer. With a constraint, only
+      // communities within the constrained community of v are candidates, so
+      // only the neighbours in that community are needed.
+      for (size_t layer = 0; layer < nb_layers; layer++)
+      {
+        weight_to[layer].reserve(nb_comms + 1);
+        if (is_directed[layer])
+        {
+          weight_from[layer].reserve(nb_comms + 1);
+          accumulate_comm_weights(partitions[layer], graphs[layer], v, IGRAPH_OUT,
+                                  constrained_partition, weight_to[layer]);
+          accumulate_comm_weights(partitions[layer], graphs[layer], v, IGRAPH_IN,
+                                  constrained_partition, weight_from[layer]);
+        }
+        else
+          accumulate_comm_weights(partitions[layer], graphs[layer], v, IGRAPH_ALL,
+                                  constrained_partition, weight_to[layer]);
+      }
+
+      if (consider_comms == Optimiser::ALL_NEIGH_COMMS || use_index)
+      {
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          for (size_t comm : weight_to[layer].touched)
+            add_candidate(comm);
+          if (is_directed[layer])
+            for (size_t comm : weight_from[layer].touched)
+              add_candidate(comm);
+        }
+      }
+
+      if (use_index)
+      {
+        // The first communities of the index that none of the neighbours are
+        // in, and that are not too large to move to.
+        bool from_end = is_exact_index && comm_index_coefficient(partitions[0], layer_kernels[0], v) < 0;
+        size_t nb_indexed = 0;
+        auto add_indexed_candidate = [&](size_t comm)
+        {
+          if (comm == v_comm || is_candidate_comm[comm])
+            return;
+          if (0 < max_comm_size && max_comm_size < partitions[0]->csize(comm) + graphs[0]->node_size(v))
+            return;
+          add_candidate(comm);
+          nb_indexed++;
+        };
+        if (from_end)
+          for (auto it = comm_index.rbegin(); it != comm_index.rend() && nb_indexed < index_limit; ++it)
+            add_indexed_candidate(it->second);
+        else
+          for (auto it = comm_index.begin(); it != comm_index.end() && nb_indexed < index_limit; ++it)
+            add_indexed_candidate(it->second);
+      }
+      else if (consider_comms == Optimiser::ALL_COMMS)
+      {
+        if (constrained_partition == NULL)
+        {
+          for (size_t comm = 0; comm < partitions[0]->n_communities(); comm++)
+            if (partitions[0]->cnodes(comm) > 0)
+              add_candidate(comm);
+        }
+        else
+        {
+          for (size_t u : constrained_comms[constrained_membership[v]])
+            add_candidate(partitions[0]->membership(u));
+        }
+      }
+      else if (consider_comms == Optimiser::RAND_COMM)
+      {
+        if (constrained_partition == NULL)
+          add_candidate(partitions[0]->membership(random_index(rng, n)));
+        else
+        {
+          vector<size_t> const& constrained_comm = constrained_comms[constrained_membership[v]];
+          add_candidate(partitions[0]->membership(constrained_comm[random_index(rng, constrained_comm.size())]));
+        }
+      }
+      else if (consider_comms == Optimiser::RAND_NEIGH_COMM)
+      {
+        size_t rand_layer = random_index(rng, nb_layers);
+        vector<size_t> const& neighbours = graphs[rand_layer]->get_neighbours(v, IGRAPH_ALL);
+        if (constrained_partition == NULL)
+        {
+          if (!neighbours.empty())
+            add_candidate(partitions[0]->membership(neighbours[random_index(rng, neighbours.size())]));
+        }
+        else
+        {
+          constrained_neighbours.clear();
+          for (size_t u : neighbours)
+            if (constrained_membership[u] == constrained_membership[v])
+              constrained_neighbours.push_back(u);
+          if (!constrained_neighbours.empty())
+            add_candidate(partitions[0]->membership(constrained_neighbours[random_index(rng, constrained_neighbours.size())]));
+        }
+      }
+
+      // Also consider an empty community, if the node is not on its own
+      if (consider_empty_community && partitions[0]->cnodes(v_comm) > 1)
+      {
+        size_t empty_comm = partitions[0]->get_empty_community();
+        add_candidate(empty_comm);
+        if (partitions[0]->n_communities() > nb_comms)
+          for (size_t layer = 1; layer < nb_layers; layer++)
+            partitions[layer]->add_empty_community();
+      }
+
+      // Find the best candidate, staying if the node is in a community that is
+      // too large already. Merging also accepts a move without improvement.
+      double v_size = graphs[0]->node_size(v);
+      size_t max_comm = v_comm;
+      double max_improv = (0 < max_comm_size && max_comm_size < partitions[0]->csize(v_comm)) ?
+                          -std::numeric_limits<double>::infinity() : 0;
+      node_move_t move;
+      move.v = v;
+      move.old_comm = v_comm;
+      for (size_t comm : comms)
+      {
+        is_candidate_comm[comm] = false;
+        if (0 < max_comm_size && max_comm_size < partitions[0]->csize(comm) + v_size)
+          continue;
+
+        move.new_comm = comm;
+        double possible_improv = 0.0;
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          community_accumulator_t const& to = weight_to[layer];
+          community_accumulator_t const& from = is_directed[layer] ? weight_from[layer] : to;
+          move.w_to_old = to.weight[v_comm];
+          move.w_from_old = from.weight[v_comm];
+          move.w_to_new = to.weight[comm];
+          move.w_from_new = from.weight[comm];
+          if (kernel == KERNEL_MIXED)
+            possible_improv += layer_weights[layer]*kernel_diff_move(layer_kernels[layer], partitions[layer], move);
+          else
+            possible_improv += layer_weights[layer]*kernel_diff_move<kernel>(partitions[layer], move);
+        }
+
+        if (merge ? possible_improv >= max_improv : possible_improv > max_improv)
+        {
+          max_comm = comm;
+          max_improv = possible_improv;
+        }
+      }
+      comms.clear();
+      for (size_t layer = 0; layer < nb_layers; layer++)
+      {
+        weight_to[layer].clear();
+        if (is_directed[layer])
+          weight_from[layer].clear();
+      }
+
+      if (!merge)
+        is_node_stable[v] = true;
+
+      if (max_comm != v_comm)
+      {
+        total_improv += max_improv;
+        for (size_t layer = 0; layer < nb_layers; layer++)
+          partitions[layer]->move_node(v, max_comm);
+        if (use_index)
+        {
+          index_comm(v_comm);
+          index_comm(max_comm);
+        }
+
+        // The neighbours that are not in the new community may now prefer to
+        // move as well.
+        if (!merge)
+        {
+          for (size_t layer = 0; layer < nb_layers; layer++)
+          {
+            for (size_t u : graphs[layer]->get_neighbours(v, IGRAPH_ALL))
+            {
+              if (is_node_stable[u] && partitions[0]->membership(u) != max_comm &&
+                  (constrained_partition == NULL || constrained_membership[u] == constrained_membership[v]))
+              {
+                node_queue.push_back(u);
+                is_node_stable[u] = false;
+              }
+            }
+          }
+        }
+      }
+    }
+    node_queue.clear();
+    comm_index.clear();
+
+    partitions[0]->renumber_communities();
+    vector<size_t> const& membership = partitions[0]->membership();
+    for (size_t layer = 1; layer < nb_layers; layer++)
+      partitions[layer]->set_membership(membership);
+
+    return total_improv;
+  }
+
+  double move_nodes_fused(Optimiser* optimiser, vector<MutableVertexPartition*> const& partitions,
+                          vector<double> const& layer_weights, vector<bool> const& is_membership_fixed,
+                          int consider_comms, bool merge, MutableVertexPartition* constrained_partition,
+                          optimiser_workspace_t* workspace)
+  {
+    size_t nb_layers = partitions.size();
+    if (nb_layers == 0)
+      return -1.0;
+
+    // The kernel of all layers, or KERNEL_MIXED if they differ
+    vector<int>& layer_kernels = workspace->layer_kernels;
+    layer_kernels.resize(nb_layers);
+    int kernel = diff_move_kernel(partitions[0]);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+    {
+      layer_kernels[layer] = diff_move_kernel(partitions[layer]);
+      if (layer_kernels[layer] != kernel)
+        kernel = KERNEL_MIXED;
+    }
+
+    #ifdef DEBUG
+      cerr << "move_nodes_fused with kernel " << kernel << endl;
+    #endif
+
+    switch (kernel)
+    {
+      case KERNEL_MODULARITY:
+        return move_nodes_fused_kernel<KERNEL_MODULARITY>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                          consider_comms, merge, constrained_partition, workspace);
+      case KERNEL_RB_CONFIGURATION:
+        return move_nodes_fused_kernel<KERNEL_RB_CONFIGURATION>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                                consider_comms, merge, constrained_partition, workspace);
+      case KERNEL_CPM:
+        return move_nodes_fused_kernel<KERNEL_CPM>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                   consider_comms, merge, constrained_partition, workspace);
+      case KERNEL_RBER:
+        return move_nodes_fused_kernel<KERNEL_RBER>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                    consider_comms, merge, constrained_partition, workspace);
+      case KERNEL_SIGNIFICANCE:
+        return move_nodes_fused_kernel<KERNEL_SIGNIFICANCE>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                            consider_comms, merge, constrained_partition, workspace);
+      case KERNEL_SURPRISE:
+        return move_nodes_fused_kernel<KERNEL_SURPRISE>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                        consider_comms, merge, constrained_partition, workspace);
+      case KERNEL_MIXED:
+        return move_nodes_fused_kernel<KERNEL_MIXED>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                     consider_comms, merge, constrained_partition, workspace);
+    }
+    return move_nodes_fused_kernel<KERNEL_VIRTUAL>(optimiser, partitions, layer_weights, is_membership_fixed,
+                                                   consider_comms, merge, constrained_partition, workspace);
+  }
+
+  /****************************************************************************
+    Whether the optimisation should stop: because of a request to cancel, the
+    end of the time budget, or a signal such as a keyboard interrupt. In the
+    latter case the Python exception is set. A request to cancel is consumed.
+    This is called without the GIL, which is only taken to check for signals.
+  *****************************************************************************/
+  int poll_optimise_status(optimiser_workspace_t* workspace)
+  {
+    if (workspace->cancel_requested.exchange(false))
+      return OPTIMISE_CANCELLED;
+    if (workspace->has_deadline && std::chrono::steady_clock::now() >= workspace->deadline)
+      return OPTIMISE_TIME_BUDGET;
+    if (!workspace->check_signals)
+      return OPTIMISE_COMPLETE;
+    PyGILState_STATE gil_state = PyGILState_Ensure();
+    int signalled = PyErr_CheckSignals();
+    PyGILState_Release(gil_state);
+    if (signalled != 0)
+      return OPTIMISE_INTERRUPTED;
+    return OPTIMISE_COMPLETE;
+  }
+
+  /****************************************************************************
+    Count the nodes that changed community between two memberships, whose
+    labels need not correspond, e.g. because the communities were renumbered.
+    Each community before is matched to at most one community after, taking
+    the pairs that share the most nodes first, and the nodes outside their
+    matched community count as moved. Two communities that merge thus count
+    the nodes of the smaller one as moved, and a renumbering counts nothing.
+  *****************************************************************************/
+  size_t count_moved_nodes(vector<size_t> const& before, vector<size_t> const& after)
+  {
+    size_t n = before.size();
+    if (n == 0)
+      return 0;
+
+    vector< std::pair<size_t, size_t> > pairs(n);
+    for (size_t v = 0; v < n; v++)
+      pairs[v] = std::make_pair(before[v], after[v]);
+    sort(pairs.begin(), pairs.end());
+
+    // Number of nodes shared by each pair of communities before and after
+    vector< std::tuple<size_t, size_t, size_t> > overlaps;
+    size_t nb_before = 0, nb_after = 0;
+    for (size_t i = 0; i < n; )
+    {
+      size_t j = i;
+      while (j < n && pairs[j] == pairs[i])
+        j++;
+      overlaps.push_back(std::make_tuple(j - i, pairs[i].first, pairs[i].second));
+      nb_before = std::max(nb_before, pairs[i].first + 1);
+      nb_after = std::max(nb_after, pairs[i].second + 1);
+      i = j;
+    }
+    sort(overlaps.begin(), overlaps.end(), std::greater< std::tuple<size_t, size_t, size_t> >());
+
+    vector<bool> is_matched_before(nb_before, false);
+    vector<bool> is_matched_after(nb_after, false);
+    size_t stayed = 0;
+    for (std::tuple<size_t, size_t, size_t> const& overlap : overlaps)
+    {
+      size_t c_before = std::get<1>(overlap);
+      size_t c_after = std::get<2>(overlap);
+      if (is_matched_before[c_before] || is_matched_after[c_after])
+        continue;
+      is_matched_before[c_before] = true;
+      is_matched_after[c_after] = true;
+      stayed += std::get<0>(overlap);
+    }
+    return n - stayed;
+  }
+
+  /****************************************************************************
+    Report the progress to the progress callback, if any, unless the last
+    report was less than the progress interval ago. A Python callable is
+    passed a dict with the fields of optimise_progress_t, and may stop the
+    optimisation by raising an exception or by cancelling the optimiser. This
+    is called without the GIL, which is only taken for a Python callable.
+  *****************************************************************************/
+  int report_progress(optimiser_workspace_t* workspace)
+  {
+    PyObject* py_callback = workspace->progress_callback;
+    if (py_callback == NULL)
+      return OPTIMISE_COMPLETE;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (workspace->has_reported && now - workspace->last_progress < workspace->progress_interval)
+      return OPTIMISE_COMPLETE;
+    workspace->has_reported = true;
+    workspace->last_progress = now;
+
+    optimise_progress_t const& progress = workspace->progress;
+    if (workspace->native_progress != NULL)
+    {
+      if (workspace->native_progress(&progress, workspace->native_progress_data) != 0)
+        return OPTIMISE_CANCELLED;
+      return OPTIMISE_COMPLETE;
+    }
+
+    PyGILState_STATE gil_state = PyGILState_Ensure();
+    PyObject* py_progress = Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:d}",
+                                          "iteration", (Py_ssize_t)progress.iteration,
+                                          "level", (Py_ssize_t)progress.level,
+                                          "level_nodes", (Py_ssize_t)progress.level_nodes,
+                                          "nodes_processed", (Py_ssize_t)progress.nodes_processed,
+                                          "moves", (Py_ssize_t)progress.moves,
+                                          "improvement", progress.improvement);
+    PyObject* py_result = NULL;
+    if (py_progress != NULL)
+    {
+      py_result = PyObject_CallFunctionObjArgs(py_callback, py_progress, NULL);
+      Py_DECREF(py_progress);
+    }
+    int status = (py_result != NULL) ? OPTIMISE_COMPLETE : OPTIMISE_INTERRUPTED;
+    Py_XDECREF(py_result);
+    PyGILState_Release(gil_state);
+    return status;
+  }
+
+  bool set_progress_callback(optimiser_workspace_t* workspace, PyObject* py_progress, double progress_interval)
+  {
+    if (py_progress == Py_None)
+      py_progress = NULL;
+    if (py_progress != NULL && !PyCallable_Check(py_progress) &&
+        !PyCapsule_IsValid(py_progress, "leidenalg.progress_callback"))
+    {
+      PyErr_SetString(PyExc_TypeError, "Progress should be callable or a capsule of a progress callback.");
+      return false;
+    }
+    workspace->progress_callback = py_progress;
+    workspace->native_progress = NULL;
+    workspace->native_progress_data = NULL;
+    if (py_progress != NULL && PyCapsule_IsValid(py_progress, "leidenalg.progress_callback"))
+    {
+      workspace->native_progress = (progress_callback_t) PyCapsule_GetPointer(py_progress, "leidenalg.progress_callback");
+      workspace->native_progress_data = PyCapsule_GetContext(py_progress);
+    }
+    workspace->progress_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                     std::chrono::duration<double>(progress_interval));
+    return true;
+  }
+
+  /****************************************************************************
+    Delete the aggregate graphs and partitions of a level, but never the
+    original partitions and their graphs. A graph may have no partition yet,
+    if creating the partition failed.
+  *****************************************************************************/
+  void release_level(vector<MutableVertexPartition*> const& partitions,
+                     vector<Graph*>& level_graphs, vector<MutableVertexPartition*>& level_partitions)
+  {
+    for (size_t layer = 0; layer < level_partitions.size(); layer++)
+    {
+      if (level_partitions[layer] != NULL && level_partitions[layer] != partitions[layer])
+        delete level_partitions[layer];
+      if (level_graphs[layer] != NULL && level_graphs[layer] != partitions[layer]->get_graph())
+        delete level_graphs[layer];
+      level_partitions[layer] = NULL;
+      level_graphs[layer] = NULL;
+    }
+  }
+
+  void release_sub_partitions(optimiser_workspace_t* workspace)
+  {
+    for (MutableVertexPartition*& sub_collapsed_partition : workspace->sub_collapsed_partitions)
+    {
+      delete sub_collapsed_partition;
+      sub_collapsed_partition = NULL;
+    }
+  }
+
+  /****************************************************************************
+    Delete everything optimise_partition_levels still holds: the current
+    level, the refined partitions, and the next level, which is only partly
+    built if collapse_graph or create threw.
+  *****************************************************************************/
+  void release_levels(vector<MutableVertexPartition*> const& partitions, optimiser_workspace_t* workspace)
+  {
+    release_level(partitions, workspace->collapsed_graphs, workspace->collapsed_partitions);
+    release_level(partitions, workspace->new_collapsed_graphs, workspace->new_collapsed_partitions);
+    release_sub_partitions(workspace);
+  }
+
+  /****************************************************************************
+    Record the estimated memory held at this point of optimise_partition_levels
+    in the peak memory usage: the original partitions and their graphs, plus
+    the aggregate graphs and partitions of the current and the next level. The
+    refined partitions share the graph of their level.
+  *****************************************************************************/
+  void track_memory_usage(vector<MutableVertexPartition*> const& partitions, optimiser_workspace_t* workspace)
+  {
+    size_t usage = 0;
+    for (size_t layer = 0; layer < partitions.size(); layer++)
+    {
+      usage += estimate_memory_usage(partitions[layer]).total();
+
+      MutableVertexPartition* collapsed_partition = workspace->collapsed_partitions[layer];
+      if (collapsed_partition != NULL && collapsed_partition != partitions[layer])
+        usage += estimate_memory_usage(collapsed_partition).total();
+
+      if (workspace->sub_collapsed_partitions[layer] != NULL)
+        usage += estimate_memory_usage(workspace->sub_collapsed_partitions[layer]).partition();
+
+      if (workspace->new_collapsed_partitions[layer] != NULL)
+        usage += estimate_memory_usage(workspace->new_collapsed_partitions[layer]).total();
+      else if (workspace->new_collapsed_graphs[layer] != NULL)
+        usage += estimate_graph_memory_usage(workspace->new_collapsed_graphs[layer]->vcount(),
+                                             workspace->new_collapsed_graphs[layer]->ecount()).total();
+    }
+    workspace->peak_memory_usage = std::max(workspace->peak_memory_usage, usage);
+  }
+
+  /****************************************************************************
+    Index the appearances of each node of the multiplex in the layers, so that
+    a node only visits the layers that contain it.
+  *****************************************************************************/
+  void index_lean_layers(lean_layers_t& layers)
+  {
+    size_t n = layers.node_sizes.size();
+    size_t nb_layers = layers.layer_nodes.size();
+    vector<size_t>& offsets = layers.appearance_offsets;
+    offsets.assign(n + 1, 0);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+      for (size_t v : layers.layer_nodes[layer])
+        offsets[v + 1]++;
+    for (size_t v = 0; v < n; v++)
+      offsets[v + 1] += offsets[v];
+
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    layers.appearances.resize(offsets[n]);
+    for (size_t layer = 0; layer < nb_layers; layer++)
+    {
+      vector<size_t> const& nodes = layers.layer_nodes[layer];
+      for (size_t i = 0; i < nodes.size(); i++)
+        layers.appearances[next[nodes[i]]++] = std::make_pair(layer, i);
+    }
+  }
+
+  /****************************************************************************
+    Set the membership of the multiplex, whose communities should be smaller
+    than the number of nodes, and set the membership of each layer to match.
+    The communities of a layer are numbered in order of appearance.
+  *****************************************************************************/
+  void set_lean_membership(lean_partition_t& partition, vector<size_t> const& membership)
+  {
+    lean_layers_t const& layers = *partition.layers;
+    size_t n = layers.node_sizes.size();
+    size_t nb_layers = partition.partitions.size();
+
+    partition.membership = membership;
+    partition.comm_sizes.assign(n, 0.0);
+    partition.comm_nodes.assign(n, 0);
+    for (size_t v = 0; v < n; v++)
+    {
+      partition.comm_sizes[membership[v]] += layers.node_sizes[v];
+      partition.comm_nodes[membership[v]]++;
+    }
+    // Empty communities are taken from the back, lowest first
+    partition.empty_comms.clear();
+    for (size_t comm = n; comm-- > 0; )
+      if (partition.comm_nodes[comm] == 0)
+        partition.empty_comms.push_back(comm);
+
+    partition.layer_comms.resize(nb_layers);
+    vector<size_t> layer_membership;
+    for (size_t layer = 0; layer < nb_layers; layer++)
+    {
+      unordered_map<size_t, size_t>& layer_comms = partition.layer_comms[layer];
+      vector<size_t> const& nodes = layers.layer_nodes[layer];
+      layer_comms.clear();
+      layer_membership.resize(nodes.size());
+      for (size_t i = 0; i < nodes.size(); i++)
+      {
+        size_t comm = membership[nodes[i]];
+        auto it = layer_comms.find(comm);
+        if (it == layer_comms.end())
+          it = layer_comms.insert(std::make_pair(comm, layer_comms.size())).first;
+        layer_membership[i] = it->second;
+      }
+      partition.partitions[layer]->set_membership(layer_membership);
+    }
+  }
+
+  /****************************************************************************
+    Community of a layer that node i of the layer moves to when its node of
+    the multiplex moves to comm: the community of comm in the layer if it has
+    nodes in the layer, and an empty community otherwise, for which i keeps
+    its own community if it is on its own in the layer.
+  *****************************************************************************/
+  inline size_t lean_layer_comm(lean_partition_t& partition, size_t layer, size_t i, size_t comm)
+  {
+    unordered_map<size_t, size_t> const& layer_comms = partition.layer_comms[layer];
+    auto it = layer_comms.find(comm);
+    if (it != layer_comms.end())
+      return it->second;
+    MutableVertexPartition* layer_partition = partition.partitions[layer];
+    size_t i_comm = layer_partition->membership(i);
+    if (layer_partition->cnodes(i_comm) == 1)
+      return i_comm;
+    return layer_partition->get_empty_community();
+  }
+
+  // Improvement of moving node v of the multiplex to comm, which only sums
+  // over the layers that contain v.
+  double lean_diff_move(lean_partition_t& partition, vector<double> const& layer_weights, size_t v, size_t comm)
+  {
+    lean_layers_t const& layers = *partition.layers;
+    double diff = 0.0;
+    for (size_t a = layers.appearance_offsets[v]; a < layers.appearance_offsets[v + 1]; a++)
+    {
+      size_t layer = layers.appearances[a].first;
+      size_t i = layers.appearances[a].second;
+      size_t layer_comm = lean_layer_comm(partition, layer, i, comm);
+      diff += layer_weights[layer]*partition.partitions[layer]->diff_move(i, layer_comm);
+    }
+    return diff;
+  }
+
+  void lean_move_node(lean_partition_t& partition, size_t v, size_t comm)
+  {
+    lean_layers_t const& layers = *partition.layers;
+    size_t v_comm = partition.membership[v];
+    for (size_t a = layers.appearance_offsets[v]; a < layers.appearance_offsets[v + 1]; a++)
+    {
+      size_t layer = layers.appearances[a].first;
+      size_t i = layers.appearances[a].second;
+      MutableVertexPartition* layer_partition = partition.partitions[layer];
+      unordered_map<size_t, size_t>& layer_comms = partition.layer_comms[layer];
+      size_t old_layer_comm = layer_partition->membership(i);
+      size_t new_layer_comm = lean_layer_comm(partition, layer, i, comm);
+      if (new_layer_comm != old_layer_comm)
+        layer_partition->move_node(i, new_layer_comm);
+      // A community of the layer only stands for a community of the multiplex
+      // while it has nodes in the layer.
+      if (new_layer_comm == old_layer_comm || layer_partition->cnodes(old_layer_comm) == 0)
+        layer_comms.erase(v_comm);
+      layer_comms[comm] = new_layer_comm;
+    }
+
+    if (partition.comm_nodes[comm] == 0)
+    {
+      vector<size_t>& empty_comms = partition.empty_comms;
+      auto it = std::find(empty_comms.rbegin(), empty_comms.rend(), comm);
+      if (it != empty_comms.rend())
+        empty_comms.erase(std::next(it).base());
+    }
+    double v_size = layers.node_sizes[v];
+    partition.comm_sizes[comm] += v_size;
+    partition.comm_nodes[comm]++;
+    partition.comm_sizes[v_comm] -= v_size;
+    partition.comm_nodes[v_comm]--;
+    if (partition.comm_nodes[v_comm] == 0)
+      partition.empty_comms.push_back(v_comm);
+    partition.membership[v] = comm;
+  }
+
+  /****************************************************************************
+    Move nodes of a lean multiplex partition as move_nodes_fused does with
+    ALL_NEIGH_COMMS, or only merge nodes that are on their own if merge is
+    true, within their community of the constrained membership, if given.
+    The candidates are the communities of the neighbours of a node in the
+    layers that contain it, and the size of a community for max_comm_size is
+    its number of individual nodes.
+  *****************************************************************************/
+  double move_nodes_lean(Optimiser* optimiser, lean_partition_t& partition, vector<double> const& layer_weights,
+                         bool merge, vector<size_t> const* constrained_membership, optimiser_workspace_t* workspace)
+  {
+    const size_t poll_interval = 4096;
+
+    lean_layers_t const& layers = *partition.layers;
+    size_t n = layers.node_sizes.size();
+    size_t max_comm_size = optimiser->max_comm_size;
+    bool consider_empty_community = optimiser->consider_empty_community && !merge && constrained_membership == NULL;
+    std::mt19937_64& rng = workspace->rng;
+
+    vector<size_t>& nodes = workspace->nodes;
+    nodes.resize(n);
+    for (size_t v = 0; v < n; v++)
+      nodes[v] = v;
+    for (size_t i = nodes.size(); i > 1; i--)
+      std::swap(nodes[i - 1], nodes[random_index(rng, i)]);
+
+    std::deque<size_t>& node_queue = workspace->node_queue;
+    node_queue.assign(nodes.begin(), nodes.end());
+    vector<bool>& is_node_stable = workspace->is_node_stable;
+    is_node_stable.assign(n, false);
+
+    vector<size_t>& comms = workspace->candidate_comms;
+    vector<bool>& is_candidate_comm = workspace->is_candidate_comm;
+    is_candidate_comm.assign(n, false);
+    comms.clear();
+
+    double total_improv = 0.0;
+    size_t nb_processed = 0;
+    while (!node_queue.empty())
+    {
+      size_t v = node_queue.front();
+      node_queue.pop_front();
+
+      if (++nb_processed % poll_interval == 0)
+      {
+        int status = poll_optimise_status(workspace);
+        if (status != OPTIMISE_COMPLETE)
+        {
+          workspace->status = status;
+          break;
+        }
+      }
+
+      size_t v_comm = partition.membership[v];
+      // Merging only moves nodes that are still on their own
+      if (merge && partition.comm_nodes[v_comm] != 1)
+        continue;
+
+      for (size_t a = layers.appearance_offsets[v]; a < layers.appearance_offsets[v + 1]; a++)
+      {
+        size_t layer = layers.appearances[a].first;
+        vector<size_t> const& layer_nodes = layers.layer_nodes[layer];
+        Graph* graph = partition.partitions[layer]->get_graph();
+        for (size_t u : graph->get_neighbours(layers.appearances[a].second, IGRAPH_ALL))
+        {
+          u = layer_nodes[u];
+          if (constrained_membership != NULL && (*constrained_membership)[u] != (*constrained_membership)[v])
+            continue;
+          size_t comm = partition.membership[u];
+          if (comm != v_comm && !is_candidate_comm[comm])
+          {
+            is_candidate_comm[comm] = true;
+            comms.push_back(comm);
+          }
+        }
+      }
+
+      // Also consider an empty community, if the node is not on its own
+      if (consider_empty_community && partition.comm_nodes[v_comm] > 1 && !partition.empty_comms.empty())
+      {
+        size_t empty_comm = partition.empty_comms.back();
+        if (!is_candidate_comm[empty_comm])
+        {
+          is_candidate_comm[empty_comm] = true;
+          comms.push_back(empty_comm);
+        }
+      }
+
+      // Find the best candidate, staying if the node is in a community that is
+      // too large already. Merging also accepts a move without improvement.
+      double v_size = layers.node_sizes[v];
+      size_t max_comm = v_comm;
+      double max_improv = (0 < max_comm_size && max_comm_size < partition.comm_sizes[v_comm]) ?
+                          -std::numeric_limits<double>::infinity() : 0;
+      for (size_t comm : comms)
+      {
+        is_candidate_comm[comm] = false;
+        if (0 < max_comm_size && max_comm_size < partition.comm_sizes[comm] + v_size)
+          continue;
+
+        double possible_improv = lean_diff_move(partition, layer_weights, v, comm);
+        if (merge ? possible_improv >= max_improv : possible_improv > max_improv)
+        {
+          max_comm = comm;
+          max_improv = possible_improv;
+        }
+      }
+      comms.clear();
+
+      if (!merge)
+        is_node_stable[v] = true;
+
+      if (max_comm != v_comm)
+      {
+        total_improv += max_improv;
+        lean_move_node(partition, v, max_comm);
+
+        // The neighbours that are not in the new community may now prefer to
+        // move as well.
+        if (!merge)
+        {
+          for (size_t a = layers.appearance_offsets[v]; a < layers.appearance_offsets[v + 1]; a++)
+          {
+            size_t layer = layers.appearances[a].first;
+            vector<size_t> const& layer_nodes = layers.layer_nodes[layer];
+            Graph* graph = partition.partitions[layer]->get_graph();
+            for (size_t u : graph->get_neighbours(layers.appearances[a].second, IGRAPH_ALL))
+            {
+              u = layer_nodes[u];
+              if (is_node_stable[u] && partition.membership[u] != max_comm &&
+                  (constrained_membership == NULL || (*constrained_membership)[u] == (*constrained_membership)[v]))
+              {
+                node_queue.push_back(u);
+                is_node_stable[u] = false;
+              }
+            }
+          }
+        }
+      }
+    }
+    node_queue.clear();
+
+    return total_improv;
+  }
+
+  // Delete the partitions of the layers of an aggregate level, and their
+  // graphs unless they belong to the level that is refined.
+  void release_lean_partition(lean_partition_t& partition, bool release_graphs)
+  {
+    for (MutableVertexPartition*& layer_partition : partition.partitions)
+    {
+      if (layer_partition == NULL)
+        continue;
+      Graph* graph = layer_partition->get_graph();
+      delete layer_partition;
+      if (release_graphs)
+        delete graph;
+      layer_partition = NULL;
+    }
+  }
+
+  /****************************************************************************
+    Run one iteration of the Leiden algorithm on a multiplex partition whose
+    layers only contain the nodes that are active in them, given for each
+    layer as the node of the multiplex of each of its nodes. The membership of
+    the multiplex is passed in and updated, and the partitions of the layers
+    are set to match. Moving a node only visits the layers that contain it,
+    and each aggregate level again only contains the aggregate nodes that are
+    active in a layer, so that the work and memory of a layer are
+    proportional to its own nodes and edges throughout.
+
+    Otherwise this follows optimise_partition_levels: move the nodes, refine
+    the communities within each community, and aggregate each layer by the
+    refinement, until the aggregation no longer reduces the number of nodes.
+    It supports the routines, the refinement, empty communities and the
+    maximal community size of the optimiser, with ALL_NEIGH_COMMS.
+  *****************************************************************************/
+  double optimise_partition_lean(Optimiser* optimiser,
+                                 vector<MutableVertexPartition*> const& partitions,
+                                 vector< vector<size_t> > const& layer_nodes,
+                                 vector<double> const& layer_weights,
+                                 vector<size_t>& membership,
+                                 optimiser_workspace_t* workspace)
+  {
+    size_t nb_layers = partitions.size();
+    size_t n = membership.size();
+
+    lean_layers_t base_layers;
+    base_layers.node_sizes.assign(n, 1.0);
+    base_layers.layer_nodes = layer_nodes;
+    index_lean_layers(base_layers);
+
+    lean_partition_t base;
+    base.layers = &base_layers;
+    base.partitions = partitions;
+    set_lean_membership(base, membership);
+
+    // The current level is the base level until the first aggregation, after
+    // which its layers and partitions are owned here.
+    lean_layers_t level_layers;
+    lean_partition_t level_partition;
+    lean_partition_t refined;
+    lean_partition_t next;
+    lean_partition_t* level = &base;
+
+    vector<size_t> aggregate_node_per_individual_node = range(n);
+    vector<size_t> aggregate_id;
+    vector<size_t> comm_id;
+
+    double total_improv = 0.0;
+    bool aggregate_further = true;
+    workspace->progress.level = 0;
+    try
+    {
+      do
+      {
+        workspace->status = poll_optimise_status(workspace);
+        if (workspace->status != OPTIMISE_COMPLETE)
+          break;
+
+        lean_layers_t const& layers = *level->layers;
+        size_t level_n = layers.node_sizes.size();
+        if (workspace->progress_callback != NULL)
+          workspace->level_membership = level->membership;
+
+        bool merge = (optimiser->optimise_routine == Optimiser::MERGE_NODES);
+        double improv = move_nodes_lean(optimiser, *level, layer_weights, merge, NULL, workspace);
+        total_improv += improv;
+
+        size_t level_moves = 0;
+        if (workspace->progress_callback != NULL)
+          level_moves = count_moved_nodes(workspace->level_membership, level->membership);
+
+        // Carry the communities of this level back to the individual nodes.
+        for (size_t v = 0; v < n; v++)
+          membership[v] = level->membership[aggregate_node_per_individual_node[v]];
+        if (workspace->status != OPTIMISE_COMPLETE)
+          break;
+
+        // Refine the communities, starting from singletons, and aggregate
+        // based on the refinement.
+        lean_partition_t* aggregate = level;
+        if (optimiser->refine_partition)
+        {
+          refined.layers = &layers;
+          refined.partitions.assign(nb_layers, NULL);
+          for (size_t layer = 0; layer < nb_layers; layer++)
+            refined.partitions[layer] = level->partitions[layer]->create(level->partitions[layer]->get_graph());
+          set_lean_membership(refined, range(level_n));
+          bool refine_merge = (optimiser->refine_routine == Optimiser::MERGE_NODES);
+          move_nodes_lean(optimiser, refined, layer_weights, refine_merge, &level->membership, workspace);
+          if (workspace->status != OPTIMISE_COMPLETE)
+            break;
+          aggregate = &refined;
+        }
+
+        // The communities of the aggregate partition are the nodes of the next
+        // level, and these start out in the community of the level that
+        // contains them. Both are numbered consecutively.
+        aggregate_id.assign(level_n, level_n);
+        size_t next_n = 0;
+        for (size_t comm = 0; comm < level_n; comm++)
+          if (aggregate->comm_nodes[comm] > 0)
+            aggregate_id[comm] = next_n++;
+        for (size_t v = 0; v < n; v++)
+          aggregate_node_per_individual_node[v] = aggregate_id[aggregate->membership[aggregate_node_per_individual_node[v]]];
+
+        lean_layers_t next_layers;
+        next_layers.node_sizes.assign(next_n, 0.0);
+        next_layers.layer_nodes.resize(nb_layers);
+        vector<size_t> next_membership(next_n, 0);
+        comm_id.assign(level_n, level_n);
+        size_t nb_comms = 0;
+        for (size_t v = 0; v < level_n; v++)
+        {
+          size_t w = aggregate_id[aggregate->membership[v]];
+          size_t comm = level->membership[v];
+          if (comm_id[comm] == level_n)
+            comm_id[comm] = nb_comms++;
+          next_layers.node_sizes[w] += layers.node_sizes[v];
+          next_membership[w] = comm_id[comm];
+        }
+
+        // Each layer only aggregates its own communities, which are
+        // renumbered first so that it has no empty communities.
+        next.partitions.assign(nb_layers, NULL);
+        for (size_t layer = 0; layer < nb_layers; layer++)
+        {
+          MutableVertexPartition* layer_partition = aggregate->partitions[layer];
+          layer_partition->renumber_communities();
+          Graph* next_graph = layer_partition->get_graph()->collapse_graph(layer_partition);
+          try
+          {
+            next.partitions[layer] = level->partitions[layer]->create(next_graph);
+          }
+          catch (...)
+          {
+            delete next_graph;
+            throw;
+          }
+          vector<size_t> const& nodes = layers.layer_nodes[layer];
+          vector<size_t>& next_nodes = next_layers.layer_nodes[layer];
+          next_nodes.assign(next_graph->vcount(), 0);
+          for (size_t i = 0; i < nodes.size(); i++)
+            next_nodes[layer_partition->membership(i)] = aggregate_id[aggregate->membership[nodes[i]]];
+        }
+        index_lean_layers(next_layers);
+
+        aggregate_further = (next_n < level_n) && (level_n > nb_comms);
+
+        // Replace the level by the next level. The base level keeps the
+        // partitions of the caller.
+        release_lean_partition(refined, false);
+        if (level != &base)
+          release_lean_partition(level_partition, true);
+        level_layers = std::move(next_layers);
+        level_partition.partitions.swap(next.partitions);
+        level_partition.layers = &level_layers;
+        set_lean_membership(level_partition, next_membership);
+        level = &level_partition;
+
+        workspace->progress.level_nodes = level_n;
+        workspace->progress.nodes_processed += level_n;
+        workspace->progress.moves += level_moves;
+        workspace->progress.improvement += improv;
+        workspace->status = report_progress(workspace);
+        if (workspace->status != OPTIMISE_COMPLETE)
+          break;
+        workspace->progress.level++;
+      } while (aggregate_further);
+    }
+    catch (...)
+    {
+      release_lean_partition(refined, false);
+      release_lean_partition(next, true);
+      release_lean_partition(level_partition, true);
+      set_lean_membership(base, membership);
+      throw;
+    }
+    workspace->progress.iteration++;
+    release_lean_partition(refined, false);
+    release_lean_partition(level_partition, true);
+
+    // Number the communities consecutively by decreasing size, as
+    // renumber_communities does, and set the layers to match.
+    vector<size_t> comm_sizes(n, 0);
+    for (size_t v = 0; v < n; v++)
+      comm_sizes[membership[v]]++;
+    vector<size_t> comms;
+    for (size_t comm = 0; comm < n; comm++)
+      if (comm_sizes[comm] > 0)
+        comms.push_back(comm);
+    std::stable_sort(comms.begin(), comms.end(),
+                     [&comm_sizes](size_t a, size_t b) { return comm_sizes[a] > comm_sizes[b]; });
+    comm_id.assign(n, 0);
+    for (size_t c = 0; c < comms.size(); c++)
+      comm_id[comms[c]] = c;
+    for (size_t v = 0; v < n; v++)
+      membership[v] = comm_id[membership[v]];
+    set_lean_membership(base, membership);
+
+    return total_improv;
+  }
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  PyObject* _new_Optimiser(PyObject *self, PyObject *args)
+  {
+    if (args != NULL)
+    {
+      PyErr_BadArgument();
+      return NULL;
+    }
+
+    Optimiser* optimiser = new Optimiser();
+    PyObject* py_optimiser = capsule_Optimiser(optimiser);
     return py_optimiser;
   }
 
-  Optimiser* decapsule_Optimiser(PyObject* py_optimiser)
-  {
-    Optimiser* optimiser = (Optimiser*) PyCapsule_GetPointer(py_optimiser, "leidenalg.Optimiser");
-    return optimiser;
-  }
+  PyObject* _Optimiser_optimise_partition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    PyObject* py_partition = NULL;
+    PyObject* py_is_membership_fixed = NULL;
+    PyObject* py_fixed_nodes = NULL;
+    int return_levels = false;
+    char* py_aggregate_order = NULL;
+    PyObject* py_progress = NULL;
+    double progress_interval = 0.0;
+
+    static const char* kwlist[] = {"optimiser", "partition", "is_membership_fixed", "fixed_nodes", "return_levels", "aggregate_order",
+                                   "progress", "progress_interval", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OOpzOd", (char**) kwlist,
+                                     &py_optimiser, &py_partition,
+                                     &py_is_membership_fixed, &py_fixed_nodes,
+                                     &return_levels, &py_aggregate_order,
+                                     &py_progress, &progress_interval))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "optimise_partition(" << py_partition << ", is_membership_fixed=" << py_is_membership_fixed << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    partition_lock_t lock({py_partition});
+
+    size_t n = partition->get_graph()->vcount();
+    vector<bool> is_membership_fixed;
+    int aggregate_order = AGGREGATE_ORDER_NONE;
+    try
+    {
+      is_membership_fixed = create_is_membership_fixed(py_is_membership_fixed, py_fixed_nodes, n);
+      aggregate_order = parse_aggregate_order(py_aggregate_order);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    if (!set_progress_callback(workspace, py_progress, progress_interval))
+      return NULL;
+
+    double q = 0.0;
+    vector< vector<size_t> > levels;
+    string error;
+    // The driver only takes the GIL to check for signals and to report progress.
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+      q = optimise_partition_run(optimiser, vector<MutableVertexPartition*>(1, partition),
+                                 vector<double>(1, 1.0), is_membership_fixed, aggregate_order,
+                                 return_levels ? &levels : NULL, workspace);
+    }
+    catch (std::exception& e)
+    {
+      error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    workspace->progress_callback = NULL;
+
+    if (!error.empty())
+    {
+      PyErr_SetString(PyExc_ValueError, error.c_str());
+      return NULL;
+    }
+
+    if (workspace->status == OPTIMISE_INTERRUPTED)
+      return NULL;
+
+    if (!return_levels)
+      return PyFloat_FromDouble(q);
+
+    // Each level is returned as a packed int64 array.
+    PyObject* py_levels = PyList_New(levels.size());
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+      vector<int64_t> level(levels[l].begin(), levels[l].end());
+      PyObject* py_level = PyBytes_FromStringAndSize((const char*)level.data(), level.size()*sizeof(int64_t));
+      PyList_SetItem(py_levels, l, py_level);
+    }
+    return Py_BuildValue("dN", q, py_levels);
+  }
+
+  PyObject* _Optimiser_optimise_partition_multiplex(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    PyObject* py_partitions = NULL;
+    PyObject* py_layer_weights = NULL;
+    PyObject* py_is_membership_fixed = NULL;
+    PyObject* py_fixed_nodes = NULL;
+    char* py_aggregate_order = NULL;
+    PyObject* py_progress = NULL;
+    double progress_interval = 0.0;
+
+    static const char* kwlist[] = {"optimiser", "partitions", "layer_weights", "is_membership_fixed", "fixed_nodes", "aggregate_order",
+                                   "progress", "progress_interval", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|OOzOd", (char**) kwlist,
+                                     &py_optimiser, &py_partitions,
+                                     &py_layer_weights, &py_is_membership_fixed,
+                                     &py_fixed_nodes, &py_aggregate_order,
+                                     &py_progress, &progress_interval))
+        return NULL;
+
+    // The partitions are used without the GIL, so they are kept alive by a
+    // snapshot of the list rather than borrowed from a list that another thread
+    // may modify.
+    py_snapshot_t py_partition_items(py_partitions);
+    py_snapshot_t py_layer_weight_items(py_layer_weights);
+    if (py_partition_items.py_tuple == NULL || py_layer_weight_items.py_tuple == NULL)
+      return NULL;
+
+    size_t nb_partitions = py_partition_items.size();
+    if (nb_partitions != py_layer_weight_items.size())
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of layer weights does not equal the number of partitions");
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Parsing " << nb_partitions << " partitions." << endl;
+    #endif
+
+    // This is all done per layer.
+
+    vector<MutableVertexPartition*> partitions(nb_partitions);
+    vector<PyObject*> py_partition_list(nb_partitions);
+    vector<double> layer_weights(nb_partitions, 1.0);
+
+    for (size_t layer = 0; layer < nb_partitions; layer++)
+    {
+      PyObject* py_partition = py_partition_items[layer];
+      py_partition_list[layer] = py_partition;
+      #ifdef DEBUG
+        cerr << "Capsule partition at address " << py_partition << endl;
+      #endif
+      MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+      #ifdef DEBUG
+        cerr << "Using partition at address " << partition << endl;
+      #endif
+
+      PyObject* layer_weight = py_layer_weight_items[layer];
+
+      partitions[layer] = partition;
+
+
+      if (PyNumber_Check(layer_weight))
+      {
+        layer_weights[layer] = PyFloat_AsDouble(layer_weight);
+      }
+      else
+      {
+        PyErr_SetString(PyExc_TypeError, "Expected floating value for layer weight.");
+        return NULL;
+      }
+
+      if (isnan(layer_weights[layer]))
+      {
+        PyErr_SetString(PyExc_TypeError, "Cannot accept NaN weights.");
+        return NULL;
+      }
+    }
+
+    if (nb_partitions == 0)
+      return NULL;
+
+    partition_lock_t lock(py_partition_list);
+
+    size_t n = partitions[0]->get_graph()->vcount();
+    vector<bool> is_membership_fixed;
+    int aggregate_order = AGGREGATE_ORDER_NONE;
+    try
+    {
+      is_membership_fixed = create_is_membership_fixed(py_is_membership_fixed, py_fixed_nodes, n);
+      aggregate_order = parse_aggregate_order(py_aggregate_order);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_TypeError, e.what());
+      return NULL;
+    }
+
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    if (!set_progress_callback(workspace, py_progress, progress_interval))
+      return NULL;
+
+    double q = 0.0;
+    string error;
+    // The driver only takes the GIL to check for signals and to report progress.
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+      q = optimise_partition_run(optimiser, partitions, layer_weights, is_membership_fixed, aggregate_order, NULL,
+                                 workspace);
+    }
+    catch (std::exception& e)
+    {
+      error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    workspace->progress_callback = NULL;
+
+    if (!error.empty())
+    {
+      PyErr_SetString(PyExc_ValueError, error.c_str());
+      return NULL;
+    }
+
+    if (workspace->status == OPTIMISE_INTERRUPTED)
+      return NULL;
+    return PyFloat_FromDouble(q);
+  }
+
+  PyObject* _Optimiser_optimise_partition_lean_multiplex(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    PyObject* py_partitions = NULL;
+    PyObject* py_layer_nodes = NULL;
+    PyObject* py_layer_weights = NULL;
+    PyObject* py_membership = NULL;
+    PyObject* py_progress = NULL;
+    double progress_interval = 0.0;
+
+    static const char* kwlist[] = {"optimiser", "partitions", "layer_nodes", "layer_weights", "membership",
+                                   "progress", "progress_interval", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOOO|Od", (char**) kwlist,
+                                     &py_optimiser, &py_partitions, &py_layer_nodes,
+                                     &py_layer_weights, &py_membership,
+                                     &py_progress, &progress_interval))
+        return NULL;
+
+    py_snapshot_t py_partition_items(py_partitions);
+    py_snapshot_t py_layer_node_items(py_layer_nodes);
+    py_snapshot_t py_layer_weight_items(py_layer_weights);
+    if (py_partition_items.py_tuple == NULL || py_layer_node_items.py_tuple == NULL ||
+        py_layer_weight_items.py_tuple == NULL)
+      return NULL;
+
+    size_t nb_partitions = py_partition_items.size();
+    if (nb_partitions == 0 || nb_partitions != py_layer_node_items.size() ||
+        nb_partitions != py_layer_weight_items.size())
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of layer nodes and layer weights should equal the number of partitions");
+      return NULL;
+    }
+
+    // The membership of the multiplex is passed as a packed int64 array, and
+    // so are the nodes of each layer, or None for a layer of all nodes.
+    if (!PyBytes_Check(py_membership) || PyBytes_Size(py_membership) % sizeof(int64_t) != 0)
+    {
+      PyErr_SetString(PyExc_TypeError, "Expected a packed int64 membership.");
+      return NULL;
+    }
+    size_t n = PyBytes_Size(py_membership) / sizeof(int64_t);
+    const int64_t* membership_data = (const int64_t*)PyBytes_AsString(py_membership);
+    vector<size_t> membership(n);
+    for (size_t v = 0; v < n; v++)
+    {
+      if (membership_data[v] < 0 || (size_t)membership_data[v] >= n)
+      {
+        PyErr_SetString(PyExc_ValueError, "Membership should be smaller than the number of nodes.");
+        return NULL;
+      }
+      membership[v] = membership_data[v];
+    }
+
+    vector<MutableVertexPartition*> partitions(nb_partitions);
+    vector<PyObject*> py_partition_list(nb_partitions);
+    vector<double> layer_weights(nb_partitions, 1.0);
+    vector< vector<size_t> > layer_nodes(nb_partitions);
+    vector<bool> is_layer_node;
+    for (size_t layer = 0; layer < nb_partitions; layer++)
+    {
+      PyObject* py_partition = py_partition_items[layer];
+      py_partition_list[layer] = py_partition;
+      MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+      if (partition == NULL)
+        return NULL;
+      partitions[layer] = partition;
+
+      PyObject* layer_weight = py_layer_weight_items[layer];
+      if (!PyNumber_Check(layer_weight))
+      {
+        PyErr_SetString(PyExc_TypeError, "Expected floating value for layer weight.");
+        return NULL;
+      }
+      layer_weights[layer] = PyFloat_AsDouble(layer_weight);
+      if (isnan(layer_weights[layer]))
+      {
+        PyErr_SetString(PyExc_TypeError, "Cannot accept NaN weights.");
+        return NULL;
+      }
+
+      size_t layer_n = partition->get_graph()->vcount();
+      PyObject* py_nodes = py_layer_node_items[layer];
+      if (py_nodes == Py_None)
+      {
+        if (layer_n != n)
+        {
+          PyErr_Format(PyExc_ValueError, "Layer %zu without layer nodes does not contain all nodes.", layer);
+          return NULL;
+        }
+        layer_nodes[layer] = range(n);
+        continue;
+      }
+      if (!PyBytes_Check(py_nodes) || (size_t)PyBytes_Size(py_nodes) != layer_n*sizeof(int64_t))
+      {
+        PyErr_Format(PyExc_ValueError, "Expected packed int64 nodes for each of the %zu nodes of layer %zu.", layer_n, layer);
+        return NULL;
+      }
+      const int64_t* nodes = (const int64_t*)PyBytes_AsString(py_nodes);
+      is_layer_node.assign(n, false);
+      layer_nodes[layer].resize(layer_n);
+      for (size_t i = 0; i < layer_n; i++)
+      {
+        if (nodes[i] < 0 || (size_t)nodes[i] >= n || is_layer_node[nodes[i]])
+        {
+          PyErr_Format(PyExc_ValueError, "Nodes of layer %zu should be distinct and smaller than the number of nodes.", layer);
+          return NULL;
+        }
+        is_layer_node[nodes[i]] = true;
+        layer_nodes[layer][i] = nodes[i];
+      }
+    }
 
-  void del_Optimiser(PyObject* py_optimiser)
-  {
     Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
-    delete optimiser;
-  }
-#ifdef __cplusplus
-extern "C"
-{
-#endif
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    if (optimiser->consider_comms != Optimiser::ALL_NEIGH_COMMS ||
+        optimiser->refine_consider_comms != Optimiser::ALL_NEIGH_COMMS || workspace->pruned_all_comms)
+    {
+      PyErr_SetString(PyExc_ValueError, "Layers with different nodes only consider the neighbouring communities (ALL_NEIGH_COMMS).");
+      return NULL;
+    }
+    if (optimiser->min_comm_size > 0 || optimiser->community_constraint_enforcement != 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Layers with different nodes do not support a minimal community size.");
+      return NULL;
+    }
 
-  PyObject* _new_Optimiser(PyObject *self, PyObject *args)
-  {
-    if (args != NULL)
+    partition_lock_t lock(py_partition_list);
+
+    if (!set_progress_callback(workspace, py_progress, progress_interval))
+      return NULL;
+
+    double q = 0.0;
+    string error;
+    Py_BEGIN_ALLOW_THREADS
+    try
     {
-      PyErr_BadArgument();
+      q = optimise_partition_lean(optimiser, partitions, layer_nodes, layer_weights, membership, workspace);
+    }
+    catch (std::exception& e)
+    {
+      error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    workspace->progress_callback = NULL;
+
+    if (!error.empty())
+    {
+      PyErr_SetString(PyExc_ValueError, error.c_str());
       return NULL;
     }
 
-    Optimiser* optimiser = new Optimiser();
-    PyObject* py_optimiser = capsule_Optimiser(optimiser);
-    return py_optimiser;
+    if (workspace->status == OPTIMISE_INTERRUPTED)
+      return NULL;
+
+    vector<int64_t> packed_membership(membership.begin(), membership.end());
+    return Py_BuildValue("dN", q,
+                         PyBytes_FromStringAndSize((const char*)packed_membership.data(), n*sizeof(int64_t)));
   }
 
-  PyObject* _Optimiser_optimise_partition(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_move_nodes(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
     PyObject* py_is_membership_fixed = NULL;
+    PyObject* py_fixed_nodes = NULL;
+    int consider_comms = -1;
 
-    static const char* kwlist[] = {"optimiser", "partition", "is_membership_fixed", NULL};
+    static const char* kwlist[] = {"optimiser", "partition", "is_membership_fixed", "consider_comms", "fixed_nodes", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|O", (char**) kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OiO", (char**) kwlist,
                                      &py_optimiser, &py_partition,
-                                     &py_is_membership_fixed))
+                                     &py_is_membership_fixed, &consider_comms,
+                                     &py_fixed_nodes))
         return NULL;
 
     #ifdef DEBUG
-      cerr << "optimise_partition(" << py_partition << ", is_membership_fixed=" << py_is_membership_fixed << ");" << endl;
+      cerr << "optimise_partition(" << py_partition << ");" << endl;
     #endif
 
     #ifdef DEBUG
@@ -72,32 +2241,31 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
+    partition_lock_t lock({py_partition});
+
     size_t n = partition->get_graph()->vcount();
-    vector<bool> is_membership_fixed(n, false);
-    if (py_is_membership_fixed != NULL && py_is_membership_fixed != Py_None)
+    vector<bool> is_membership_fixed;
+    try
     {
-      #ifdef DEBUG
-        cerr << "Reading is_membership_fixed." << endl;
-      #endif
-
-      size_t nb_is_membership_fixed = PyList_Size(py_is_membership_fixed);
-      if (nb_is_membership_fixed != n)
-      {
-        PyErr_SetString(PyExc_ValueError, "Membership fixed vector not the same size as the number of nodes.");
-        return NULL;
-      }
-
-      for (size_t v = 0; v < n; v++)
-      {
-        PyObject* py_item = PyList_GetItem(py_is_membership_fixed, v);
-        is_membership_fixed[v] = PyObject_IsTrue(py_item);
-      }
+      is_membership_fixed = create_is_membership_fixed(py_is_membership_fixed, py_fixed_nodes, n);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_TypeError, e.what());
+      return NULL;
     }
 
-    double q = 0.0;
+    if (consider_comms < 0)
+      consider_comms = decapsule_Optimiser_workspace(py_optimiser)->pruned_all_comms ? PRUNED_ALL_COMMS : optimiser->consider_comms;
+
+    double q  = 0.0;
     try
     {
-      q = optimiser->optimise_partition(partition, is_membership_fixed);
+      if (consider_comms == PRUNED_ALL_COMMS)
+        q = move_nodes_pruned(optimiser, vector<MutableVertexPartition*>(1, partition), vector<double>(1, 1.0),
+                              is_membership_fixed, true);
+      else
+        q = optimiser->move_nodes(partition, is_membership_fixed, consider_comms, true);
     }
     catch (std::exception& e)
     {
@@ -107,111 +2275,71 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
-  PyObject* _Optimiser_optimise_partition_multiplex(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_merge_nodes(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
-    PyObject* py_partitions = NULL;
-    PyObject* py_layer_weights = NULL;
+    PyObject* py_partition = NULL;
     PyObject* py_is_membership_fixed = NULL;
+    PyObject* py_fixed_nodes = NULL;
+    int consider_comms = -1;
 
-    static const char* kwlist[] = {"optimiser", "partitions", "layer_weights", "is_membership_fixed", NULL};
+    static const char* kwlist[] = {"optimiser", "partition", "is_membership_fixed", "consider_comms", "fixed_nodes", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|O", (char**) kwlist,
-                                     &py_optimiser, &py_partitions,
-                                     &py_layer_weights, &py_is_membership_fixed))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|OiO", (char**) kwlist,
+                                     &py_optimiser, &py_partition,
+                                     &py_is_membership_fixed, &consider_comms,
+                                     &py_fixed_nodes))
         return NULL;
 
-    size_t nb_partitions = (size_t)PyList_Size(py_partitions);
-    if (nb_partitions != (size_t)PyList_Size(py_layer_weights))
-    {
-      PyErr_SetString(PyExc_ValueError, "Number of layer weights does not equal the number of partitions");
-      return NULL;
-    }
+    #ifdef DEBUG
+      cerr << "optimise_partition(" << py_partition << ");" << endl;
+    #endif
 
     #ifdef DEBUG
-      cerr << "Parsing " << nb_partitions << " partitions." << endl;
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
-    // This is all done per layer.
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
 
-    vector<MutableVertexPartition*> partitions(nb_partitions);
-    vector<double> layer_weights(nb_partitions, 1.0);
+    partition_lock_t lock({py_partition});
 
-    for (size_t layer = 0; layer < nb_partitions; layer++)
+    size_t n = partition->get_graph()->vcount();
+    vector<bool> is_membership_fixed;
+    try
     {
-      PyObject* py_partition = PyList_GetItem(py_partitions, layer);
-      #ifdef DEBUG
-        cerr << "Capsule partition at address " << py_partition << endl;
-      #endif
-      MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
-      #ifdef DEBUG
-        cerr << "Using partition at address " << partition << endl;
-      #endif
-
-      PyObject* layer_weight = PyList_GetItem(py_layer_weights, layer);
-
-      partitions[layer] = partition;
-
-
-      if (PyNumber_Check(layer_weight))
-      {
-        layer_weights[layer] = PyFloat_AsDouble(layer_weight);
-      }
-      else
-      {
-        PyErr_SetString(PyExc_TypeError, "Expected floating value for layer weight.");
-        return NULL;
-      }
-
-      if (isnan(layer_weights[layer]))
-      {
-        PyErr_SetString(PyExc_TypeError, "Cannot accept NaN weights.");
-        return NULL;
-      }
+      is_membership_fixed = create_is_membership_fixed(py_is_membership_fixed, py_fixed_nodes, n);
     }
-
-    if (nb_partitions == 0)
-      return NULL;
-
-    size_t n = partitions[0]->get_graph()->vcount();
-    vector<bool> is_membership_fixed(n, false);
-    if (py_is_membership_fixed != NULL && py_is_membership_fixed != Py_None)
+    catch (std::exception& e)
     {
-      #ifdef DEBUG
-        cerr << "Reading is_membership_fixed." << endl;
-      #endif
-
-      size_t nb_is_membership_fixed = PyList_Size(py_is_membership_fixed);
-      if (nb_is_membership_fixed != n)
-      {
-        PyErr_SetString(PyExc_TypeError, "Membership fixed vector not the same size as the number of nodes.");
-        return NULL;
-      }
-
-      for (size_t v = 0; v < n; v++)
-      {
-        PyObject* py_item = PyList_GetItem(py_is_membership_fixed, v);
-        is_membership_fixed[v] = PyObject_IsTrue(py_item);
-      }
+      PyErr_SetString(PyExc_TypeError, e.what());
+      return NULL;
     }
 
-
-    #ifdef DEBUG
-      cerr << "Capsule optimiser at address " << py_optimiser << endl;
-    #endif
-    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
-    #ifdef DEBUG
-      cerr << "Using optimiser at address " << optimiser << endl;
-    #endif
+    if (consider_comms < 0)
+      consider_comms = decapsule_Optimiser_workspace(py_optimiser)->pruned_all_comms ? PRUNED_ALL_COMMS : optimiser->consider_comms;
 
     double q = 0.0;
     try
     {
-      q = optimiser->optimise_partition(partitions, layer_weights, is_membership_fixed);
+      if (consider_comms == PRUNED_ALL_COMMS)
+        q = merge_nodes_pruned(optimiser, vector<MutableVertexPartition*>(1, partition), vector<double>(1, 1.0),
+                               is_membership_fixed, true);
+      else
+        q = optimiser->merge_nodes(partition, is_membership_fixed, consider_comms, true);
     }
     catch (std::exception& e)
     {
@@ -221,22 +2349,21 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
-  PyObject* _Optimiser_move_nodes(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_move_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
-    PyObject* py_is_membership_fixed = NULL;
+    PyObject* py_constrained_partition = NULL;
     int consider_comms = -1;
 
-    static const char* kwlist[] = {"optimiser", "partition", "is_membership_fixed", "consider_comms", NULL};
+    static const char* kwlist[] = {"optimiser", "partition", "constrained_partition", "consider_comms", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|Oi", (char**) kwlist,
-                                     &py_optimiser, &py_partition,
-                                     &py_is_membership_fixed, &consider_comms))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|i", (char**) kwlist,
+                                     &py_optimiser, &py_partition, &py_constrained_partition, &consider_comms))
         return NULL;
 
     #ifdef DEBUG
@@ -259,35 +2386,23 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
-    size_t n = partition->get_graph()->vcount();
-    vector<bool> is_membership_fixed(n, false);
-    if (py_is_membership_fixed != NULL && py_is_membership_fixed != Py_None)
-    {
-      #ifdef DEBUG
-        cerr << "Reading is_membership_fixed." << endl;
-      #endif
-
-      size_t nb_is_membership_fixed = PyList_Size(py_is_membership_fixed);
-      if (nb_is_membership_fixed != n)
-      {
-        PyErr_SetString(PyExc_TypeError, "Membership fixed vector not the same size as the number of nodes.");
-        return NULL;
-      }
+    #ifdef DEBUG
+      cerr << "Capsule constrained partition at address " << py_constrained_partition << endl;
+    #endif
+    MutableVertexPartition* constrained_partition = decapsule_MutableVertexPartition(py_constrained_partition);
+    #ifdef DEBUG
+      cerr << "Using constrained partition at address " << constrained_partition << endl;
+    #endif
 
-      for (size_t v = 0; v < n; v++)
-      {
-        PyObject* py_item = PyList_GetItem(py_is_membership_fixed, v);
-        is_membership_fixed[v] = PyObject_IsTrue(py_item);
-      }
-    }
+    partition_lock_t lock({py_partition, py_constrained_partition});
 
     if (consider_comms < 0)
-      consider_comms = optimiser->consider_comms;
+      consider_comms = optimiser->refine_consider_comms;
 
-    double q  = 0.0;
+    double q = 0.0;
     try
     {
-      q = optimiser->move_nodes(partition, is_membership_fixed, consider_comms, true);
+      q = optimiser->move_nodes_constrained(partition, consider_comms, constrained_partition);
     }
     catch (std::exception& e)
     {
@@ -297,22 +2412,21 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
-  PyObject* _Optimiser_merge_nodes(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_merge_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
-    PyObject* py_is_membership_fixed = NULL;
+    PyObject* py_constrained_partition = NULL;
     int consider_comms = -1;
 
-    static const char* kwlist[] = {"optimiser", "partition", "is_membership_fixed", "consider_comms", NULL};
+    static const char* kwlist[] = {"optimiser", "partition", "constrained_partition", "consider_comms", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|Oi", (char**) kwlist,
-                                     &py_optimiser, &py_partition,
-                                     &py_is_membership_fixed, &consider_comms))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|i", (char**) kwlist,
+                                     &py_optimiser, &py_partition, &py_constrained_partition, &consider_comms))
         return NULL;
 
     #ifdef DEBUG
@@ -335,35 +2449,23 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
-    size_t n = partition->get_graph()->vcount();
-    vector<bool> is_membership_fixed(n, false);
-    if (py_is_membership_fixed != NULL && py_is_membership_fixed != Py_None)
-    {
-      #ifdef DEBUG
-        cerr << "Reading is_membership_fixed." << endl;
-      #endif
-
-      size_t nb_is_membership_fixed = PyList_Size(py_is_membership_fixed);
-      if (nb_is_membership_fixed != n)
-      {
-        PyErr_SetString(PyExc_TypeError, "Membership fixed vector not the same size as the number of nodes.");
-        return NULL;
-      }
+    #ifdef DEBUG
+      cerr << "Capsule constrained partition at address " << py_partition << endl;
+    #endif
+    MutableVertexPartition* constrained_partition = decapsule_MutableVertexPartition(py_constrained_partition);
+    #ifdef DEBUG
+      cerr << "Using constrained partition at address " << partition << endl;
+    #endif
 
-      for (size_t v = 0; v < n; v++)
-      {
-        PyObject* py_item = PyList_GetItem(py_is_membership_fixed, v);
-        is_membership_fixed[v] = PyObject_IsTrue(py_item);
-      }
-    }
+    partition_lock_t lock({py_partition, py_constrained_partition});
 
     if (consider_comms < 0)
-      consider_comms = optimiser->consider_comms;
+      consider_comms = optimiser->refine_consider_comms;
 
     double q = 0.0;
     try
     {
-      q = optimiser->merge_nodes(partition, is_membership_fixed, consider_comms, true);
+      q = optimiser->merge_nodes_constrained(partition, consider_comms, constrained_partition);
     }
     catch (std::exception& e)
     {
@@ -373,126 +2475,421 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
-  PyObject* _Optimiser_move_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_consensus_partition(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
-    PyObject* py_constrained_partition = NULL;
-    int consider_comms = -1;
+    int n_runs = 10;
+    int n_iterations = 2;
+    size_t seed = 0;
+    double threshold = 0.0;
+    int n_threads = 1;
 
-    static const char* kwlist[] = {"optimiser", "partition", "constrained_partition", "consider_comms", NULL};
+    static const char* kwlist[] = {"optimiser", "partition", "n_runs", "n_iterations", "seed", "threshold", "n_threads", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|i", (char**) kwlist,
-                                     &py_optimiser, &py_partition, &py_constrained_partition, &consider_comms))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|iindi", (char**) kwlist,
+                                     &py_optimiser, &py_partition,
+                                     &n_runs, &n_iterations, &seed,
+                                     &threshold, &n_threads))
         return NULL;
 
     #ifdef DEBUG
-      cerr << "optimise_partition(" << py_partition << ");" << endl;
+      cerr << "consensus_partition(" << py_partition << ", " << n_runs << ");" << endl;
     #endif
 
-    #ifdef DEBUG
-      cerr << "Capsule optimiser at address " << py_optimiser << endl;
-    #endif
+    if (n_runs <= 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Number of runs should be positive.");
+      return NULL;
+    }
+
+    if (n_threads <= 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (n_threads > n_runs)
+      n_threads = n_runs;
+
     Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
     #ifdef DEBUG
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
-    #ifdef DEBUG
-      cerr << "Capsule partition at address " << py_partition << endl;
-    #endif
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
     #endif
 
-    #ifdef DEBUG
-      cerr << "Capsule constrained partition at address " << py_constrained_partition << endl;
-    #endif
-    MutableVertexPartition* constrained_partition = decapsule_MutableVertexPartition(py_constrained_partition);
-    #ifdef DEBUG
-      cerr << "Using constrained partition at address " << constrained_partition << endl;
-    #endif
+    partition_lock_t lock({py_partition});
 
-    if (consider_comms < 0)
-      consider_comms = optimiser->refine_consider_comms;
+    Graph* graph = partition->get_graph();
+    size_t n = graph->vcount();
+    size_t m = graph->ecount();
 
-    double q = 0.0;
+    vector<size_t> from(m), to(m);
+    vector<double> edge_weights(m);
+    for (size_t e = 0; e < m; e++)
+    {
+      vector<size_t> edge = graph->edge(e);
+      from[e] = edge[0];
+      to[e] = edge[1];
+      edge_weights[e] = graph->edge_weight(e);
+    }
+    vector<double> node_sizes(n);
+    for (size_t v = 0; v < n; v++)
+      node_sizes[v] = graph->node_size(v);
+
+    vector<double> agreement(m, 0.0);
+    vector<string> errors(n_threads);
+    vector<Graph*> graphs(n_threads, NULL);
+    bool success = true;
+
+    Py_BEGIN_ALLOW_THREADS
     try
     {
-      q = optimiser->move_nodes_constrained(partition, consider_comms, constrained_partition);
+      // The neighbour caches of a Graph are not thread safe, so each thread
+      // uses its own Graph, while the underlying igraph graph is shared.
+      graphs[0] = graph;
+      for (int t = 1; t < n_threads; t++)
+        graphs[t] = new Graph(graph->get_igraph(), edge_weights, node_sizes, graph->correct_self_loops());
+
+      vector< vector<double> > thread_agreement(n_threads);
+      auto run = [&](int t)
+      {
+        try
+        {
+          Optimiser run_optimiser;
+          optimiser_workspace_t run_workspace;
+          run_workspace.check_signals = false;
+          copy_optimiser_settings(optimiser, &run_optimiser, workspace, &run_workspace);
+          thread_agreement[t].resize(m, 0.0);
+          for (int k = t; k < n_runs; k += n_threads)
+          {
+            run_optimiser.set_rng_seed(seed + k);
+            run_workspace.rng.seed(seed + k);
+            MutableVertexPartition* run_partition = partition->create(graphs[t]);
+            run_partition->destructor_delete_graph = false;
+            optimise_partition_iterations(&run_optimiser, run_partition, n_iterations, &run_workspace);
+            for (size_t e = 0; e < m; e++)
+              if (run_partition->membership(from[e]) == run_partition->membership(to[e]))
+                thread_agreement[t][e] += 1.0;
+            delete run_partition;
+          }
+        }
+        catch (std::exception& e)
+        {
+          errors[t] = e.what();
+        }
+      };
+
+      vector<std::thread> threads;
+      for (int t = 1; t < n_threads; t++)
+        threads.push_back(std::thread(run, t));
+      run(0);
+      for (std::thread& thread : threads)
+        thread.join();
+
+      for (int t = 0; t < n_threads; t++)
+      {
+        if (!errors[t].empty())
+          throw Exception(errors[t].c_str());
+        for (size_t e = 0; e < m; e++)
+          agreement[e] += thread_agreement[t][e];
+      }
+
+      for (size_t e = 0; e < m; e++)
+      {
+        agreement[e] /= n_runs;
+        if (agreement[e] < threshold)
+          agreement[e] = 0.0;
+      }
+
+      // Optimise a partition of the same type on the graph weighted by
+      // agreement. As for the runs, this uses an optimiser of its own, seeded
+      // as if it were the next run, so that the consensus partition only
+      // depends on the seed, and the optimiser itself is left untouched.
+      Graph* consensus_graph = new Graph(graph->get_igraph(), agreement, node_sizes, graph->correct_self_loops());
+      MutableVertexPartition* consensus_partition = partition->create(consensus_graph);
+      consensus_partition->destructor_delete_graph = true;
+      Optimiser consensus_optimiser;
+      optimiser_workspace_t consensus_workspace;
+      consensus_workspace.check_signals = false;
+      copy_optimiser_settings(optimiser, &consensus_optimiser, workspace, &consensus_workspace);
+      consensus_optimiser.set_rng_seed(seed + n_runs);
+      consensus_workspace.rng.seed(seed + n_runs);
+      try
+      {
+        optimise_partition_iterations(&consensus_optimiser, consensus_partition, n_iterations, &consensus_workspace);
+      }
+      catch (...)
+      {
+        delete consensus_partition;
+        throw;
+      }
+      partition->set_membership(consensus_partition->membership());
+      delete consensus_partition;
     }
     catch (std::exception& e)
     {
-      PyErr_SetString(PyExc_ValueError, e.what());
+      if (errors[0].empty())
+        errors[0] = e.what();
+      success = false;
+    }
+    for (int t = 1; t < n_threads; t++)
+      delete graphs[t];
+    Py_END_ALLOW_THREADS
+
+    if (!success)
+    {
+      PyErr_SetString(PyExc_ValueError, errors[0].c_str());
       return NULL;
     }
-    return PyFloat_FromDouble(q);
+
+    // Packed doubles, wrapped in an array by the Python side
+    return PyBytes_FromStringAndSize((const char*)agreement.data(), m*sizeof(double));
   }
 
-  PyObject* _Optimiser_merge_nodes_constrained(PyObject *self, PyObject *args, PyObject *keywds)
+  PyObject* _Optimiser_find_partitions_batch(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
     PyObject* py_partition = NULL;
-    PyObject* py_constrained_partition = NULL;
-    int consider_comms = -1;
+    PyObject* py_edges = NULL;
+    PyObject* py_edge_offsets = NULL;
+    PyObject* py_node_offsets = NULL;
+    PyObject* py_weights = NULL;
+    int n_iterations = 2;
+    size_t seed = 0;
+    int n_threads = 1;
+    char* py_aggregate_order = NULL;
 
-    static const char* kwlist[] = {"optimiser", "partition", "constrained_partition", "consider_comms", NULL};
+    static const char* kwlist[] = {"optimiser", "partition", "edges", "edge_offsets", "node_offsets",
+                                   "weights", "n_iterations", "seed", "n_threads", "aggregate_order", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|i", (char**) kwlist,
-                                     &py_optimiser, &py_partition, &py_constrained_partition, &consider_comms))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOOO|Oiniz", (char**) kwlist,
+                                     &py_optimiser, &py_partition,
+                                     &py_edges, &py_edge_offsets, &py_node_offsets,
+                                     &py_weights, &n_iterations, &seed, &n_threads,
+                                     &py_aggregate_order))
         return NULL;
 
-    #ifdef DEBUG
-      cerr << "optimise_partition(" << py_partition << ");" << endl;
-    #endif
+    int aggregate_order = AGGREGATE_ORDER_NONE;
+    try
+    {
+      aggregate_order = parse_aggregate_order(py_aggregate_order);
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
+    // The graphs are passed as packed arrays: the int64 pairs of nodes of all
+    // edges, and for each graph the int64 offset of its first edge and of its
+    // first node, followed by the total number of edges and nodes. Nodes are
+    // numbered from zero within each graph.
+    if (!PyBytes_Check(py_edges) || !PyBytes_Check(py_edge_offsets) || !PyBytes_Check(py_node_offsets) ||
+        (py_weights != NULL && py_weights != Py_None && !PyBytes_Check(py_weights)))
+    {
+      PyErr_SetString(PyExc_TypeError, "Expected packed int64 edges and offsets, and packed double weights.");
+      return NULL;
+    }
+    if (PyBytes_Size(py_edges) % (2*sizeof(int64_t)) != 0 ||
+        PyBytes_Size(py_edge_offsets) % sizeof(int64_t) != 0 ||
+        PyBytes_Size(py_node_offsets) != PyBytes_Size(py_edge_offsets) ||
+        PyBytes_Size(py_edge_offsets) == 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Edge and node offsets should have one more value than the number of graphs.");
+      return NULL;
+    }
+
+    const int64_t* edges = (const int64_t*)PyBytes_AsString(py_edges);
+    const int64_t* edge_offsets = (const int64_t*)PyBytes_AsString(py_edge_offsets);
+    const int64_t* node_offsets = (const int64_t*)PyBytes_AsString(py_node_offsets);
+    size_t m_total = PyBytes_Size(py_edges) / (2*sizeof(int64_t));
+    size_t n_graphs = PyBytes_Size(py_edge_offsets) / sizeof(int64_t) - 1;
+
+    const double* weights = NULL;
+    if (py_weights != NULL && py_weights != Py_None)
+    {
+      if ((size_t)PyBytes_Size(py_weights) != m_total*sizeof(double))
+      {
+        PyErr_SetString(PyExc_ValueError, "Weight vector not the same size as the number of edges.");
+        return NULL;
+      }
+      weights = (const double*)PyBytes_AsString(py_weights);
+      for (size_t e = 0; e < m_total; e++)
+      {
+        if (weights[e] < 0 || !isfinite(weights[e]))
+        {
+          PyErr_Format(PyExc_ValueError, "Weight of edge %zu should be finite and non-negative.", e);
+          return NULL;
+        }
+      }
+    }
+
+    if (edge_offsets[0] != 0 || node_offsets[0] != 0 ||
+        (size_t)edge_offsets[n_graphs] != m_total)
+    {
+      PyErr_SetString(PyExc_ValueError, "Offsets should start at zero, and the edge offsets should end at the number of edges.");
+      return NULL;
+    }
+    for (size_t g = 0; g < n_graphs; g++)
+    {
+      if (edge_offsets[g + 1] < edge_offsets[g] || node_offsets[g + 1] < node_offsets[g])
+      {
+        PyErr_Format(PyExc_ValueError, "Offsets of graph %zu should not decrease.", g);
+        return NULL;
+      }
+      int64_t n = node_offsets[g + 1] - node_offsets[g];
+      for (int64_t i = 2*edge_offsets[g]; i < 2*edge_offsets[g + 1]; i++)
+      {
+        if (edges[i] < 0 || edges[i] >= n)
+        {
+          PyErr_Format(PyExc_ValueError, "Node %lld of edge %lld should be between 0 and %lld in graph %zu.",
+                       (long long)edges[i], (long long)(i/2 - edge_offsets[g]), (long long)(n - 1), g);
+          return NULL;
+        }
+      }
+    }
+    size_t n_total = node_offsets[n_graphs];
 
     #ifdef DEBUG
-      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+      cerr << "find_partitions_batch(" << n_graphs << " graphs, " << n_total << " nodes, " << m_total << " edges);" << endl;
     #endif
+
+    if (n_threads <= 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if ((size_t)n_threads > n_graphs)
+      n_threads = std::max((size_t)1, n_graphs);
+
     Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
     #ifdef DEBUG
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
-    #ifdef DEBUG
-      cerr << "Capsule partition at address " << py_partition << endl;
-    #endif
+    // Every graph is optimised with a partition of the same type and with the
+    // same parameters as this partition, which is otherwise left untouched.
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
     #endif
-
-    #ifdef DEBUG
-      cerr << "Capsule constrained partition at address " << py_partition << endl;
-    #endif
-    MutableVertexPartition* constrained_partition = decapsule_MutableVertexPartition(py_constrained_partition);
-    #ifdef DEBUG
-      cerr << "Using constrained partition at address " << partition << endl;
-    #endif
-
-    if (consider_comms < 0)
-      consider_comms = optimiser->refine_consider_comms;
-
-    double q = 0.0;
-    try
+    // These partitions derive their parameters from node sizes or from
+    // further layers, which a partition created from a graph alone lacks.
+    if (dynamic_cast<SignedRBConfigurationVertexPartition*>(partition) != NULL ||
+        dynamic_cast<BipartiteCPMVertexPartition*>(partition) != NULL)
     {
-      q = optimiser->merge_nodes_constrained(partition, consider_comms, constrained_partition);
+      PyErr_SetString(PyExc_ValueError, "Partition type is not supported by find_partitions_batch.");
+      return NULL;
     }
-    catch (std::exception& e)
+    // The partition is read by all threads, so it is locked as for an
+    // optimisation of a partition that shares its graph.
+    partition_lock_t lock({py_partition});
+
+    bool directed = partition->get_graph()->is_directed();
+    int correct_self_loops = partition->get_graph()->correct_self_loops();
+
+    vector<int64_t> membership(n_total);
+    vector<string> errors(n_threads);
+    std::atomic<size_t> next_graph(0);
+    std::atomic<bool> failed(false);
+
+    Py_BEGIN_ALLOW_THREADS
+    // The graphs differ in size, so threads take the next graph when done,
+    // but graph g always uses seed + g, regardless of n_threads.
+    auto run = [&](int t)
     {
-      PyErr_SetString(PyExc_ValueError, e.what());
-      return NULL;
+      try
+      {
+        Optimiser run_optimiser;
+        optimiser_workspace_t run_workspace;
+        run_workspace.check_signals = false;
+        copy_optimiser_settings(optimiser, &run_optimiser, workspace, &run_workspace);
+        vector<double> edge_weights;
+        for (size_t g = next_graph++; g < n_graphs && !failed; g = next_graph++)
+        {
+          size_t n = node_offsets[g + 1] - node_offsets[g];
+          size_t m = edge_offsets[g + 1] - edge_offsets[g];
+
+          igraph_vector_int_t edge_list;
+          igraph_vector_int_init(&edge_list, 2*m);
+          for (size_t i = 0; i < 2*m; i++)
+            VECTOR(edge_list)[i] = edges[2*edge_offsets[g] + i];
+          igraph_t igraph;
+          igraph_create(&igraph, &edge_list, n, directed);
+          igraph_vector_int_destroy(&edge_list);
+
+          MutableVertexPartition* run_partition = NULL;
+          try
+          {
+            Graph* graph = NULL;
+            if (weights != NULL)
+            {
+              edge_weights.assign(weights + edge_offsets[g], weights + edge_offsets[g + 1]);
+              graph = Graph::GraphFromEdgeWeights(&igraph, edge_weights, correct_self_loops);
+            }
+            else
+              graph = new Graph(&igraph, correct_self_loops);
+            try
+            {
+              run_partition = partition->create(graph);
+            }
+            catch (...)
+            {
+              delete graph;
+              throw;
+            }
+            run_partition->destructor_delete_graph = true;
+
+            run_optimiser.set_rng_seed(seed + g);
+            run_workspace.rng.seed(seed + g);
+            optimise_partition_iterations(&run_optimiser, run_partition, n_iterations, &run_workspace,
+                                          aggregate_order);
+            for (size_t v = 0; v < n; v++)
+              membership[node_offsets[g] + v] = run_partition->membership(v);
+          }
+          catch (...)
+          {
+            delete run_partition;
+            igraph_destroy(&igraph);
+            throw;
+          }
+          delete run_partition;
+          igraph_destroy(&igraph);
+        }
+      }
+      catch (std::exception& e)
+      {
+        errors[t] = e.what();
+        failed = true;
+      }
+    };
+
+    vector<std::thread> threads;
+    for (int t = 1; t < n_threads; t++)
+      threads.push_back(std::thread(run, t));
+    run(0);
+    for (std::thread& thread : threads)
+      thread.join();
+    Py_END_ALLOW_THREADS
+
+    for (int t = 0; t < n_threads; t++)
+    {
+      if (!errors[t].empty())
+      {
+        PyErr_SetString(PyExc_ValueError, errors[t].c_str());
+        return NULL;
+      }
     }
-    return PyFloat_FromDouble(q);
+
+    return PyBytes_FromStringAndSize((const char*)membership.data(), membership.size()*sizeof(int64_t));
   }
 
   PyObject* _Optimiser_set_consider_comms(PyObject *self, PyObject *args, PyObject *keywds)
@@ -521,7 +2918,19 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
-    optimiser->consider_comms = consider_comms;
+    if (consider_comms != Optimiser::ALL_COMMS && consider_comms != Optimiser::ALL_NEIGH_COMMS &&
+        consider_comms != Optimiser::RAND_COMM && consider_comms != Optimiser::RAND_NEIGH_COMM &&
+        consider_comms != PRUNED_ALL_COMMS)
+    {
+      PyErr_SetString(PyExc_ValueError, "Unknown consider_comms.");
+      return NULL;
+    }
+
+    // Routines of libleidenalg that do not know about pruning, such as those
+    // used in the consensus, consider all communities instead.
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    workspace->pruned_all_comms = (consider_comms == PRUNED_ALL_COMMS);
+    optimiser->consider_comms = workspace->pruned_all_comms ? Optimiser::ALL_COMMS : consider_comms;
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -552,6 +2961,8 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
+    if (decapsule_Optimiser_workspace(py_optimiser)->pruned_all_comms)
+      return PyLong_FromLong(PRUNED_ALL_COMMS);
     return PyLong_FromLong(optimiser->consider_comms);
   }
 
@@ -581,6 +2992,13 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
+    if (refine_consider_comms != Optimiser::ALL_COMMS && refine_consider_comms != Optimiser::ALL_NEIGH_COMMS &&
+        refine_consider_comms != Optimiser::RAND_COMM && refine_consider_comms != Optimiser::RAND_NEIGH_COMM)
+    {
+      PyErr_SetString(PyExc_ValueError, "Unknown refine_consider_comms.");
+      return NULL;
+    }
+
     optimiser->refine_consider_comms = refine_consider_comms;
 
     Py_INCREF(Py_None);
@@ -1043,6 +3461,105 @@ extern "C"
     return PyFloat_FromDouble(optimiser->community_constraint_enforcement);
   }
 
+  PyObject* _Optimiser_set_fused_moves(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int fused_moves = false;
+    static const char* kwlist[] = {"optimiser", "fused_moves", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", (char**) kwlist,
+                                     &py_optimiser, &fused_moves))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_fused_moves(" << fused_moves << ");" << endl;
+    #endif
+
+    decapsule_Optimiser_workspace(py_optimiser)->fused_moves = fused_moves;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_fused_moves(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static const char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_fused_moves();" << endl;
+    #endif
+
+    return PyBool_FromLong(decapsule_Optimiser_workspace(py_optimiser)->fused_moves);
+  }
+
+  PyObject* _Optimiser_set_all_comms_candidates(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    int candidate_index = false;
+    Py_ssize_t candidate_limit = 0;
+    static const char* kwlist[] = {"optimiser", "candidate_index", "candidate_limit", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oin", (char**) kwlist,
+                                     &py_optimiser, &candidate_index, &candidate_limit))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "set_all_comms_candidates(" << candidate_index << ", " << candidate_limit << ");" << endl;
+    #endif
+
+    if (candidate_limit < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "The number of candidates cannot be negative.");
+      return NULL;
+    }
+
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    workspace->candidate_index = candidate_index;
+    workspace->candidate_limit = candidate_limit;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_all_comms_candidates(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static const char* kwlist[] = {"optimiser", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_all_comms_candidates();" << endl;
+    #endif
+
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    return Py_BuildValue("(On)", workspace->candidate_index ? Py_True : Py_False,
+                         (Py_ssize_t)workspace->candidate_limit);
+  }
+
   PyObject* _Optimiser_set_rng_seed(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = NULL;
@@ -1073,10 +3590,90 @@ extern "C"
       cerr << "Setting seed to " << seed << endl;
     #endif
     optimiser->set_rng_seed(seed);
+    decapsule_Optimiser_workspace(py_optimiser)->rng.seed(seed);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_start(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    PyObject* py_time_budget = NULL;
+    static const char* kwlist[] = {"optimiser", "time_budget", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|O", (char**) kwlist,
+                                     &py_optimiser, &py_time_budget))
+        return NULL;
+
+    optimiser_workspace_t* workspace = decapsule_Optimiser_workspace(py_optimiser);
+    workspace->status = OPTIMISE_COMPLETE;
+    workspace->cancel_requested = false;
+    workspace->progress = optimise_progress_t();
+    workspace->has_reported = false;
+    workspace->has_deadline = (py_time_budget != NULL && py_time_budget != Py_None);
+    if (workspace->has_deadline)
+    {
+      double time_budget = PyFloat_AsDouble(py_time_budget);
+      if (time_budget == -1.0 && PyErr_Occurred())
+        return NULL;
+      #ifdef DEBUG
+        cerr << "start_time_budget(" << time_budget << ");" << endl;
+      #endif
+      workspace->deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_budget));
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_cancel(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static const char* kwlist[] = {"optimiser", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "cancel();" << endl;
+    #endif
+
+    decapsule_Optimiser_workspace(py_optimiser)->cancel_requested = true;
 
     Py_INCREF(Py_None);
     return Py_None;
   }
+
+  PyObject* _Optimiser_get_status(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static const char* kwlist[] = {"optimiser", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    return PyLong_FromLong(decapsule_Optimiser_workspace(py_optimiser)->status);
+  }
+
+  PyObject* _Optimiser_get_peak_memory_usage(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = NULL;
+    static const char* kwlist[] = {"optimiser", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_optimiser))
+        return NULL;
+
+    return PyLong_FromSize_t(decapsule_Optimiser_workspace(py_optimiser)->peak_memory_usage);
+  }
 #ifdef __cplusplus
 }
 #endif
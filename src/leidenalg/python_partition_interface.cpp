@@ -38,7 +38,13 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_node_sizes, PyO
       cerr << "Reading node_sizes." << endl;
     #endif
 
-    size_t nb_node_size = PyList_Size(py_node_sizes);
+    py_snapshot_t py_node_size_items(py_node_sizes);
+    if (py_node_size_items.py_tuple == NULL)
+    {
+      PyErr_Clear();
+      throw Exception("Expected a list of node sizes.");
+    }
+    size_t nb_node_size = py_node_size_items.size();
     if (nb_node_size != n)
     {
       throw Exception("Node size vector not the same size as the number of nodes.");
@@ -46,7 +52,7 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_node_sizes, PyO
     node_sizes.resize(n);
     for (size_t v = 0; v < n; v++)
     {
-      PyObject* py_item = PyList_GetItem(py_node_sizes, v);
+      PyObject* py_item = py_node_size_items[v];
       if (PyNumber_Check(py_item))
       {
         double e = PyFloat_AsDouble(py_item);
@@ -64,13 +70,19 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_node_sizes, PyO
     #ifdef DEBUG
       cerr << "Reading weights." << endl;
     #endif
-    size_t nb_weights = PyList_Size(py_weights);
+    py_snapshot_t py_weight_items(py_weights);
+    if (py_weight_items.py_tuple == NULL)
+    {
+      PyErr_Clear();
+      throw Exception("Expected a list of weights.");
+    }
+    size_t nb_weights = py_weight_items.size();
     if (nb_weights != m)
       throw Exception("Weight vector not the same size as the number of edges.");
     weights.resize(m);
     for (size_t e = 0; e < m; e++)
     {
-      PyObject* py_item = PyList_GetItem(py_weights, e);
+      PyObject* py_item = py_weight_items[e];
       if (PyNumber_Check(py_item))
       {
         weights[e] = PyFloat_AsDouble(py_item);
@@ -119,11 +131,17 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_node_sizes, PyO
 
 vector<size_t> create_size_t_vector(PyObject* py_list)
 {
-    size_t n = PyList_Size(py_list);
+    py_snapshot_t py_items(py_list);
+    if (py_items.py_tuple == NULL)
+    {
+      PyErr_Clear();
+      throw Exception("Expected a list of integers.");
+    }
+    size_t n = py_items.size();
     vector<size_t> result(n);
     for (size_t i = 0; i < n; i++)
     {
-      PyObject* py_item = PyList_GetItem(py_list, i);
+      PyObject* py_item = py_items[i];
       if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
       {
         size_t e = PyLong_AsSize_t(PyNumber_Long(py_item));
@@ -138,12 +156,27 @@ vector<size_t> create_size_t_vector(PyObject* py_list)
     return result;
 }
 
-PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition)
+PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition, graph_mutex_t const& graph_mutex)
 {
   PyObject* py_partition = PyCapsule_New(partition, "leidenalg.VertexPartition.MutableVertexPartition", del_MutableVertexPartition);
+  graph_mutex_t* context = new graph_mutex_t(graph_mutex ? graph_mutex : std::make_shared<std::recursive_mutex>());
+  if (py_partition != NULL && PyCapsule_SetContext(py_partition, context) != 0)
+  {
+    delete context;
+    Py_DECREF(py_partition);
+    return NULL;
+  }
+  if (py_partition == NULL)
+    delete context;
   return py_partition;
 }
 
+graph_mutex_t decapsule_graph_mutex(PyObject* py_partition)
+{
+  graph_mutex_t* graph_mutex = (graph_mutex_t*) PyCapsule_GetContext(py_partition);
+  return graph_mutex != NULL ? *graph_mutex : graph_mutex_t();
+}
+
 MutableVertexPartition* decapsule_MutableVertexPartition(PyObject* py_partition)
 {
   MutableVertexPartition* partition = (MutableVertexPartition*) PyCapsule_GetPointer(py_partition, "leidenalg.VertexPartition.MutableVertexPartition");
@@ -154,6 +187,141 @@ void del_MutableVertexPartition(PyObject* py_partition)
 {
   MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
   delete partition;
+  delete (graph_mutex_t*) PyCapsule_GetContext(py_partition);
+}
+
+partition_lock_t::partition_lock_t(vector<PyObject*> const& py_partitions)
+{
+  for (PyObject* py_partition : py_partitions)
+  {
+    graph_mutex_t* graph_mutex = (graph_mutex_t*) PyCapsule_GetContext(py_partition);
+    if (graph_mutex != NULL)
+      mutexes.push_back(graph_mutex->get());
+  }
+  // Lock in a fixed order, and each graph only once, so that optimisers of
+  // overlapping sets of partitions cannot deadlock.
+  sort(mutexes.begin(), mutexes.end());
+  mutexes.erase(unique(mutexes.begin(), mutexes.end()), mutexes.end());
+  for (std::recursive_mutex* mutex : mutexes)
+  {
+    if (!mutex->try_lock())
+    {
+      Py_BEGIN_ALLOW_THREADS
+      mutex->lock();
+      Py_END_ALLOW_THREADS
+    }
+  }
+}
+
+partition_lock_t::~partition_lock_t()
+{
+  for (std::recursive_mutex* mutex : mutexes)
+    mutex->unlock();
+}
+
+memory_usage_t estimate_memory_usage(MutableVertexPartition* partition)
+{
+  // These are estimates based on the main arrays held by the igraph graph,
+  // the Graph and the MutableVertexPartition, ignoring allocator overhead.
+  Graph* graph = partition->get_graph();
+  size_t n = graph->vcount();
+  size_t nb_comms = partition->n_communities();
+
+  memory_usage_t usage = estimate_graph_memory_usage(n, graph->ecount());
+  usage.membership = n*sizeof(size_t);
+  // Community size, number of nodes and three total weights
+  usage.communities = nb_comms*(4*sizeof(double) + sizeof(size_t));
+  // Weights to, from and of all neighbouring communities plus their indices
+  usage.community_caches = 3*n*(sizeof(double) + sizeof(size_t));
+  // When aggregating, the collapsed graph and its partition and refined
+  // partition are held in addition to the original. The first aggregate
+  // graph is at most as large as the original graph.
+  usage.aggregation = usage.adjacency + usage.weights + usage.nodes +
+                      2*(usage.membership + usage.communities + usage.community_caches);
+  return usage;
+}
+
+int parse_aggregate_order(const char* aggregate_order)
+{
+  if (aggregate_order == NULL)
+    return AGGREGATE_ORDER_NONE;
+  string order(aggregate_order);
+  if (order == "size")
+    return AGGREGATE_ORDER_SIZE;
+  else if (order == "traversal")
+    return AGGREGATE_ORDER_TRAVERSAL;
+  throw Exception("Unknown aggregate order, should be 'size' or 'traversal'.");
+}
+
+/****************************************************************************
+  Relabel the communities of the partitions, which should all have the same
+  membership (as the layers of a multiplex optimisation), before collapsing
+  the graph. The communities become the nodes of the aggregate graph, so this
+  determines their layout in memory:
+
+    size       By decreasing size, so that the largest communities come first.
+    traversal  In the order in which a breadth-first search of the graph
+               first reaches each community, so that adjacent communities
+               tend to be close.
+
+  The aggregate graph is built from the labels of the partition, so that
+  from_coarse_partition maps back as usual.
+*****************************************************************************/
+void relabel_for_aggregation(vector<MutableVertexPartition*> const& partitions, int aggregate_order,
+                             aggregation_workspace_t* workspace)
+{
+  if (aggregate_order == AGGREGATE_ORDER_NONE || partitions.empty())
+    return;
+
+  aggregation_workspace_t local_workspace;
+  if (workspace == NULL)
+    workspace = &local_workspace;
+
+  MutableVertexPartition* partition = partitions[0];
+  size_t nb_comms = partition->n_communities();
+
+  // The communities in their new order
+  vector<size_t>& comms = workspace->comms;
+  if (aggregate_order == AGGREGATE_ORDER_SIZE)
+  {
+    comms.resize(nb_comms);
+    for (size_t c = 0; c < nb_comms; c++)
+      comms[c] = c;
+    std::stable_sort(comms.begin(), comms.end(),
+                     [partition](size_t c, size_t d) { return partition->csize(c) > partition->csize(d); });
+  }
+  else
+  {
+    // The communities in the order in which they are first reached
+    vector<bool>& is_reached = workspace->is_reached;
+    is_reached.assign(nb_comms, false);
+    Graph* graph = partition->get_graph();
+    node_order(graph, "bfs", workspace->order, workspace->order_scratch);
+    comms.clear();
+    for (size_t v : workspace->order)
+    {
+      size_t c = partition->membership(v);
+      if (!is_reached[c])
+      {
+        is_reached[c] = true;
+        comms.push_back(c);
+      }
+    }
+
+    // Empty communities go last
+    if (comms.size() < nb_comms)
+      for (size_t c = 0; c < nb_comms; c++)
+        if (!is_reached[c])
+          comms.push_back(c);
+  }
+
+  vector<size_t>& new_comm_id = workspace->new_comm_id;
+  new_comm_id.resize(nb_comms);
+  for (size_t i = 0; i < nb_comms; i++)
+    new_comm_id[comms[i]] = i;
+
+  for (MutableVertexPartition* layer_partition : partitions)
+    layer_partition->relabel_communities(new_comm_id);
 }
 
 #ifdef __cplusplus
@@ -232,10 +400,10 @@ extern "C"
       {
         vector<size_t> initial_membership = create_size_t_vector(py_initial_membership);
 
-        partition = new SignificanceVertexPartition(graph, initial_membership);
+        partition = new CachedSignificanceVertexPartition(graph, initial_membership);
       }
       else
-        partition = new SignificanceVertexPartition(graph);
+        partition = new CachedSignificanceVertexPartition(graph);
 
       // Do *NOT* forget to remove the graph upon deletion
       partition->destructor_delete_graph = true;
@@ -280,10 +448,10 @@ extern "C"
       {
         vector<size_t> initial_membership = create_size_t_vector(py_initial_membership);
 
-        partition = new SurpriseVertexPartition(graph, initial_membership);
+        partition = new CachedSurpriseVertexPartition(graph, initial_membership);
       }
       else
-        partition = new SurpriseVertexPartition(graph);
+        partition = new CachedSurpriseVertexPartition(graph);
 
       // Do *NOT* forget to remove the graph upon deletion
       partition->destructor_delete_graph = true;
@@ -353,6 +521,73 @@ extern "C"
     }
   }
 
+  PyObject* _new_BipartiteCPMVertexPartition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+    PyObject* py_initial_membership = NULL;
+    PyObject* py_weights = NULL;
+    PyObject* py_node_sizes = NULL;
+    double resolution_parameter_01 = 1.0;
+    double resolution_parameter_0 = 0.0;
+    double resolution_parameter_1 = 0.0;
+    double type_base = 1.0;
+    int correct_self_loops = false;
+
+    static const char* kwlist[] = {"graph", "initial_membership", "weights", "node_sizes",
+                                   "resolution_parameter_01", "resolution_parameter_0", "resolution_parameter_1",
+                                   "type_base", "correct_self_loops", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOOdddd|p", (char**) kwlist,
+                                     &py_obj_graph, &py_initial_membership, &py_weights, &py_node_sizes,
+                                     &resolution_parameter_01, &resolution_parameter_0, &resolution_parameter_1,
+                                     &type_base, &correct_self_loops))
+        return NULL;
+
+    try
+    {
+
+      Graph* graph = create_graph_from_py(py_obj_graph, py_node_sizes, py_weights, false, correct_self_loops);
+
+      // The sizes of both classes can only be recovered exactly if all
+      // encoded community sizes are exactly representable.
+      if (type_base*(graph->total_size()/type_base + 1) > 9007199254740992.0)
+      {
+        delete graph;
+        throw Exception("Total node size too large to encode both classes.");
+      }
+
+      BipartiteCPMVertexPartition* partition = NULL;
+
+      // If necessary create an initial partition
+      if (py_initial_membership != NULL && py_initial_membership != Py_None)
+      {
+        vector<size_t> initial_membership = create_size_t_vector(py_initial_membership);
+
+        partition = new BipartiteCPMVertexPartition(graph, initial_membership,
+          resolution_parameter_01, resolution_parameter_0, resolution_parameter_1, type_base);
+      }
+      else
+        partition = new BipartiteCPMVertexPartition(graph,
+          resolution_parameter_01, resolution_parameter_0, resolution_parameter_1, type_base);
+
+      // Do *NOT* forget to remove the graph upon deletion
+      partition->destructor_delete_graph = true;
+
+      PyObject* py_partition = capsule_MutableVertexPartition(partition);
+      #ifdef DEBUG
+        cerr << "Created capsule partition at address " << py_partition << endl;
+      #endif
+
+      return py_partition;
+    }
+    catch (std::exception const & e )
+    {
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+  }
+
   PyObject* _new_RBERVertexPartition(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_obj_graph = NULL;
@@ -450,6 +685,117 @@ extern "C"
     }
   }
 
+  PyObject* _new_SignedRBConfigurationVertexPartition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+    PyObject* py_initial_membership = NULL;
+    PyObject* py_weights = NULL;
+    PyObject* py_node_sizes = NULL;
+    double resolution_parameter = 1.0;
+
+    static const char* kwlist[] = {"graph", "initial_membership", "weights", "node_sizes", "resolution_parameter", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOOd", (char**) kwlist,
+                                     &py_obj_graph, &py_initial_membership, &py_weights, &py_node_sizes, &resolution_parameter))
+        return NULL;
+
+    try
+    {
+
+      // The node sizes are the negative strengths of the nodes
+      Graph* graph = create_graph_from_py(py_obj_graph, py_node_sizes, py_weights, false, false);
+
+      if (graph->is_directed())
+      {
+        delete graph;
+        throw Exception("Signed partitions are only implemented for undirected graphs.");
+      }
+
+      SignedRBConfigurationVertexPartition* partition = NULL;
+
+      // If necessary create an initial partition
+      if (py_initial_membership != NULL && py_initial_membership != Py_None)
+      {
+        vector<size_t> initial_membership = create_size_t_vector(py_initial_membership);
+
+        partition = new SignedRBConfigurationVertexPartition(graph, initial_membership, resolution_parameter);
+      }
+      else
+        partition = new SignedRBConfigurationVertexPartition(graph, resolution_parameter);
+
+      // Do *NOT* forget to remove the graph upon deletion
+      partition->destructor_delete_graph = true;
+
+      PyObject* py_partition = capsule_MutableVertexPartition(partition);
+      #ifdef DEBUG
+        cerr << "Created capsule partition at address " << py_partition << endl;
+      #endif
+
+      return py_partition;
+    }
+    catch (std::exception const & e )
+    {
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+  }
+
+  PyObject* _new_SignedModularityVertexPartition(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_obj_graph = NULL;
+    PyObject* py_initial_membership = NULL;
+    PyObject* py_weights = NULL;
+    PyObject* py_node_sizes = NULL;
+
+    static const char* kwlist[] = {"graph", "initial_membership", "weights", "node_sizes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOO", (char**) kwlist,
+                                     &py_obj_graph, &py_initial_membership, &py_weights, &py_node_sizes))
+        return NULL;
+
+    try
+    {
+
+      // The node sizes are the negative strengths of the nodes
+      Graph* graph = create_graph_from_py(py_obj_graph, py_node_sizes, py_weights, false, false);
+
+      if (graph->is_directed())
+      {
+        delete graph;
+        throw Exception("Signed partitions are only implemented for undirected graphs.");
+      }
+
+      SignedModularityVertexPartition* partition = NULL;
+
+      // If necessary create an initial partition
+      if (py_initial_membership != NULL && py_initial_membership != Py_None)
+      {
+        vector<size_t> initial_membership = create_size_t_vector(py_initial_membership);
+
+        partition = new SignedModularityVertexPartition(graph, initial_membership);
+      }
+      else
+        partition = new SignedModularityVertexPartition(graph);
+
+      // Do *NOT* forget to remove the graph upon deletion
+      partition->destructor_delete_graph = true;
+
+      PyObject* py_partition = capsule_MutableVertexPartition(partition);
+      #ifdef DEBUG
+        cerr << "Created capsule partition at address " << py_partition << endl;
+      #endif
+
+      return py_partition;
+    }
+    catch (std::exception const & e )
+    {
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+  }
+
   PyObject* _MutableVertexPartition_get_py_igraph(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = NULL;
@@ -473,6 +819,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -483,28 +830,28 @@ extern "C"
     size_t n = graph->vcount();
     size_t m = graph->ecount();
 
-    PyObject* edges = PyList_New(m);
+    // Export as packed arrays (int64 edge endpoints, double weights and node
+    // sizes), which can be wrapped by array.array without creating a Python
+    // object per edge.
+    vector<int64_t> edges(2*m);
+    vector<double> weights(m);
     for (size_t e = 0; e < m; e++)
     {
       vector<size_t> edge = graph->edge(e);
-      PyList_SetItem(edges, e, Py_BuildValue("(nn)", edge[0], edge[1]));
-    }
-
-    PyObject* weights = PyList_New(m);
-    for (size_t e = 0; e < m; e++)
-    {
-      PyObject* item = PyFloat_FromDouble(graph->edge_weight(e));
-      PyList_SetItem(weights, e, item);
+      edges[2*e] = edge[0];
+      edges[2*e + 1] = edge[1];
+      weights[e] = graph->edge_weight(e);
     }
 
-    PyObject* node_sizes = PyList_New(n);
+    vector<double> node_sizes(n);
     for (size_t v = 0; v < n; v++)
-    {
-      PyObject* item = PyLong_FromSize_t(graph->node_size(v));
-      PyList_SetItem(node_sizes, v, item);
-    }
+      node_sizes[v] = graph->node_size(v);
+
+    PyObject* py_edges = PyBytes_FromStringAndSize((const char*)edges.data(), edges.size()*sizeof(int64_t));
+    PyObject* py_weights = PyBytes_FromStringAndSize((const char*)weights.data(), weights.size()*sizeof(double));
+    PyObject* py_node_sizes = PyBytes_FromStringAndSize((const char*)node_sizes.data(), node_sizes.size()*sizeof(double));
 
-    return Py_BuildValue("lOOOO", n, graph->is_directed() ? Py_True : Py_False, edges, weights, node_sizes);
+    return Py_BuildValue("nONNN", n, graph->is_directed() ? Py_True : Py_False, py_edges, py_weights, py_node_sizes);
   }
 
   PyObject* _MutableVertexPartition_from_coarse_partition(PyObject *self, PyObject *args, PyObject *keywds)
@@ -546,6 +893,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -597,6 +945,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -633,6 +982,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -667,6 +1017,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -712,6 +1063,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -721,18 +1073,192 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
+  PyObject* _MutableVertexPartition_quality_batch(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_memberships = NULL;
+    PyObject* py_res = NULL;
+    int n_threads = 1;
+
+    static const char* kwlist[] = {"partition", "memberships", "resolution_parameter", "n_threads", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|Oi", (char**) kwlist,
+                                     &py_partition, &py_memberships,
+                                     &py_res, &n_threads))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "quality_batch();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    // Only partitions with a resolution parameter accept a different one.
+    ResolutionParameterVertexPartition* res_partition = NULL;
+    double resolution_parameter = 0.0;
+    if (py_res != NULL && py_res != Py_None)
+    {
+      res_partition = dynamic_cast<ResolutionParameterVertexPartition*>(partition);
+      if (res_partition == NULL)
+      {
+        PyErr_SetString(PyExc_TypeError, "Partition does not have a resolution parameter.");
+        return NULL;
+      }
+      resolution_parameter = PyFloat_AsDouble(py_res);
+      if (PyErr_Occurred())
+        return NULL;
+      if (isnan(resolution_parameter))
+      {
+        PyErr_SetString(PyExc_TypeError, "Cannot accept NaN resolution parameter.");
+        return NULL;
+      }
+    }
+
+    // The memberships are passed as a packed int64 array of K rows, with one
+    // column for each node.
+    if (!PyBytes_Check(py_memberships))
+    {
+      PyErr_SetString(PyExc_TypeError, "Expected packed int64 memberships.");
+      return NULL;
+    }
+    const int64_t* memberships = (const int64_t*)PyBytes_AsString(py_memberships);
+    size_t nb_values = PyBytes_Size(py_memberships) / sizeof(int64_t);
+
+    Graph* graph = partition->get_graph();
+    size_t n = graph->vcount();
+    if (PyBytes_Size(py_memberships) % sizeof(int64_t) != 0 ||
+        (n == 0 && nb_values > 0) ||
+        (n > 0 && nb_values % n != 0))
+    {
+      PyErr_SetString(PyExc_ValueError, "Membership not the same size as the number of nodes.");
+      return NULL;
+    }
+    size_t K = (n > 0) ? nb_values / n : 0;
+    for (size_t i = 0; i < nb_values; i++)
+    {
+      if (memberships[i] < 0 || (size_t)memberships[i] >= n)
+      {
+        PyErr_Format(PyExc_ValueError, "Community %lld of node %zu in membership %zu should be between 0 and %zu.",
+                     (long long)memberships[i], i % n, i / n, n - 1);
+        return NULL;
+      }
+    }
+
+    if (n_threads <= 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if ((size_t)n_threads > K)
+      n_threads = std::max((size_t)1, K);
+
+    vector<double> qualities(K, 0.0);
+    vector<string> errors(n_threads);
+    vector<Graph*> graphs(n_threads, NULL);
+
+    // The first thread uses the Graph of the partition, whose neighbour
+    // caches may also be used by an optimisation of a partition sharing the
+    // graph, so the graph is locked while the candidates are scored.
+    partition_lock_t lock({py_partition});
+
+    Py_BEGIN_ALLOW_THREADS
+    // The neighbour caches of a Graph are not thread safe, so each other
+    // thread uses its own Graph, while the underlying igraph graph is shared.
+    graphs[0] = graph;
+    try
+    {
+      if (n_threads > 1)
+      {
+        size_t m = graph->ecount();
+        vector<double> edge_weights(m);
+        for (size_t e = 0; e < m; e++)
+          edge_weights[e] = graph->edge_weight(e);
+        vector<double> node_sizes(n);
+        for (size_t v = 0; v < n; v++)
+          node_sizes[v] = graph->node_size(v);
+        for (int t = 1; t < n_threads; t++)
+          graphs[t] = new Graph(graph->get_igraph(), edge_weights, node_sizes, graph->correct_self_loops());
+      }
+    }
+    catch (std::exception& e)
+    {
+      errors[0] = e.what();
+    }
+
+    // Each candidate is scored on a fresh partition of the same type, so
+    // that the state of the partition itself is left untouched.
+    auto run = [&](int t)
+    {
+      try
+      {
+        vector<size_t> membership(n);
+        for (size_t k = t; k < K; k += n_threads)
+        {
+          const int64_t* row = memberships + k*n;
+          for (size_t v = 0; v < n; v++)
+            membership[v] = (size_t)row[v];
+          MutableVertexPartition* candidate = partition->create(graphs[t], membership);
+          candidate->destructor_delete_graph = false;
+          if (res_partition != NULL)
+            qualities[k] = ((ResolutionParameterVertexPartition*)candidate)->quality(resolution_parameter);
+          else
+            qualities[k] = candidate->quality();
+          delete candidate;
+        }
+      }
+      catch (std::exception& e)
+      {
+        errors[t] = e.what();
+      }
+    };
+
+    if (errors[0].empty())
+    {
+      vector<std::thread> threads;
+      for (int t = 1; t < n_threads; t++)
+        threads.push_back(std::thread(run, t));
+      run(0);
+      for (std::thread& thread : threads)
+        thread.join();
+    }
+
+    for (int t = 1; t < n_threads; t++)
+      delete graphs[t];
+    Py_END_ALLOW_THREADS
+
+    for (int t = 0; t < n_threads; t++)
+    {
+      if (!errors[t].empty())
+      {
+        PyErr_SetString(PyExc_ValueError, errors[t].c_str());
+        return NULL;
+      }
+    }
+
+    PyObject* py_qualities = PyList_New(K);
+    for (size_t k = 0; k < K; k++)
+      PyList_SetItem(py_qualities, k, PyFloat_FromDouble(qualities[k]));
+    return py_qualities;
+  }
+
   PyObject* _MutableVertexPartition_aggregate_partition(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = NULL;
+    char* aggregate_order = NULL;
 
-    static const char* kwlist[] = {"partition", NULL};
+    static const char* kwlist[] = {"partition", "order", NULL};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
-                                     &py_partition))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|z", (char**) kwlist,
+                                     &py_partition, &aggregate_order))
         return NULL;
 
     #ifdef DEBUG
@@ -744,11 +1270,22 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
     #endif
 
+    try
+    {
+      relabel_for_aggregation(vector<MutableVertexPartition*>(1, partition), parse_aggregate_order(aggregate_order));
+    }
+    catch (std::exception& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return NULL;
+    }
+
     // First collapse graph (i.e. community graph)
     Graph* collapsed_graph = partition->get_graph()->collapse_graph(partition);
 
@@ -760,6 +1297,65 @@ extern "C"
     return py_collapsed_partition;
   }
 
+  PyObject* _MutableVertexPartition_share_graph(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    PyObject* py_initial_membership = NULL;
+
+    static const char* kwlist[] = {"partition", "initial_membership", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|O", (char**) kwlist,
+                                     &py_partition, &py_initial_membership))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "share_graph();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    Graph* graph = partition->get_graph();
+    MutableVertexPartition* new_partition = NULL;
+    try
+    {
+      if (py_initial_membership != NULL && py_initial_membership != Py_None)
+      {
+        vector<size_t> initial_membership = create_size_t_vector(py_initial_membership);
+        if (initial_membership.size() != graph->vcount())
+          throw Exception("Membership vector has incorrect size.");
+        new_partition = partition->create(graph, initial_membership);
+      }
+      else
+        new_partition = partition->create(graph);
+
+      // The graph remains owned by the original partition, which should be
+      // kept alive for as long as the new partition is in use.
+      new_partition->destructor_delete_graph = false;
+    }
+    catch (std::exception& e )
+    {
+      string s = "Could not construct partition: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return NULL;
+    }
+
+    #ifdef DEBUG
+      cerr << "Created partition " << new_partition << " sharing graph " << graph << endl;
+    #endif
+
+    // Both partitions write the neighbour caches of the graph, and so lock it.
+    return capsule_MutableVertexPartition(new_partition, decapsule_graph_mutex(py_partition));
+  }
+
   PyObject* _MutableVertexPartition_total_weight_in_comm(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = NULL;
@@ -784,6 +1380,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -823,6 +1420,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     if (comm >= partition->n_communities())
     {
@@ -862,6 +1460,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     if (comm >= partition->n_communities())
     {
@@ -900,6 +1499,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -932,6 +1532,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -966,6 +1567,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     if (comm >= partition->n_communities())
     {
@@ -1012,6 +1614,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     if (comm >= partition->n_communities())
     {
@@ -1055,6 +1658,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -1094,6 +1698,7 @@ extern "C"
     #endif
 
     MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     #ifdef DEBUG
       cerr << "Using partition at address " << partition << endl;
@@ -1118,6 +1723,34 @@ extern "C"
     return Py_None;
   }
 
+  PyObject* _MutableVertexPartition_memory_usage(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+    static const char* kwlist[] = {"partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "memory_usage();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    memory_usage_t usage = estimate_memory_usage(partition);
+    return memory_usage_to_py(usage, true);
+  }
+
   PyObject* _ResolutionParameterVertexPartition_get_resolution(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = NULL;
@@ -1139,6 +1772,7 @@ extern "C"
       cerr << "Capsule ResolutionParameterVertexPartition at address " << py_partition << endl;
     #endif
     ResolutionParameterVertexPartition* partition = (ResolutionParameterVertexPartition*)decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
     #ifdef DEBUG
       cerr << "Using ResolutionParameterVertexPartition at address " << partition << endl;
     #endif
@@ -1168,6 +1802,7 @@ extern "C"
       cerr << "Capsule ResolutionParameterVertexPartition at address " << py_partition << endl;
     #endif
     ResolutionParameterVertexPartition* partition = (ResolutionParameterVertexPartition*)decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
     #ifdef DEBUG
       cerr << "Using ResolutionParameterVertexPartition at address " << partition << endl;
     #endif
@@ -1203,6 +1838,7 @@ extern "C"
     #endif
 
     ResolutionParameterVertexPartition* partition = (ResolutionParameterVertexPartition*)decapsule_MutableVertexPartition(py_partition);
+    partition_lock_t lock({py_partition});
 
     if (py_res != NULL && py_res != Py_None)
     {
@@ -1233,6 +1869,35 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
+  PyObject* _BipartiteCPMVertexPartition_get_parameters(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = NULL;
+
+    static const char* kwlist[] = {"partition", NULL};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", (char**) kwlist,
+                                     &py_partition))
+        return NULL;
+
+    #ifdef DEBUG
+      cerr << "get_parameters();" << endl;
+    #endif
+
+    BipartiteCPMVertexPartition* partition = dynamic_cast<BipartiteCPMVertexPartition*>(decapsule_MutableVertexPartition(py_partition));
+    partition_lock_t lock({py_partition});
+    if (partition == NULL)
+    {
+      PyErr_SetString(PyExc_TypeError, "Expected a bipartite CPM partition.");
+      return NULL;
+    }
+
+    return Py_BuildValue("ddd", partition->resolution_parameter_0, partition->resolution_parameter_1, partition->type_base);
+  }
+
 #ifdef __cplusplus
 }
 #endif
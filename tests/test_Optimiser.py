@@ -1,8 +1,13 @@
 import unittest
+import asyncio
+import threading
+import _thread
 import igraph as ig
 import leidenalg
 
+from array import array
 from functools import reduce
+from concurrent.futures import ThreadPoolExecutor
 
 class OptimiserTest(unittest.TestCase):
 
@@ -124,6 +129,35 @@ class OptimiserTest(unittest.TestCase):
         partition.sizes(), 10*[10],
         msg="After optimising partition (max_comm_size=10) failed to find different components with CPMVertexPartition(resolution_parameter=0)")
 
+  def test_optimiser_with_comm_size_driver(self):
+    # The driver of the binding moves nodes with the routines of the C++
+    # library when sizes are constrained, which apply the constraints.
+    G = ig.Graph.Full(100)
+    settings = [{'consider_comms': leidenalg.PRUNED_ALL_COMMS},
+                {'progress': lambda progress: None},
+                {'fused_moves': True},
+                {'aggregate_order': 'size'}]
+    for setting in settings:
+      optimiser = leidenalg.Optimiser()
+      for key, value in setting.items():
+        setattr(optimiser, key, value)
+      optimiser.min_comm_size = 5
+      optimiser.community_constraint_enforcement = 10
+      partition = leidenalg.CPMVertexPartition(G, resolution_parameter=1)
+      optimiser.optimise_partition(partition)
+      self.assertListEqual(
+          partition.sizes(), 20*[5],
+          msg="After optimising partition (min_comm_size=5, {0}) failed to find different components with CPMVertexPartition(resolution_parameter=1)".format(setting))
+
+      optimiser.min_comm_size = 0
+      optimiser.max_comm_size = 10
+      optimiser.community_constraint_enforcement = 100
+      partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0)
+      optimiser.optimise_partition(partition)
+      self.assertListEqual(
+          partition.sizes(), 10*[10],
+          msg="After optimising partition (max_comm_size=10, {0}) failed to find different components with CPMVertexPartition(resolution_parameter=0)".format(setting))
+
   def test_optimiser_with_is_membership_fixed(self):
       G = ig.Graph.Full(3)
       partition = leidenalg.CPMVertexPartition(
@@ -163,6 +197,31 @@ class OptimiserTest(unittest.TestCase):
     self.assertEqual(partition.membership[fixed_node_idx], fixed_node_idx,
                      msg="Optimisation with fixed nodes failed to keep the associated community labels fixed")
 
+  def test_optimiser_fixed_nodes_and_bitset(self):
+    G = ig.Graph.Full(3)
+    # Node 0 fixed, given as list of indices and as packed bitset
+    for kwargs in [{'fixed_nodes': [0]},
+                   {'is_membership_fixed': bytes([0b001])},
+                   {'is_membership_fixed': bytearray([0b001])}]:
+      partition = leidenalg.CPMVertexPartition(
+              G,
+              resolution_parameter=0.01,
+              initial_membership=[2, 1, 0])
+      original_quality = partition.quality()
+      diff = self.optimiser.optimise_partition(partition, **kwargs)
+      self.assertAlmostEqual(partition.quality() - original_quality, diff, places=10,
+                             msg="Optimisation with fixed nodes returns inconsistent quality")
+      self.assertListEqual(
+            partition.membership, [2, 2, 2],
+            msg="After optimising partition with {0} failed to recover initial fixed memberships".format(kwargs)
+            )
+
+    partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0.01)
+    with self.assertRaises(ValueError):
+      self.optimiser.optimise_partition(partition, is_membership_fixed=bytes(2))
+    with self.assertRaises(ValueError):
+      self.optimiser.optimise_partition(partition, fixed_nodes=[3])
+
 
   def test_neg_weight_bipartite(self):
     G = ig.Graph.Full_Bipartite(50, 50)
@@ -174,6 +233,584 @@ class OptimiserTest(unittest.TestCase):
         partition.sizes(), 2*[50],
         msg="After optimising partition failed to find bipartite structure with CPMVertexPartition(resolution_parameter=-0.1)")
 
+  def test_share_graph(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0.1)
+    shared_partition = partition.share_graph()
+    self.assertIsInstance(shared_partition, leidenalg.CPMVertexPartition)
+    self.assertEqual(shared_partition.resolution_parameter, 0.1)
+    self.optimiser.set_rng_seed(0)
+    self.optimiser.optimise_partition(shared_partition)
+    self.assertListEqual(
+      partition.membership, list(range(G.vcount())),
+      msg="Optimising partition sharing the graph changed the original partition.")
+    self.assertAlmostEqual(
+      shared_partition.quality(),
+      leidenalg.CPMVertexPartition(G, shared_partition.membership, resolution_parameter=0.1).quality(),
+      places=10,
+      msg="Quality of partition sharing the graph not equal to quality of new partition.")
+    del partition
+    # The graph should remain valid after the original partition is gone
+    self.assertGreater(shared_partition.quality(), 0)
+
+  def test_consensus_partition(self):
+    G = ig.Graph.Famous('Zachary')
+    results = []
+    # The optimiser is used in between, which should not affect the results
+    for n_threads in [1, 2, 2]:
+      partition = leidenalg.ModularityVertexPartition(G)
+      agreement = self.optimiser.consensus_partition(partition, n_runs=6, seed=42, n_threads=n_threads)
+      self.assertIsInstance(agreement, array)
+      self.assertEqual(agreement.typecode, 'd')
+      self.assertEqual(len(agreement), G.ecount())
+      self.assertTrue(all(0 <= a <= 1 for a in agreement),
+                      msg="Agreement not between 0 and 1.")
+      self.assertGreater(len(partition), 1)
+      results.append((agreement, partition.membership))
+      self.optimiser.optimise_partition(leidenalg.ModularityVertexPartition(G))
+    self.assertEqual(results[0][0], results[1][0],
+                     msg="Agreement depends on the number of threads.")
+    self.assertListEqual(results[0][1], results[1][1],
+                         msg="Consensus partition depends on the number of threads.")
+    self.assertEqual(results[1], results[2],
+                     msg="Consensus partition not reproducible from the seed.")
+
+  def test_memory_usage(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.ModularityVertexPartition(G)
+    usage = partition.memory_usage()
+    self.assertEqual(
+      usage['total'],
+      sum(usage[key] for key in ['adjacency', 'weights', 'nodes', 'membership', 'communities', 'community_caches']),
+      msg="Total memory usage not equal to the sum of its parts.")
+    graph_usage = leidenalg.graph_memory_usage(G)
+    for key in ['adjacency', 'weights', 'nodes']:
+      self.assertEqual(graph_usage[key], usage[key],
+        msg="Memory usage of graph differs from that of the graph of the partition.")
+    self.assertEqual(self.optimiser.peak_memory_usage, 0)
+    self.optimiser.optimise_partition(partition)
+    # The first aggregate graph is held together with the original graph.
+    self.assertGreater(
+      self.optimiser.peak_memory_usage,
+      usage['total'],
+      msg="Peak memory usage of optimiser does not include the aggregate graphs.")
+
+  def test_optimiser_multiplex_membership(self):
+    G = ig.Graph.Famous('Zachary')
+    partitions = [leidenalg.ModularityVertexPartition(G),
+                  leidenalg.CPMVertexPartition(G, resolution_parameter=0.1)]
+    self.optimiser.optimise_partition_multiplex(partitions, layer_weights=[1, 1])
+    for partition in partitions:
+      self.assertListEqual(
+        partition.membership,
+        leidenalg._c_leiden._MutableVertexPartition_get_membership(partition._partition),
+        msg="Membership of layer not equal to its internal membership.")
+    self.assertEqual(len(partitions[0]), len(partitions[1]))
+    partitions[1].move_node(0, (partitions[1].membership[0] + 1) % len(partitions[1]))
+    self.assertNotEqual(partitions[0].membership[0], partitions[1].membership[0],
+                        msg="Moving a node in one layer also moved it in another layer.")
+
+  def test_optimiser_fused_moves(self):
+    # Three cliques in a ring, which both paths should find in all layers.
+    G = ig.Graph.Full(5) + ig.Graph.Full(5) + ig.Graph.Full(5)
+    G.add_edges([(0, 5), (6, 10), (11, 1)])
+    cliques = set(frozenset(range(5*c, 5*c + 5)) for c in range(3))
+    results = []
+    for fused_moves in [False, True]:
+      optimiser = leidenalg.Optimiser()
+      optimiser.set_rng_seed(42)
+      optimiser.fused_moves = fused_moves
+      self.assertEqual(optimiser.fused_moves, fused_moves)
+      partitions = [leidenalg.ModularityVertexPartition(G),
+                    leidenalg.CPMVertexPartition(G, resolution_parameter=0.5)]
+      quality = partitions[0].quality() + 2*partitions[1].quality()
+      diff = optimiser.optimise_partition_multiplex(partitions, layer_weights=[1, 2])
+      self.assertAlmostEqual(
+        partitions[0].quality() + 2*partitions[1].quality() - quality,
+        diff,
+        places=10,
+        msg="Improvement in quality function not equal to the difference in quality (fused_moves={0}).".format(fused_moves))
+      for partition in partitions:
+        self.assertSetEqual(set(frozenset(c) for c in partition), cliques,
+                            msg="Cliques not found (fused_moves={0}).".format(fused_moves))
+      results.append((partitions[0].quality(), partitions[1].quality()))
+    self.assertAlmostEqual(results[0][0], results[1][0], places=10,
+                           msg="Fused moves find a different partition than the layers of the C++ library.")
+    self.assertAlmostEqual(results[0][1], results[1][1], places=10,
+                           msg="Fused moves find a different partition than the layers of the C++ library.")
+
+  def test_optimiser_fused_kernels(self):
+    # The diff_move kernels of the fused moves should agree with the quality
+    # of each type, for undirected and directed, weighted graphs.
+    G = ig.Graph.Famous('Zachary')
+    G_directed = ig.Graph.Famous('Zachary')
+    G_directed.to_directed(mode='acyclic')
+    for graph in [G, G_directed]:
+      graph.es['weight'] = [1 + (e % 3) for e in range(graph.ecount())]
+      partitions = [leidenalg.ModularityVertexPartition(graph, weights='weight'),
+                    leidenalg.RBConfigurationVertexPartition(graph, weights='weight', resolution_parameter=0.5),
+                    leidenalg.CPMVertexPartition(graph, weights='weight', resolution_parameter=0.5),
+                    leidenalg.RBERVertexPartition(graph, weights='weight', resolution_parameter=0.5),
+                    leidenalg.SignificanceVertexPartition(graph),
+                    leidenalg.SurpriseVertexPartition(graph, weights='weight')]
+      for partition in partitions:
+        optimiser = leidenalg.Optimiser()
+        optimiser.set_rng_seed(42)
+        optimiser.fused_moves = True
+        quality = partition.quality()
+        diff = optimiser.optimise_partition(partition)
+        self.assertAlmostEqual(
+          partition.quality() - quality,
+          diff,
+          places=5,
+          msg="Improvement in quality function not equal to the difference in quality for {0} (directed={1}).".format(
+            type(partition).__name__, graph.is_directed()))
+
+  def test_optimiser_return_levels(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.ModularityVertexPartition(G)
+    diff, levels = self.optimiser.optimise_partition(partition, fixed_nodes=[0, 33], return_levels=True)
+    self.assertEqual(len(levels[0]), G.vcount())
+    node = list(range(G.vcount()))
+    for level in levels:
+      node = [level[v] for v in node]
+    self.assertListEqual(node, partition.membership,
+                         msg="Composed levels do not yield the membership.")
+    for level, next_level in zip(levels, levels[1:]):
+      self.assertEqual(max(level) + 1, len(next_level),
+                       msg="Level does not map onto the nodes of the next level.")
+    # The levels of a reordered partition are in the original node order,
+    # also if no iterations are run.
+    for n_iterations in [0, 2]:
+      partition = leidenalg.ModularityVertexPartition.Reordered(
+        G, initial_membership=[v % 3 for v in range(G.vcount())])
+      diff, levels = self.optimiser.optimise_partition(partition, n_iterations=n_iterations, return_levels=True)
+      node = list(range(G.vcount()))
+      for level in levels:
+        node = [level[v] for v in node]
+      self.assertListEqual(node, partition.membership,
+                           msg="Composed levels do not yield the membership of a reordered partition.")
+
+  def test_optimiser_aggregate_order(self):
+    G = ig.Graph.Famous('Zachary')
+    for refine_partition in [True, False]:
+      for aggregate_order in ['size', 'traversal']:
+        optimiser = leidenalg.Optimiser()
+        optimiser.refine_partition = refine_partition
+        optimiser.aggregate_order = aggregate_order
+        partition = leidenalg.ModularityVertexPartition(G)
+        optimiser.optimise_partition(partition, fixed_nodes=[0, 33])
+        self.assertGreater(partition.quality(), 0.35,
+                           msg='Poor partition with aggregate order {0}.'.format(aggregate_order))
+        self.assertAlmostEqual(
+          partition.quality(),
+          leidenalg.ModularityVertexPartition(G, partition.membership).quality(),
+          places=5)
+    with self.assertRaises(ValueError):
+      self.optimiser.aggregate_order = 'random'
+
+  def test_optimiser_reuse_workspace(self):
+    # The same optimiser reuses its scratch space on graphs of different sizes.
+    optimiser = leidenalg.Optimiser()
+    optimiser.aggregate_order = 'size'
+    optimiser.set_rng_seed(0)
+    for G in [ig.Graph.Famous('Zachary'), ig.Graph.Ring(5), ig.Graph.Famous('Zachary')]:
+      partition = leidenalg.ModularityVertexPartition(G)
+      diff, levels = optimiser.optimise_partition(partition, return_levels=True)
+      membership = list(range(G.vcount()))
+      for level in levels:
+        membership = [level[c] for c in membership]
+      self.assertListEqual(membership, partition.membership)
+
+  def test_pruned_all_comms(self):
+    G = ig.Graph.Famous('Zachary')
+    optimiser = leidenalg.Optimiser()
+    optimiser.consider_comms = leidenalg.PRUNED_ALL_COMMS
+    self.assertEqual(optimiser.consider_comms, leidenalg.PRUNED_ALL_COMMS)
+    partition = leidenalg.ModularityVertexPartition(G)
+    optimiser.optimise_partition(partition)
+    self.assertGreater(partition.quality(), 0.35)
+    self.assertAlmostEqual(
+      optimiser.move_nodes(partition, consider_comms=leidenalg.ALL_COMMS), 0.0,
+      msg='Node could still be moved to a non-neighbouring community.')
+    with self.assertRaises(ValueError):
+      optimiser.consider_comms = 0
+    with self.assertRaises(ValueError):
+      optimiser.refine_consider_comms = leidenalg.PRUNED_ALL_COMMS
+    # The runs of a consensus use the same setting
+    optimiser.consider_comms = leidenalg.PRUNED_ALL_COMMS
+    partition = leidenalg.ModularityVertexPartition(G)
+    agreement = optimiser.consensus_partition(partition, n_runs=4, seed=42, n_threads=2)
+    self.assertEqual(len(agreement), G.ecount())
+    self.assertGreater(len(partition), 1)
+
+  def test_all_comms_candidates(self):
+    G = ig.Graph.Famous('Zachary')
+    optimiser = leidenalg.Optimiser()
+    self.assertIsNone(optimiser.all_comms_candidates)
+    optimiser.fused_moves = True
+    optimiser.consider_comms = leidenalg.ALL_COMMS
+    optimiser.all_comms_candidates = 'exact'
+    self.assertEqual(optimiser.all_comms_candidates, 'exact')
+    # Once nothing improves, no node can move to any community, as when all
+    # communities are considered.
+    for partition in [leidenalg.ModularityVertexPartition(G),
+                      leidenalg.CPMVertexPartition(G, resolution_parameter=0.1),
+                      leidenalg.RBERVertexPartition(G, resolution_parameter=0.5)]:
+      optimiser.optimise_partition(partition, n_iterations=-1)
+      self.assertAlmostEqual(
+        optimiser.move_nodes(partition, consider_comms=leidenalg.ALL_COMMS), 0.0,
+        msg='Node could still be moved to a non-neighbouring community.')
+    # A limited number of candidates also applies to other quality functions.
+    optimiser.all_comms_candidates = 2
+    self.assertEqual(optimiser.all_comms_candidates, 2)
+    partition = leidenalg.SurpriseVertexPartition(G)
+    optimiser.optimise_partition(partition)
+    self.assertAlmostEqual(
+      partition.quality(),
+      leidenalg.SurpriseVertexPartition(G, partition.membership).quality(),
+      places=5)
+    for value in [0, -1, 'approximate', True]:
+      with self.assertRaises(ValueError):
+        optimiser.all_comms_candidates = value
+    optimiser.all_comms_candidates = None
+    self.assertIsNone(optimiser.all_comms_candidates)
+
+  def test_time_budget_and_cancel(self):
+    G = ig.Graph.Famous('Zachary')
+    optimiser = leidenalg.Optimiser()
+    partition = leidenalg.ModularityVertexPartition(G)
+    optimiser.optimise_partition(partition)
+    self.assertEqual(optimiser.status, 'complete')
+
+    optimiser.time_budget = 0
+    partition = leidenalg.ModularityVertexPartition(G)
+    diff = optimiser.optimise_partition(partition, n_iterations=-1)
+    self.assertEqual(optimiser.status, 'time_budget')
+    self.assertEqual(diff, 0)
+    self.assertListEqual(partition.membership, list(range(G.vcount())))
+
+    # A request to cancel while nothing runs is discarded by the next run
+    optimiser.time_budget = None
+    optimiser.cancel()
+    partition = leidenalg.ModularityVertexPartition(G)
+    optimiser.optimise_partition(partition)
+    self.assertEqual(optimiser.status, 'complete')
+    self.assertGreater(partition.quality(), 0.35)
+    with self.assertRaises(ValueError):
+      optimiser.time_budget = -1
+
+  def test_progress(self):
+    G = ig.Graph.Famous('Zachary')
+    optimiser = leidenalg.Optimiser()
+    optimiser.progress_interval = 0
+    reports = []
+    optimiser.progress = reports.append
+    partition = leidenalg.ModularityVertexPartition(G)
+    diff = optimiser.optimise_partition(partition, n_iterations=2)
+    self.assertGreater(len(reports), 0)
+    self.assertEqual(reports[0]['level'], 0)
+    self.assertEqual(reports[0]['level_nodes'], G.vcount())
+    self.assertGreater(reports[0]['moves'], 0)
+    self.assertEqual(reports[-1]['iteration'], 1)
+    self.assertAlmostEqual(reports[-1]['improvement'], diff, places=5)
+
+    def stop(progress):
+      raise RuntimeError('stop')
+    optimiser.progress = stop
+    partition = leidenalg.ModularityVertexPartition(G)
+    with self.assertRaises(RuntimeError):
+      optimiser.optimise_partition(partition)
+    self.assertEqual(optimiser.status, 'interrupted')
+    self.assertAlmostEqual(
+      partition.quality(),
+      leidenalg.ModularityVertexPartition(G, partition.membership).quality(),
+      places=5)
+
+    optimiser.progress = lambda progress: optimiser.cancel()
+    optimiser.optimise_partition(partition)
+    self.assertEqual(optimiser.status, 'cancelled')
+
+    # Two cliques joined by a single edge are already optimal, so that nothing
+    # moves, even though the communities are renumbered.
+    G = ig.Graph.Full(5) + ig.Graph.Full(5)
+    G.add_edge(0, 5)
+    partition = leidenalg.ModularityVertexPartition(G, initial_membership=[1]*5 + [0]*5)
+    reports = []
+    optimiser.progress = reports.append
+    optimiser.optimise_partition(partition)
+    self.assertGreater(len(reports), 0)
+    self.assertEqual(reports[-1]['moves'], 0)
+    self.assertListEqual(partition.sizes(), [5, 5])
+
+    # Changing the settings from the callback raises rather than waiting for
+    # the optimisation that runs the callback.
+    def change(progress):
+      optimiser.consider_comms = leidenalg.ALL_COMMS
+    optimiser.progress = change
+    partition = leidenalg.ModularityVertexPartition(G)
+    with self.assertRaises(RuntimeError):
+      optimiser.optimise_partition(partition)
+    optimiser.progress = None
+    optimiser.consider_comms = leidenalg.ALL_COMMS
+    self.assertEqual(optimiser.consider_comms, leidenalg.ALL_COMMS)
+
+  def test_interrupt(self):
+    G = ig.Graph.Erdos_Renyi(n=2000, m=20000)
+    optimiser = leidenalg.Optimiser()
+    partition = leidenalg.ModularityVertexPartition(G)
+    # A keyboard interrupt is raised once the optimisation of the C++ library
+    # returns, or between calls, and leaves the partition consistent.
+    timer = threading.Timer(0.05, _thread.interrupt_main)
+    timer.start()
+    with self.assertRaises(KeyboardInterrupt):
+      while True:
+        optimiser.optimise_partition(partition, n_iterations=1)
+    timer.join()
+    self.assertIn(optimiser.status, ('complete', 'interrupted'))
+    self.assertAlmostEqual(
+      partition.quality(),
+      leidenalg.ModularityVertexPartition(G, partition.membership).quality(),
+      places=5)
+
+  def test_optimise_partition_async(self):
+    G = ig.Graph.Famous('Zachary')
+    optimiser = leidenalg.Optimiser()
+    partition = leidenalg.ModularityVertexPartition(G)
+    diff = optimiser.optimise_partition_future(partition).result()
+    self.assertGreater(diff, 0)
+    self.assertGreater(partition.quality(), 0.35)
+
+    async def detect():
+      partitions = await asyncio.gather(*[
+        leidenalg.find_partition_async(G, leidenalg.ModularityVertexPartition, seed=seed)
+        for seed in range(4)])
+      return partitions
+    for partition in asyncio.run(detect()):
+      self.assertGreater(partition.quality(), 0.35)
+      self.assertAlmostEqual(
+        partition.quality(),
+        leidenalg.ModularityVertexPartition(G, partition.membership).quality(),
+        places=5)
+
+  def test_optimise_partition_threads(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.ModularityVertexPartition(G)
+    optimisers = [leidenalg.Optimiser() for _ in range(4)]
+    # Several optimisers on the same partition, and the same optimiser on
+    # several partitions, from different threads at once.
+    partitions = [partition]*4 + [leidenalg.ModularityVertexPartition(G) for _ in range(4)]
+    with ThreadPoolExecutor(max_workers=8) as executor:
+      list(executor.map(
+        lambda args: args[0].optimise_partition(args[1]),
+        zip(optimisers + optimisers, partitions)))
+    for partition in partitions:
+      self.assertGreater(partition.quality(), 0.35)
+      self.assertAlmostEqual(
+        partition.quality(),
+        leidenalg.ModularityVertexPartition(G, partition.membership).quality(),
+        places=5)
+
+  def test_optimise_partition_threads_share_graph(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.ModularityVertexPartition(G)
+    # Partitions that share a graph are optimised one at a time, so that the
+    # results equal those of the same seeds in a row.
+    def run(seed, shared):
+      optimiser = leidenalg.Optimiser()
+      optimiser.set_rng_seed(seed)
+      new_partition = partition.share_graph() if shared else leidenalg.ModularityVertexPartition(G)
+      optimiser.optimise_partition(new_partition)
+      return new_partition.membership
+    with ThreadPoolExecutor(max_workers=4) as executor:
+      memberships = list(executor.map(lambda seed: run(seed, True), range(8)))
+    self.assertListEqual(memberships, [run(seed, False) for seed in range(8)])
+
+  def test_optimise_partition_threads_settings(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.ModularityVertexPartition(G)
+    optimiser = leidenalg.Optimiser()
+    optimiser.fused_moves = True
+    shared = partition.share_graph()
+    candidates = [[0]*G.vcount(), list(range(G.vcount()))]
+    # Settings and batch qualities wait for the running optimisations.
+    def change(i):
+      optimiser.consider_comms = [leidenalg.ALL_NEIGH_COMMS, leidenalg.ALL_COMMS][i % 2]
+      optimiser.max_comm_size = 0
+      return shared.quality_batch(candidates)
+    with ThreadPoolExecutor(max_workers=4) as executor:
+      runs = [executor.submit(optimiser.optimise_partition, partition) for _ in range(4)]
+      qualities = list(executor.map(change, range(8)))
+      for run in runs:
+        run.result()
+    self.assertGreater(partition.quality(), 0.35)
+    for q in qualities:
+      self.assertListEqual(q, partition.quality_batch(candidates))
+
+  def test_optimise_partition_threads_direct(self):
+    G = ig.Graph.Famous('Zachary')
+    partition = leidenalg.ModularityVertexPartition(G)
+    optimiser = leidenalg.Optimiser()
+    optimiser.progress_interval = 0
+    # The progress callback runs on the optimising thread, which may still
+    # query the partition.
+    qualities = []
+    optimiser.progress = lambda progress: qualities.append(partition.quality())
+    # Direct moves and queries wait for the running optimisations.
+    def move(v):
+      partition.move_node(v, partition.membership[(v + 1) % G.vcount()])
+      return partition.diff_move(v, partition.membership[v])
+    with ThreadPoolExecutor(max_workers=4) as executor:
+      runs = [executor.submit(optimiser.optimise_partition, partition) for _ in range(4)]
+      diffs = list(executor.map(move, range(G.vcount())))
+      for run in runs:
+        run.result()
+    self.assertGreater(len(qualities), 0)
+    self.assertListEqual(diffs, [0.0]*G.vcount())
+    self.assertAlmostEqual(
+      partition.quality(),
+      leidenalg.ModularityVertexPartition(G, partition.membership).quality(),
+      places=5)
+
+  def test_find_partitions_batch(self):
+    graphs = [ig.Graph.Famous('Zachary'), ig.Graph.Ring(6), ig.Graph.Full(4),
+              ig.Graph.Famous('Zachary') + ig.Graph.Famous('Zachary')]
+    edges = [e for H in graphs for e in H.get_edgelist()]
+    edge_offsets, node_offsets = [0], [0]
+    for H in graphs:
+      edge_offsets.append(edge_offsets[-1] + H.ecount())
+      node_offsets.append(node_offsets[-1] + H.vcount())
+    membership = leidenalg.find_partitions_batch(
+      edges, edge_offsets, node_offsets, leidenalg.ModularityVertexPartition,
+      seed=42, n_threads=2)
+    self.assertEqual(len(membership), node_offsets[-1])
+    for g, H in enumerate(graphs):
+      partition = leidenalg.ModularityVertexPartition(
+        H, list(membership[node_offsets[g]:node_offsets[g+1]]))
+      self.assertGreaterEqual(
+        partition.quality(),
+        leidenalg.find_partition(H, leidenalg.ModularityVertexPartition, seed=42).quality() - 0.05,
+        msg="Partition of graph {0} in batch worse than find_partition.".format(g))
+    self.assertListEqual(
+      list(membership),
+      list(leidenalg.find_partitions_batch(
+        edges, edge_offsets, node_offsets, leidenalg.ModularityVertexPartition,
+        seed=42, n_threads=1)),
+      msg="Batch membership depends on the number of threads.")
+    with self.assertRaises(ValueError):
+      leidenalg.find_partitions_batch([(0, 5)], [0, 1], [0, 5], leidenalg.CPMVertexPartition)
+    with self.assertRaises(ValueError):
+      leidenalg.find_partitions_batch(edges, edge_offsets, node_offsets, leidenalg.SignedModularityVertexPartition)
+
+    # The settings of an optimiser apply to all graphs
+    optimiser = leidenalg.Optimiser()
+    optimiser.consider_comms = leidenalg.PRUNED_ALL_COMMS
+    optimiser.aggregate_order = 'traversal'
+    membership = leidenalg.find_partitions_batch(
+      edges, edge_offsets, node_offsets, leidenalg.ModularityVertexPartition,
+      seed=42, n_threads=2, optimiser=optimiser)
+    for g, H in enumerate(graphs):
+      partition = leidenalg.ModularityVertexPartition(
+        H, list(membership[node_offsets[g]:node_offsets[g+1]]))
+      self.assertGreaterEqual(
+        partition.quality(),
+        leidenalg.find_partition(H, leidenalg.ModularityVertexPartition, seed=42).quality() - 0.05,
+        msg="Partition of graph {0} in batch with optimiser worse than find_partition.".format(g))
+
+  def test_slices_to_layers(self):
+    G_1 = ig.Graph.Ring(5)
+    G_1.vs['id'] = ['a', 'b', 'c', 'd', 'e']
+    G_2 = ig.Graph.Ring(4)
+    G_2.vs['id'] = ['e', 'c', 'z', 'a']
+    G_layers, G_interslice, G = leidenalg.time_slices_to_layers([G_1, G_2], interslice_weight=0.5)
+    self.assertListEqual(
+      sorted(G_interslice.get_edgelist()), [(0, 8), (2, 6), (4, 5)],
+      msg="Interslice links do not couple nodes with identical ids.")
+    self.assertListEqual(G_interslice.es['weight'], [0.5]*3)
+    self.assertListEqual(G_layers[1].vs['node_size'], [0]*5 + [1]*4)
+    self.assertEqual(G_layers[1].ecount(), G_2.ecount())
+
+    G_2.vs['id'] = ['e', 'c', 'c', 'a']
+    with self.assertRaises(ValueError):
+      leidenalg.time_slices_to_layers([G_1, G_2])
+
+    G_2.vs['id'] = range(4)
+    G_1.vs['id'] = range(5)
+    membership, improvement = leidenalg.find_partition_temporal(
+      [G_1, G_2], leidenalg.CPMVertexPartition, interslice_weight=1, resolution_parameter=0)
+    self.assertListEqual(membership, [[0]*5, [0]*4])
+
+  def test_lean_multiplex(self):
+    G_1 = ig.Graph.Famous('Zachary')
+    G_2 = ig.Graph.Famous('Zachary')
+    G_2.delete_edges(range(0, G_2.ecount(), 3))
+    n = G_1.vcount() + G_2.vcount()
+    G_interslice = ig.Graph(n=n, edges=[(v, G_1.vcount() + v) for v in range(G_1.vcount())])
+    G_interslice.es['weight'] = 0.5
+    layer_nodes = [range(G_1.vcount()), range(G_1.vcount(), n), None]
+
+    def lean_partitions():
+      return [leidenalg.CPMVertexPartition(G_1, resolution_parameter=0.1),
+              leidenalg.CPMVertexPartition(G_2, resolution_parameter=0.1),
+              leidenalg.CPMVertexPartition(G_interslice, resolution_parameter=0,
+                                           node_sizes=[0]*n, weights='weight')]
+
+    partitions = lean_partitions()
+    quality = sum(partition.quality() for partition in partitions)
+    optimiser = leidenalg.Optimiser()
+    optimiser.set_rng_seed(42)
+    improvement = optimiser.optimise_partition_multiplex(partitions, layer_nodes=layer_nodes)
+    self.assertAlmostEqual(
+      quality + improvement, sum(partition.quality() for partition in partitions),
+      msg="Improvement of layers with different nodes does not match their quality.")
+
+    # The layers hold the communities of the multiplex, restricted to their
+    # own nodes.
+    membership = partitions[-1].membership
+    for partition, nodes in zip(partitions, layer_nodes[:-1]):
+      for i in range(len(nodes)):
+        for j in range(len(nodes)):
+          self.assertEqual(
+            partition.membership[i] == partition.membership[j],
+            membership[nodes[i]] == membership[nodes[j]],
+            msg="Layer does not hold the communities of the multiplex.")
+
+    # Layers of all nodes, with node sizes of zero outside the slice, have the
+    # same quality for the same communities.
+    full_partitions = []
+    for H, nodes in zip([G_1, G_2], layer_nodes[:-1]):
+      H_full = ig.Graph(n=n, edges=[(nodes[v], nodes[u]) for v, u in H.get_edgelist()])
+      node_sizes = [0]*n
+      for v in nodes:
+        node_sizes[v] = 1
+      full_partitions.append(leidenalg.CPMVertexPartition(H_full, membership,
+        resolution_parameter=0.1, node_sizes=node_sizes))
+    for partition, full_partition in zip(partitions, full_partitions):
+      self.assertAlmostEqual(partition.quality(), full_partition.quality())
+
+    with self.assertRaises(ValueError):
+      optimiser.optimise_partition_multiplex(lean_partitions(), layer_nodes=layer_nodes, fixed_nodes=[0])
+    with self.assertRaises(ValueError):
+      optimiser.optimise_partition_multiplex(lean_partitions(), layer_nodes=[range(G_1.vcount() - 1)] + layer_nodes[1:])
+    optimiser.consider_comms = leidenalg.ALL_COMMS
+    with self.assertRaises(ValueError):
+      optimiser.optimise_partition_multiplex(lean_partitions(), layer_nodes=layer_nodes)
+
+  def test_find_partition_temporal_update(self):
+    G_1 = ig.Graph.Ring(10)
+    G_1.vs['id'] = range(10)
+    G_2 = ig.Graph.Ring(12)
+    G_2.vs['id'] = range(2, 14)
+    previous_membership = [5]*5 + [7]*5
+    membership, improvement = leidenalg.find_partition_temporal_update(
+      G_1, previous_membership, G_2, leidenalg.CPMVertexPartition,
+      interslice_weight=10, resolution_parameter=0.5, seed=42)
+    self.assertEqual(len(membership), G_2.vcount())
+    self.assertListEqual(membership[:8], [5]*3 + [7]*5,
+                         msg="Nodes of new slice not in the community of the previous slice.")
+    self.assertTrue(all(c in (5, 7) or c >= 8 for c in membership),
+                    msg="New communities do not start after the communities of the previous slice.")
+
   def test_resolution_profile(self):
     G = ig.Graph.Famous('Zachary')
     profile = self.optimiser.resolution_profile(G, leidenalg.CPMVertexPartition, resolution_range=(0,1))
@@ -110,6 +110,23 @@ class BaseTest:
               msg="Difference in quality ({0}) not equal to calculated difference ({1})".format(
               q2 - q1, diff))
 
+    @data(*graphs)
+    def test_diff_move_all_comms(self, graph):
+      if 'weight' in graph.es.attributes() and self.partition_type == leidenalg.SignificanceVertexPartition:
+        raise unittest.SkipTest('Significance doesn\'t handle weighted graphs')
+
+      kwargs = {'weights': 'weight'} if 'weight' in graph.es.attributes() else {}
+      # Evaluate each node for all communities in a row, as the optimiser does
+      partition = self.partition_type(graph, initial_membership=[v % 4 for v in range(graph.vcount())], **kwargs)
+      for v in range(graph.vcount()):
+        q1 = partition.quality()
+        diffs = [partition.diff_move(v, c) for c in range(len(partition))]
+        for c, diff in enumerate(diffs):
+          partition2 = self.partition_type(graph, initial_membership=partition.membership, **kwargs)
+          partition2.move_node(v, c)
+          self.assertAlmostEqual(partition2.quality() - q1, diff, places=5)
+        partition.move_node(v, max(range(len(diffs)), key=diffs.__getitem__))
+
     @data(*graphs)
     def test_aggregate_partition(self, graph):
       if 'weight' in graph.es.attributes() and self.partition_type != leidenalg.SignificanceVertexPartition:
@@ -131,6 +148,43 @@ class BaseTest:
           places=5,
           msg='Quality not equal from coarser partition.')
 
+    @data(*graphs)
+    def test_aggregate_partition_order(self, graph):
+      partition = self.partition_type(graph)
+      self.optimiser.move_nodes(partition)
+      q = partition.quality()
+      for order in ['size', 'traversal']:
+        aggregate_partition = partition.aggregate_partition(order=order)
+        self.assertAlmostEqual(partition.quality(), q, places=5,
+                               msg='Relabelling communities changed the quality.')
+        self.assertAlmostEqual(aggregate_partition.quality(), q, places=5,
+                               msg='Quality not equal for aggregate partition.')
+        self.optimiser.move_nodes(aggregate_partition)
+        partition.from_coarse_partition(aggregate_partition)
+        self.assertAlmostEqual(
+            partition.quality(),
+            aggregate_partition.quality(),
+            places=5,
+            msg='Quality not equal from coarser partition.')
+        q = partition.quality()
+
+    @data(*graphs)
+    def test_aggregate_partition_graph(self, graph):
+      partition = self.partition_type(graph)
+      self.optimiser.move_nodes(partition)
+      aggregate_partition = partition.aggregate_partition()
+      self.assertIsNone(aggregate_partition._py_graph,
+                        msg='Graph of aggregate partition constructed before it was used.')
+      aggregate_graph = aggregate_partition.graph
+      self.assertEqual(aggregate_graph.vcount(), len(partition))
+      self.assertEqual(aggregate_graph.is_directed(), graph.is_directed())
+      self.assertAlmostEqual(sum(aggregate_graph.vs['node_size']), graph.vcount(), places=5)
+      self.assertAlmostEqual(
+          deepcopy(aggregate_partition).quality(),
+          aggregate_partition.quality(),
+          places=5,
+          msg='Quality not equal for copy of aggregate partition.')
+
     @data(*graphs)
     def test_total_weight_in_all_comms(self, graph):
       if 'weight' in graph.es.attributes() and self.partition_type != leidenalg.SignificanceVertexPartition:
@@ -147,6 +201,47 @@ class BaseTest:
           s, partition.total_weight_in_all_comms())
         )
 
+    @data(*graphs)
+    def test_quality_batch(self, graph):
+      partition = self.partition_type(graph)
+      self.optimiser.optimise_partition(partition)
+      membership = partition.membership
+      q = partition.quality()
+      n = graph.vcount()
+      candidates = [membership, [0]*n, list(range(n)), [v % 3 for v in range(n)]]
+      qualities = partition.quality_batch(candidates, n_threads=2)
+      self.assertListEqual(partition.membership, membership,
+                           msg='Batch quality changed the membership of the partition.')
+      self.assertAlmostEqual(partition.quality(), q, places=5)
+      for candidate, candidate_q in zip(candidates, qualities):
+        partition.set_membership(candidate)
+        self.assertAlmostEqual(
+          partition.quality(),
+          candidate_q,
+          places=5,
+          msg='Batch quality not equal to quality of membership.')
+
+    @data(*graphs)
+    def test_reordered(self, graph):
+      partition = self.partition_type.Reordered(graph, 'rcm')
+      self.optimiser.optimise_partition(partition, fixed_nodes=[0])
+      self.assertIs(partition.graph, graph)
+      self.assertEqual(len(partition.membership), graph.vcount())
+      self.assertAlmostEqual(
+        partition.quality(),
+        self.partition_type(graph, initial_membership=partition.membership).quality(),
+        places=5,
+        msg='Quality of reordered partition not equal to quality of its membership.')
+      self.assertAlmostEqual(deepcopy(partition).quality(), partition.quality(), places=5)
+      for v in range(graph.vcount()):
+        if graph.degree(v) >= 1:
+          u = graph.neighbors(v)[0]
+          diff = partition.diff_move(v, partition.membership[u])
+          q1 = partition.quality()
+          partition.move_node(v, partition.membership[u])
+          self.assertEqual(partition.membership[v], partition.membership[u])
+          self.assertAlmostEqual(partition.quality() - q1, diff, places=5)
+
     @data(*graphs)
     def test_copy(self, graph):
       if 'weight' in graph.es.attributes() and self.partition_type != leidenalg.SignificanceVertexPartition:
@@ -208,6 +303,38 @@ class CPMVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
             layer_weights=[1, -1, -1])
     self.assertEqual(len(partition), 1)
 
+  def test_Bipartite_single_partition(self):
+    graph = bipartite_graph
+    partition = leidenalg.BipartiteCPMVertexPartition(
+            graph, resolution_parameter_01=0.2, resolution_parameter_0=0.1)
+    layers = leidenalg.CPMVertexPartition.Bipartite(
+            graph, resolution_parameter_01=0.2, resolution_parameter_0=0.1)
+    for membership in [list(range(graph.vcount())),
+                       [0]*graph.vcount(),
+                       [0, 0, 1, 1, 0, 1, 0, 1]]:
+      partition.set_membership(membership)
+      for layer in layers:
+        layer.set_membership(membership)
+      self.assertAlmostEqual(
+          partition.quality(),
+          layers[0].quality() - layers[1].quality() - layers[2].quality(),
+          places=5,
+          msg='Quality not equal to quality of bipartite layers.')
+      for v in range(graph.vcount() if len(partition) > 1 else 0):
+        c = (partition.membership[v] + 1) % len(partition)
+        diff = partition.diff_move(v, c)
+        q1 = partition.quality()
+        partition.move_node(v, c)
+        self.assertAlmostEqual(partition.quality() - q1, diff, places=5,
+                               msg='Difference in quality not equal to calculated difference.')
+    self.optimiser.optimise_partition(partition)
+    self.assertEqual(len(partition), 1)
+    self.assertAlmostEqual(
+        partition.quality(),
+        partition.aggregate_partition().quality(),
+        places=5,
+        msg='Quality not equal for aggregate partition.')
+
 class SurpriseVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
   def setUp(self):
     super(SurpriseVertexPartitionTest, self).setUp()
@@ -218,6 +345,44 @@ class SignificanceVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
     super(SignificanceVertexPartitionTest, self).setUp()
     self.partition_type = leidenalg.SignificanceVertexPartition
 
+class SignedVertexPartitionTest(unittest.TestCase):
+  def setUp(self):
+    self.optimiser = leidenalg.Optimiser()
+    self.graph = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=True)
+    self.graph.es['weight'] = [random.random() - 0.3 for e in self.graph.es]
+
+  def test_signed_rbconfiguration_layers(self):
+    G = self.graph
+    G_pos = G.subgraph_edges(G.es.select(weight_gt = 0), delete_vertices=False)
+    G_neg = G.subgraph_edges(G.es.select(weight_lt = 0), delete_vertices=False)
+    G_neg.es['weight'] = [-w for w in G_neg.es['weight']]
+    partition = leidenalg.SignedRBConfigurationVertexPartition(G, weights='weight', resolution_parameter=0.5)
+    self.optimiser.optimise_partition(partition)
+    partition_pos = leidenalg.RBConfigurationVertexPartition(G_pos, partition.membership, weights='weight', resolution_parameter=0.5)
+    partition_neg = leidenalg.RBConfigurationVertexPartition(G_neg, partition.membership, weights='weight', resolution_parameter=0.5)
+    self.assertAlmostEqual(
+        partition.quality(),
+        partition_pos.quality() - partition_neg.quality(),
+        places=5,
+        msg='Quality not equal to quality of positive and negative layers.')
+    self.assertAlmostEqual(
+        partition.quality(),
+        partition.aggregate_partition().quality(),
+        places=5,
+        msg='Quality not equal for aggregate partition.')
+
+  def test_signed_diff_move(self):
+    for partition in [leidenalg.SignedRBConfigurationVertexPartition(self.graph, weights='weight'),
+                      leidenalg.SignedModularityVertexPartition(self.graph, weights='weight')]:
+      for v in range(self.graph.vcount()):
+        if self.graph.degree(v) >= 1:
+          u = self.graph.neighbors(v)[0]
+          diff = partition.diff_move(v, partition.membership[u])
+          q1 = partition.quality()
+          partition.move_node(v, partition.membership[u])
+          self.assertAlmostEqual(partition.quality() - q1, diff, places=5,
+                                 msg='Difference in quality not equal to calculated difference.')
+
 #%%
 if __name__ == '__main__':
   #%%